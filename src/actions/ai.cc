@@ -6,63 +6,154 @@
 #include "actions/travel.h"
 #include "core/core.h"
 
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
 
-// Processes AI for a specific active Mobile.
-void AI::tick_mob(std::shared_ptr<Mobile> mob, uint32_t)
+
+// Finds a target in the same room that this Mobile is hostile towards, if any.
+std::shared_ptr<Mobile> AI::attack_target(std::shared_ptr<Mobile> mob)
 {
-    mob->add_second();  // This is called every second, per active Mobile.
-    const auto rng = core()->rng();
+    std::shared_ptr<Mobile> target = nullptr;
     const uint32_t location = mob->location();
-    const uint32_t player_location = core()->world()->player()->location();
-    const auto room = core()->world()->get_room(location);
-
-    // Scan the Mobile's hostility vector, looking for anyone they're hostile towards.
-    std::shared_ptr<Mobile> attack_target = nullptr;
     for (auto h : mob->hostility_vector())
     {
-        if (h == 0 && mob->location() == core()->world()->player()->location())
+        if (h == 0 && location == core()->world()->player()->location())
         {
-            attack_target = core()->world()->player();
+            target = core()->world()->player();
             break;
         }
-        else for (size_t m = 0; m < core()->world()->mob_count(); m++)
+        else
         {
-            const auto check_mob = core()->world()->mob_vec(m);
-            if (check_mob->id() == h && check_mob->location() == mob->location())
+            const auto check_mob = core()->world()->mob_by_id(h);
+            if (check_mob && check_mob->location() == location) target = check_mob;
+        }
+    }
+    return target;
+}
+
+// Checks if the AI can safely be fast-forwarded, with no Mobiles close enough to the player or in combat.
+bool AI::can_fast_forward()
+{
+    const auto world = core()->world();
+    const auto room = world->get_room(world->player()->location());
+
+    // Anything in the player's room, or in sight of it, needs to be processed second-by-second, as it can interact with the player at any moment.
+    if (world->mobs_in_room(room->id()).size()) return false;
+    for (int i = 0; i < Room::ROOM_LINKS_MAX; i++)
+        if (!room->fake_link(i) && world->mobs_in_room(room->link(i)).size()) return false;
+
+    // The same goes for any Mobiles which are currently fighting.
+    for (auto mob : world->active_mobs())
+        if (attack_target(mob)) return false;
+    return true;
+}
+
+// Catches up a dormant Mobile on the time it spent outside of the active rooms.
+void AI::catch_up(std::shared_ptr<Mobile> mob)
+{
+    // Mobiles outside of the active rooms don't get processed every second. Instead, when their room becomes active again, we give them a rough approximation of what they'd have been up to in the meantime.
+    const auto world = core()->world();
+    const auto time_weather = world->time_weather();
+    const uint32_t dormant = time_weather->time_passed_since(mob->last_active());
+    mob->set_last_active(time_weather->time_passed());
+    if (!dormant) return;
+
+    // Spawned Mobiles that have wandered away from home and been left alone long enough are quietly removed, so their spawn room can spawn something new.
+    if (dormant >= static_cast<uint32_t>(DESPAWN_TIME) && mob->spawn_room() && mob->location() != mob->spawn_room())
+    {
+        world->get_room(mob->spawn_room())->clear_tag(RoomTag::MobSpawned);
+        world->remove_mobile(mob->id());
+        return;
+    }
+    const uint32_t seconds = std::min(dormant, static_cast<uint32_t>(CATCH_UP_MAX));
+
+    // Catch up on any hit point regeneration that was missed.
+    const uint32_t regen_ticks = seconds / time_weather->heartbeat_interval(TimeWeather::Heartbeat::HP_REGEN);
+    for (uint32_t i = 0; i < regen_ticks && mob->hp() < mob->hp(true); i++)
+        mob->tick_hp_regen();
+
+    // Let the Mobile wander around, with the same odds as it would have when active. Nobody was around to see it, so this is done quietly, without messages. Closed doors are left alone, as nobody was there to open them either, and it won't wander into the player's room, as the player would've seen it arrive.
+    const uint32_t player_location = world->player()->location();
+    uint32_t elapsed = 0, when = 0;
+    while (next_wander(mob, &elapsed, elapsed + 1, seconds, &when))
+    {
+        mob->add_second(when - elapsed);
+        elapsed = when;
+        const int exit = random_exit(mob, false, core()->rng().get());
+        if (exit < 0) continue;
+        const auto room = world->get_room(mob->location());
+        const uint8_t flags = room->link_flags(exit);
+        if ((flags & Room::LINK_DOOR) && !(flags & Room::LINK_OPEN)) continue;
+        const uint32_t destination = room->link(exit);
+        if (destination == player_location) continue;
+        mob->set_location(destination);
+        mob->pass_time();
+    }
+    mob->add_second(seconds - elapsed);
+}
+
+// Carries out a decision made by decide().
+void AI::commit(std::shared_ptr<Mobile> mob, const Decision &decision)
+{
+    const auto world = core()->world();
+    const uint32_t location = mob->location();
+    const bool player_here = (location == world->player()->location());
+    switch (decision.action)
+    {
+        case Decision::Action::NONE: break;
+        case Decision::Action::ATTACK:
+            // Another Mobile may have killed or driven off the target earlier this second.
+            if (decision.target->is_dead() || decision.target->location() != location) break;
+            if (!decision.target->is_player() && !world->mob_by_id(decision.target->id())) break;
+            Combat::attack(mob, decision.target);
+            break;
+        case Decision::Action::CHANGE_STANCE: Combat::change_stance(mob, decision.stance); break;
+        case Decision::Action::COWER:
+            if (player_here) core()->message("{u}" + mob->name(Mobile::NAME_FLAG_THE) + " {u}cowers in fear!");
+            mob->pass_time();
+            break;
+        case Decision::Action::FLEE:
+            if (player_here) core()->message("{U}" + mob->name(Mobile::NAME_FLAG_THE) + " {U}flees in a blind panic!");
+            if (decision.exit < 0 || !ActionTravel::travel(mob, static_cast<Direction>(decision.exit), true))
             {
-                attack_target = check_mob;
-                break;
+                mob->pass_time();
+                if (player_here) core()->message("{0}{u}... But " + mob->he_she() + " can't get away!");
             }
-        }
+            mob->set_buff(Buff::Type::RECENTLY_FLED, FLEE_DEBUFF_TIME);
+            break;
+        case Decision::Action::TRAVEL: ActionTravel::travel(mob, static_cast<Direction>(decision.exit), true); break;
     }
+}
+
+// Decides what an active Mobile will do this second, without changing anything in the world.
+AI::Decision AI::decide(std::shared_ptr<Mobile> mob, Random *rng)
+{
+    Decision decision = { Decision::Action::NONE, -1, mob->stance(), nullptr };
+    const uint32_t location = mob->location();
+    const uint32_t player_location = core()->world()->player()->location();
+
+    // Scan the Mobile's hostility vector, looking for anyone they're hostile towards.
+    const auto attack_target = AI::attack_target(mob);
     if (attack_target)
     {
         // Fleeing happens regardless of the action timer. This is a concession to allow mobiles to even have a chance of realistically running away. Penalizing their action timer after fleeing leaves all sorts of problems, such as the mobile left standing there defenseless while the player character beats on them. It's not an ideal solution, but this is really the best I can do for now. This will need to be balanced better later.
         if (mob->tag(MobileTag::Coward))
         {
-            // Check if we've fled recently.
-            if (mob->has_buff(Buff::Type::RECENTLY_FLED))
-            {
-                if (mob->can_perform_action(FLEE_TIME))
-                {
-                    if (location == player_location) core()->message("{u}" + mob->name(Mobile::NAME_FLAG_THE) + " {u}cowers in fear!");
-                    mob->pass_time();
-                }
-                return;
-            }
-            else if (mob->can_perform_action(FLEE_TIME))
+            if (!mob->can_perform_action(FLEE_TIME)) return decision;   // If they don't have enough action time available to flee, just wait and charge it up, it won't take long.
+
+            // Check if we've fled recently. If not, pick an exit to flee through, dangerous or not.
+            if (mob->has_buff(Buff::Type::RECENTLY_FLED)) decision.action = Decision::Action::COWER;
+            else
             {
-                // Attempt a safe travel; if it fails, panic and attempt a more dangerous exit.
-                if (location == player_location) core()->message("{U}" + mob->name(Mobile::NAME_FLAG_THE) + " {U}flees in a blind panic!");
-                if (!travel_randomly(mob, true))
-                {
-                    mob->pass_time();
-                    if (location == player_location) core()->message("{0}{u}... But " + mob->he_she() + " can't get away!");
-                }
-                mob->set_buff(Buff::Type::RECENTLY_FLED, FLEE_DEBUFF_TIME);
-                return;
+                decision.action = Decision::Action::FLEE;
+                decision.exit = random_exit(mob, true, rng);
             }
-            else return;    // If they don't have enough action time available to flee, just wait and charge it up, it won't take long.
+            return decision;
         }
 
         // The rest of the rules here apply to non-cowardly Mobiles.
@@ -81,7 +172,7 @@ void AI::tick_mob(std::shared_ptr<Mobile> mob, uint32_t)
             else if (hp_ratio >= STANCE_AGGRESSIVE_HP_RATIO) desired_stance = CombatStance::AGGRESSIVE;
 
             // Chance to attempt to counter the target's stance.
-            else if (core()->rng()->rnd(STANCE_COUNTER_CHANCE) == 1)
+            else if (rng->rnd(STANCE_COUNTER_CHANCE) == 1)
             {
                 switch (attack_target->stance())
                 {
@@ -92,18 +183,23 @@ void AI::tick_mob(std::shared_ptr<Mobile> mob, uint32_t)
             }
 
             // Chance to just pick a stance randomly. Sometimes, the unexpected can be useful!
-            else if (core()->rng()->rnd(STANCE_RANDOM_CHANCE) == 1) desired_stance = static_cast<CombatStance>(core()->rng()->rnd(0, 2));
+            else if (rng->rnd(STANCE_RANDOM_CHANCE) == 1) desired_stance = static_cast<CombatStance>(rng->rnd(0, 2));
 
             if (desired_stance != mob->stance())
             {
-                Combat::change_stance(mob, desired_stance);
-                return;
+                decision.action = Decision::Action::CHANGE_STANCE;
+                decision.stance = desired_stance;
+                return decision;
             }
         }
 
         // For non-cowardly NPCs, we'll wait until there's sufficient action time available to perform an attack. If not, just wait until there is. This will prevent angry NPCs from just doing something else entirely, instead of winding up to attack.
-        if (mob->can_perform_action(mob->attack_speed())) Combat::attack(mob, attack_target);
-        return;
+        if (mob->can_perform_action(mob->attack_speed()))
+        {
+            decision.action = Decision::Action::ATTACK;
+            decision.target = attack_target;
+        }
+        return decision;
     }
 
     if (mob->tag(MobileTag::AggroOnSight) && rng->rnd(AGGRO_CHANCE) == 1 && location == player_location)
@@ -111,45 +207,174 @@ void AI::tick_mob(std::shared_ptr<Mobile> mob, uint32_t)
         // Unlike the code above -- which handles NPCs that have a specific hatred for a specific mobile (or the player), this is more of a general 'picking a fight' situation. If action time isn't available, we'll allow the option to do something else in the meantime, because this particular mobile isn't hellbent on unleashing limitless unlimited unprecedented eternal terrible violence on anyone *in particular*.
         if (mob->can_perform_action(mob->attack_speed()))
         {
-            Combat::attack(mob, core()->world()->player());
-            return;
+            decision.action = Decision::Action::ATTACK;
+            decision.target = core()->world()->player();
+            return decision;
         }
     }
 
     if (rng->rnd(TRAVEL_CHANCE) == 1 && !mob->has_buff(Buff::Type::RECENTLY_FLED))
     {
         // This is another concession I'm making for mobiles -- all exits will 'cost' the same, while for the player, 'longer' exits cost more. Why? Because this AI code is ticking once an in-game second, it'll end up heavily favouring the shorter exit routs as soon as the action time is available, which will result in much less interesting AI behaviour.
+        // If there are no valid exits, we'll just continue looking for more actions to perform.
         if (mob->can_perform_action(ActionTravel::TRAVEL_TIME_NORMAL))
         {
-            // If the attempt fails (no valid exits, etc.) we'll just continue looking for more actions to perform.
-            if (travel_randomly(mob, false)) return;
+            decision.exit = random_exit(mob, false, rng);
+            if (decision.exit >= 0) decision.action = Decision::Action::TRAVEL;
         }
     }
+    return decision;
+}
+
+// Fast-forwards the AI on all Mobiles in active rooms by a number of seconds. Only valid when can_fast_forward() is true.
+void AI::fast_forward(uint32_t seconds)
+{
+    // With nobody near the player and nobody fighting, the only thing a Mobile can do is wander, which would normally be a 1 in TRAVEL_CHANCE roll each second once enough action time has built up.
+    // Rather than rolling every second, we roll once for how many seconds it'll be until the next successful roll (see next_wander()), and then process the resulting travel events in the same order they'd have happened second-by-second.
+    // The odds are the same, but the RNG is drawn from in a different order than it would be second-by-second, so a fast-forwarded game won't play out the same as one ticked a second at a time with the same seed.
+    const auto mobs = core()->world()->active_mobs();
+    const uint32_t time_passed = core()->world()->time_weather()->time_passed();
+    std::vector<uint32_t> elapsed(mobs.size(), 0);  // How many seconds have been applied to each Mobile's action timer so far.
+    std::priority_queue<std::pair<uint32_t, size_t>, std::vector<std::pair<uint32_t, size_t>>, std::greater<std::pair<uint32_t, size_t>>> events;
+
+    uint32_t when = 0;
+    for (size_t m = 0; m < mobs.size(); m++)
+        if (next_wander(mobs.at(m), &elapsed.at(m), 1, seconds, &when)) events.push(std::make_pair(when, m));
+    while (events.size())
+    {
+        const auto event = events.top();
+        events.pop();
+        const auto mob = mobs.at(event.second);
+        mob->add_second(event.first - elapsed.at(event.second));
+        elapsed.at(event.second) = event.first;
+        travel_randomly(mob, false);
+
+        // Keep rolling from the next second; after a successful move, the drained action timer will hold off any further travel.
+        if (next_wander(mob, &elapsed.at(event.second), event.first + 1, seconds, &when)) events.push(std::make_pair(when, event.second));
+    }
 
+    // Any Mobile that didn't use all its time gets the rest added to its action timer now.
+    for (size_t m = 0; m < mobs.size(); m++)
+    {
+        mobs.at(m)->add_second(seconds - elapsed.at(m));
+        mobs.at(m)->set_last_active(time_passed);
+    }
 }
 
-// Ticks all the mobiles in active rooms.
-void AI::tick_mobs()
+// The most seconds the AI can be fast-forwarded right now, without any Mobile being able to reach the player's room.
+uint32_t AI::fast_forward_limit()
 {
-    for (size_t m = 0; m < core()->world()->mob_count(); m++)
-        tick_mob(core()->world()->mob_vec(m), m);
+    // A Mobile N rooms away from the player has to wander N times to reach them, and each trip takes a full ActionTravel::TRAVEL_TIME_NORMAL of action time. The skip has to end before the
+    // soonest any Mobile could possibly make its last trip, so it can be seen coming. The room distances are only valid if the player hasn't moved since they were last worked out.
+    const auto world = core()->world();
+    if (world->room_distance(world->player()->location())) return 1;
+    uint32_t limit = UINT32_MAX;
+    for (auto mob : world->active_mobs())
+    {
+        const uint32_t distance = world->room_distance(mob->location());
+        if (distance == World::ROOM_INACTIVE) continue;
+        const float first_trip = std::max(1.0f, std::ceil(ActionTravel::TRAVEL_TIME_NORMAL - mob->action_timer()));
+        const uint32_t last_trip = static_cast<uint32_t>(first_trip) + static_cast<uint32_t>(ActionTravel::TRAVEL_TIME_NORMAL) * (distance ? distance - 1 : 0);
+        limit = std::min(limit, last_trip - 1);
+    }
+    return std::max<uint32_t>(limit, 1);
 }
 
-// Sends the Mobile in a random direction.
-bool AI::travel_randomly(std::shared_ptr<Mobile> mob, bool allow_dangerous_exits)
+// Charges a Mobile's action timer until it can travel, then rolls for the second it next decides to wander. Returns false if that won't happen by the time limit.
+bool AI::next_wander(std::shared_ptr<Mobile> mob, uint32_t *elapsed, uint32_t from, uint32_t until, uint32_t *when)
 {
-    const uint32_t location = mob->location();
-    const auto room = core()->world()->get_room(location);
+    // Wandering is normally a 1 in TRAVEL_CHANCE roll each second once enough action time has built up. Rather than rolling every second, we roll once for how many failures there'll be before the next success (a geometric distribution, which gives the same odds).
+    if (mob->has_buff(Buff::Type::RECENTLY_FLED)) return false; // Buffs don't tick while this is being worked out, so this can't change part-way through.
+    while (true)
+    {
+        if (from > until) return false;
+        mob->add_second(from - *elapsed);
+        *elapsed = from;
+        if (mob->can_perform_action(ActionTravel::TRAVEL_TIME_NORMAL)) break;
+        from++;
+    }
+    const double roll = 1.0 - core()->rng()->frnd(0, 1);
+    if (roll <= 0) return false;
+    const double fails = std::floor(std::log(roll) / std::log1p(-1.0 / TRAVEL_CHANCE));
+    if (fails > until - from) return false;
+    *when = from + static_cast<uint32_t>(fails);
+    return true;
+}
+
+// Picks a random viable exit for this Mobile, or -1 if there are none.
+int AI::random_exit(std::shared_ptr<Mobile> mob, bool allow_dangerous_exits, Random *rng)
+{
+    const auto graph = core()->world()->room_graph();
+    const uint32_t room = graph->index(mob->location());
 
     std::vector<int> viable_exits;
-    for (int i = 0; i < Room::ROOM_LINKS_MAX; i++)
+    for (auto link = graph->begin(room); link != graph->end(room); link++)
     {
-        if (room->fake_link(i)) continue;
-        if (!allow_dangerous_exits && room->dangerous_link(i)) continue;
-        if (room->link_tag(i, LinkTag::Locked)) continue;
-        if (mob->tag(MobileTag::CannotOpenDoors) && room->link_tag(i, LinkTag::Openable) && !room->link_tag(i, LinkTag::Open)) continue;
-        viable_exits.push_back(i);
+        if (!allow_dangerous_exits && (link->flags & Room::LINK_SKY)) continue;
+        if (link->flags & Room::LINK_LOCKED) continue;
+        if (mob->tag(MobileTag::CannotOpenDoors) && (link->flags & Room::LINK_DOOR) && !(link->flags & Room::LINK_OPEN)) continue;
+        viable_exits.push_back(static_cast<int>(link->dir));
     }
-    if (viable_exits.size()) return ActionTravel::travel(mob, static_cast<Direction>(viable_exits.at(core()->rng()->rnd(0, viable_exits.size() - 1))), true);
+    if (viable_exits.size()) return viable_exits.at(rng->rnd(0, viable_exits.size() - 1));
+    else return -1;
+}
+
+// Ticks all the mobiles in active rooms.
+void AI::tick_mobs()
+{
+    // The AI runs in two phases. First, each active Mobile decides what it wants to do, based only on the state of the world at the start of this second. Nothing is changed while deciding, so this can be split across multiple threads.
+    // Then the decisions are carried out one at a time, in unique ID order. Each Mobile gets its own random number stream, seeded from the main RNG and its unique ID, so the results are the same no matter how many threads were used.
+    const auto world = core()->world();
+    const auto mobs = world->active_mobs();
+    const uint32_t time_passed = world->time_weather()->time_passed();
+    const uint32_t seed = core()->rng()->rnd(0, UINT32_MAX);
+    for (auto mob : mobs)
+    {
+        mob->add_second();  // This is called every second, per active Mobile.
+        mob->set_last_active(time_passed);
+    }
+
+    // An exception that escapes a thread would end the program on the spot, so anything thrown while deciding is caught, then thrown again on the main thread once every thread has finished,
+    // where Guru can deal with it as usual. If more than one range throws, the one nearest the start of the Mobile list wins, the same as if it had all been done on one thread.
+    std::vector<Decision> decisions(mobs.size());
+    auto decide_range = [&mobs, &decisions, seed](size_t start, size_t end, std::exception_ptr *error) {
+        try
+        {
+            for (size_t m = start; m < end; m++)
+            {
+                Random rng(seed, mobs.at(m)->id());
+                decisions.at(m) = decide(mobs.at(m), &rng);
+            }
+        }
+        catch (...)
+        {
+            *error = std::current_exception();
+        }
+    };
+    const auto thread_pool = core()->thread_pool();
+    const size_t thread_count = std::min<size_t>(thread_pool->size(), mobs.size() / PARALLEL_MIN_MOBS);
+    std::vector<std::exception_ptr> errors(std::max<size_t>(thread_count, 1));
+    if (thread_count > 1)
+    {
+        const size_t chunk = (mobs.size() + thread_count - 1) / thread_count;
+        thread_pool->run(thread_count, [&decide_range, &errors, &mobs, chunk](size_t t) {
+            decide_range(std::min(t * chunk, mobs.size()), std::min((t + 1) * chunk, mobs.size()), &errors.at(t)); });
+    }
+    else decide_range(0, mobs.size(), &errors.at(0));
+    for (auto error : errors)
+        if (error) std::rethrow_exception(error);
+
+    for (size_t m = 0; m < mobs.size(); m++)
+    {
+        if (!world->mob_by_id(mobs.at(m)->id())) continue;  // Skip any Mobiles killed by an earlier Mobile's actions this tick.
+        commit(mobs.at(m), decisions.at(m));
+    }
+}
+
+// Sends the Mobile in a random direction.
+bool AI::travel_randomly(std::shared_ptr<Mobile> mob, bool allow_dangerous_exits)
+{
+    const int exit = random_exit(mob, allow_dangerous_exits, core()->rng().get());
+    if (exit >= 0) return ActionTravel::travel(mob, static_cast<Direction>(exit), true);
     else return false;
 }
@@ -4,6 +4,7 @@
 #ifndef GREAVE_ACTIONS_AI_H_
 #define GREAVE_ACTIONS_AI_H_
 
+#include "core/random.h"
 #include "world/mobile.h"
 
 #include <cstdint>
@@ -13,12 +14,29 @@
 class AI
 {
 public:
-    static void tick_mobs();    // Ticks all the mobiles in active rooms.
+    static bool can_fast_forward();                 // Checks if the AI can safely be fast-forwarded, with no Mobiles close enough to the player or in combat.
+    static void catch_up(std::shared_ptr<Mobile> mob);  // Catches up a dormant Mobile on the time it spent outside of the active rooms.
+    static void fast_forward(uint32_t seconds);     // Fast-forwards the AI on all Mobiles in active rooms by a number of seconds. Only valid when can_fast_forward() is true, and for no more than fast_forward_limit() seconds.
+    static uint32_t fast_forward_limit();           // The most seconds the AI can be fast-forwarded right now, without any Mobile being able to reach the player's room.
+    static void tick_mobs();                        // Ticks all the mobiles in active rooms.
 
 private:
+    struct Decision
+    {
+        enum class Action : uint8_t { NONE, ATTACK, CHANGE_STANCE, COWER, FLEE, TRAVEL };
+
+        Action                  action; // What the Mobile has decided to do.
+        int                     exit;   // The exit to take when fleeing or traveling, or -1 if there's nowhere to go.
+        CombatStance            stance; // The stance to change to.
+        std::shared_ptr<Mobile> target; // The Mobile to attack.
+    };
+
     static constexpr int    AGGRO_CHANCE =                  60;     // 1 in X chance of starting a fight.
+    static constexpr int    CATCH_UP_MAX =                  3600;   // The most time (in seconds) that will be simulated for a dormant Mobile when its room becomes active again. Any dormant time beyond this is simply skipped.
+    static constexpr int    DESPAWN_TIME =                  86400;  // Spawned Mobiles left dormant away from their spawn room for this many seconds are removed, letting the spawn room spawn something new.
     static constexpr int    FLEE_DEBUFF_TIME =              48;     // The length of time the fleeing debuff lasts.
     static constexpr float  FLEE_TIME =                     60;     // The action time it takes to flee in terror.
+    static constexpr int    PARALLEL_MIN_MOBS =             128;    // The minimum number of active Mobiles per thread before AI decisions are split across multiple threads.
     static constexpr float  STANCE_AGGRESSIVE_HP_PERCENT =  20;     // When a Mobile's target drops below this many hit points, they'll got to an aggressive stance.
     static constexpr float  STANCE_AGGRESSIVE_HP_RATIO =    1.3f;   // When a mobile's ratio of hit points lost compared to their target's hit points lost goes above this level, they'll go to an aggressive stance.
     static constexpr int    STANCE_COUNTER_CHANCE =         200;    // 1 in X chance to attempt to counter the target's choice of combat stance.
@@ -27,7 +45,11 @@ private:
     static constexpr int    STANCE_RANDOM_CHANCE =          500;    // 1 in X chance to pick a random stance, rather than making a strategic decision.
     static constexpr int    TRAVEL_CHANCE =                 300;    // 1 in X chance of traveling to another room.
 
-    static void tick_mob(std::shared_ptr<Mobile> mob, uint32_t vec_pos);    // Processes AI for a specific active Mobile.
+    static std::shared_ptr<Mobile>  attack_target(std::shared_ptr<Mobile> mob);     // Finds a target in the same room that this Mobile is hostile towards, if any.
+    static void     commit(std::shared_ptr<Mobile> mob, const Decision &decision);  // Carries out a decision made by decide().
+    static Decision decide(std::shared_ptr<Mobile> mob, Random *rng);   // Decides what an active Mobile will do this second, without changing anything in the world.
+    static bool next_wander(std::shared_ptr<Mobile> mob, uint32_t *elapsed, uint32_t from, uint32_t until, uint32_t *when);    // Charges a Mobile's action timer until it can travel, then rolls for the second it next decides to wander. Returns false if that won't happen by the time limit.
+    static int  random_exit(std::shared_ptr<Mobile> mob, bool allow_dangerous_exits, Random *rng);    // Picks a random viable exit for this Mobile, or -1 if there are none.
     static bool travel_randomly(std::shared_ptr<Mobile> mob, bool allow_dangerous_exits);   // Sends the Mobile in a random direction.
 };
 
@@ -4,6 +4,7 @@
 #include "actions/cheat.h"
 #include "actions/look.h"
 #include "core/core.h"
+#include "core/pool.h"
 #include "core/strx.h"
 
 
@@ -65,6 +66,19 @@ void ActionCheat::heal(size_t target)
     }
 }
 
+// Displays the object pool statistics.
+void ActionCheat::pool_stats()
+{
+    for (int i = 0; i < static_cast<int>(PoolType::_END); i++)
+    {
+        const PoolType type = static_cast<PoolType>(i);
+        const Pool::Stats &stats = Pool::stats(type);
+        core()->message("{G}" + std::string(Pool::type_name(type)) + "{g}: {G}" + std::to_string(stats.live) + " {g}live, {G}" + std::to_string(stats.peak) + " {g}peak, {G}" +
+            std::to_string(stats.total) + " {g}allocated in total.");
+    }
+    core()->message("{g}The pools have reserved {G}" + std::to_string(Pool::reserved() / 1024) + "{g}KB of memory.");
+}
+
 // Attempts to spawn an item.
 void ActionCheat::spawn_item(std::string item)
 {
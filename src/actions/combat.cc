@@ -80,7 +80,7 @@ bool Combat::attack(std::shared_ptr<Mobile> attacker, std::shared_ptr<Mobile> de
     bool attacked = false;
 
     // RapidStrike is only for melee weapons.
-    if (attacker->tag(MobileTag::RapidStrike) || attacker->tag(MobileTag::HeadlongStrike))
+    if (attacker->tag_any({MobileTag::RapidStrike, MobileTag::HeadlongStrike}))
     {
         if (main_hand[0] && main_hand[0]->subtype() == ItemSub::RANGED) main_can_attack[0] = false;
         if (off_hand[0] && off_hand[0]->subtype() == ItemSub::RANGED) off_can_attack[0] = false;
@@ -224,58 +224,10 @@ std::string Combat::damage_str(uint32_t damage, std::shared_ptr<Mobile> def, boo
 // Determines type of weapons wielded by a Mobile.
 void Combat::determine_wield_type(std::shared_ptr<Mobile> mob, WieldType* wield_type, bool* can_main_attack, bool* can_off_attack)
 {
-    std::shared_ptr<Item> main_hand = mob->equ()->get(EquipSlot::HAND_MAIN);
-    std::shared_ptr<Item> off_hand = mob->equ()->get(EquipSlot::HAND_OFF);
-    *can_main_attack = main_hand && main_hand->type() == ItemType::WEAPON;
-    *can_off_attack = off_hand && off_hand->type() == ItemType::WEAPON;
-    const bool off_shield = (off_hand && off_hand->type() == ItemType::SHIELD);
-
-    // If both hands are empty, it's a melee attack.
-    if (!main_hand && !off_hand)
-    {
-        *wield_type = WieldType::UNARMED;
-        *can_main_attack = true;
-        *can_off_attack = true;
-    }
-
-    // Dual-wielding is an easy one to detect. One melee weapon in each hand.
-    else if (*can_main_attack && *can_off_attack) *wield_type = WieldType::DUAL_WIELD;
-
-    // Good old sword and board: melee weapon in one hand, shield in the other.
-    else if (*can_main_attack && off_shield) *wield_type = WieldType::ONE_HAND_PLUS_SHIELD;
-
-    // Two-handers can only be equipped in the main hand.
-    else if (*can_main_attack && main_hand->tag(ItemTag::TwoHanded)) *wield_type = WieldType::TWO_HAND;
-
-    // Single-wielding a one-handed weapon isn't the best choice, but it can be done.
-    else if ((*can_main_attack && !off_hand) || (*can_off_attack && !main_hand))
-    {
-        // Check if we're using a hand-and-a-half weapon with the other hand free, or just a regular one-hander on its own.
-        if ((*can_main_attack && main_hand->tag(ItemTag::HandAndAHalf)) || (*can_off_attack && off_hand->tag(ItemTag::HandAndAHalf))) *wield_type = WieldType::HAND_AND_A_HALF_2H;
-        else *wield_type = WieldType::SINGLE_WIELD;
-    }
-
-    // We've already checked for sword-and-board above, so the only option left if one hand is holding a weapon is that the other hand is holding something
-    // non-combat related. Yay for the process of elimination!
-    else if (*can_main_attack || *can_off_attack) *wield_type = WieldType::ONE_HAND_PLUS_EXTRA;
-
-    // Now we're getting into the silly options, but gotta cover every base. Is the Mobile wielding a shield in one hand, and nothing in the other?
-    // As ridiculous as that is for a loadout, punching while holding a shield should be allowed.
-    else if (off_shield && !main_hand) *wield_type = WieldType::UNARMED_PLUS_SHIELD;
-
-    // If either hand is now free, by process of elimination, it must be an unarmed attack with a non-combat item in the other hand.
-    else if (!main_hand || !off_hand)
-    {
-        *wield_type = WieldType::UNARMED;
-        if (!main_hand) *can_main_attack = true;
-        if (!off_hand) *can_off_attack = true;
-    }
-
-    // The only other possible configurations, through process of elimination, is shield+misc:
-    else if (off_shield) *wield_type = WieldType::SHIELD_ONLY;
-
-    // ...or the final option, which is the only thing that remains now, both hands occupied by non-combat items:
-    else *wield_type = WieldType::NONE;
+    const Mobile::GearStats &gear = mob->gear_stats();
+    *wield_type = gear.wield_type;
+    if (can_main_attack) *can_main_attack = gear.can_main_attack;
+    if (can_off_attack) *can_off_attack = gear.can_off_attack;
 }
 
 // Performs an attack with a single weapon.
@@ -704,3 +656,58 @@ void Combat::weapon_poison_effect(std::shared_ptr<Mobile> defender, uint32_t dam
     if (!poison_severity) poison_severity = 1;
     defender->set_buff(Buff::Type::POISON, poison_time, poison_severity, true);
 }
+
+// Works out how a pair of Items (or empty hands) would be wielded.
+void Combat::wield_type_for_gear(std::shared_ptr<Item> main_hand, std::shared_ptr<Item> off_hand, WieldType* wield_type, bool* can_main_attack, bool* can_off_attack)
+{
+    *can_main_attack = main_hand && main_hand->type() == ItemType::WEAPON;
+    *can_off_attack = off_hand && off_hand->type() == ItemType::WEAPON;
+    const bool off_shield = (off_hand && off_hand->type() == ItemType::SHIELD);
+
+    // If both hands are empty, it's a melee attack.
+    if (!main_hand && !off_hand)
+    {
+        *wield_type = WieldType::UNARMED;
+        *can_main_attack = true;
+        *can_off_attack = true;
+    }
+
+    // Dual-wielding is an easy one to detect. One melee weapon in each hand.
+    else if (*can_main_attack && *can_off_attack) *wield_type = WieldType::DUAL_WIELD;
+
+    // Good old sword and board: melee weapon in one hand, shield in the other.
+    else if (*can_main_attack && off_shield) *wield_type = WieldType::ONE_HAND_PLUS_SHIELD;
+
+    // Two-handers can only be equipped in the main hand.
+    else if (*can_main_attack && main_hand->tag(ItemTag::TwoHanded)) *wield_type = WieldType::TWO_HAND;
+
+    // Single-wielding a one-handed weapon isn't the best choice, but it can be done.
+    else if ((*can_main_attack && !off_hand) || (*can_off_attack && !main_hand))
+    {
+        // Check if we're using a hand-and-a-half weapon with the other hand free, or just a regular one-hander on its own.
+        if ((*can_main_attack && main_hand->tag(ItemTag::HandAndAHalf)) || (*can_off_attack && off_hand->tag(ItemTag::HandAndAHalf))) *wield_type = WieldType::HAND_AND_A_HALF_2H;
+        else *wield_type = WieldType::SINGLE_WIELD;
+    }
+
+    // We've already checked for sword-and-board above, so the only option left if one hand is holding a weapon is that the other hand is holding something
+    // non-combat related. Yay for the process of elimination!
+    else if (*can_main_attack || *can_off_attack) *wield_type = WieldType::ONE_HAND_PLUS_EXTRA;
+
+    // Now we're getting into the silly options, but gotta cover every base. Is the Mobile wielding a shield in one hand, and nothing in the other?
+    // As ridiculous as that is for a loadout, punching while holding a shield should be allowed.
+    else if (off_shield && !main_hand) *wield_type = WieldType::UNARMED_PLUS_SHIELD;
+
+    // If either hand is now free, by process of elimination, it must be an unarmed attack with a non-combat item in the other hand.
+    else if (!main_hand || !off_hand)
+    {
+        *wield_type = WieldType::UNARMED;
+        if (!main_hand) *can_main_attack = true;
+        if (!off_hand) *can_off_attack = true;
+    }
+
+    // The only other possible configurations, through process of elimination, is shield+misc:
+    else if (off_shield) *wield_type = WieldType::SHIELD_ONLY;
+
+    // ...or the final option, which is the only thing that remains now, both hands occupied by non-combat items:
+    else *wield_type = WieldType::NONE;
+}
@@ -22,9 +22,9 @@ public:
     static std::string  damage_number_str(uint32_t damage, uint32_t blocked, bool crit, bool bleed, bool poison);   // Generates a standard-format damage number string.
     static std::string  damage_str(uint32_t damage, std::shared_ptr<Mobile> def, bool heat);        // Returns an appropriate damage string.
 
-private:
-    enum class WieldType : uint8_t { NONE, UNARMED, ONE_HAND_PLUS_EXTRA, TWO_HAND, DUAL_WIELD, HAND_AND_A_HALF_2H, SINGLE_WIELD, ONE_HAND_PLUS_SHIELD, SHIELD_ONLY, UNARMED_PLUS_SHIELD };
+    static void         wield_type_for_gear(std::shared_ptr<Item> main_hand, std::shared_ptr<Item> off_hand, WieldType* wield_type, bool* can_main_attack, bool* can_off_attack); // Works out how a pair of Items (or empty hands) would be wielded.
 
+private:
     static constexpr float  ATTACKER_DAMAGE_MULTIPLIER_ANEMIC =         0.5f;   // The damage multiplier when a Mobile with the Anemic tag attacks in melee combat.
     static constexpr float  ATTACKER_DAMAGE_MULTIPLIER_BRAWNY =         1.25f;  // The damage multiplier when a Mobile with the Brawny tag attacks in melee combat.
     static constexpr float  ATTACKER_DAMAGE_MULTIPLIER_FEEBLE =         0.75f;  // The damage multiplier when a Mobile with the Feeble tag attacks in melee combat.
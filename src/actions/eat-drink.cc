@@ -141,7 +141,7 @@ void ActionEatDrink::empty(size_t inv_pos, bool confirm)
     else
     {
         item->set_charge(0);
-        item->clear_meta("liquid");
+        item->set_liquid("");
     }
 }
 
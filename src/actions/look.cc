@@ -283,11 +283,9 @@ void ActionLook::look()
 
     // Mobiles nearby.
     std::vector<std::string> mobs_nearby;
-    for (size_t i = 0; i < world->mob_count(); i++)
+    for (auto world_mob : world->mobs_in_room(player->location()))
     {
-        const auto world_mob = world->mob_vec(i);
         if (!world_mob) continue; // Ignore any nullptr Mobiles.
-        if (world_mob->location() != player->location()) continue;  // Ignore any Mobiles not in this Room.
         mobs_nearby.push_back((world_mob->is_hostile() ? "{R}" : "{Y}") + world_mob->name(Mobile::NAME_FLAG_NO_COLOUR | Mobile::NAME_FLAG_HEALTH) + "{w}");
     }
     if (mobs_nearby.size())
@@ -306,11 +304,10 @@ void ActionLook::look()
         std::vector<std::string> adjacent_this_direction;
         const auto adjacent_room = world->get_room(room->link(i));
         if (adjacent_room->light() < Room::LIGHT_VISIBLE) continue; // Can't see into dark rooms!
-        for (size_t m = 0; m < world->mob_count(); m++)
+        for (auto mob : world->mobs_in_room(adjacent_room->id()))
         {
-            const auto mob = world->mob_vec(m);
             const std::string colour = (mob->is_hostile() ? "{R}" : "{Y}");
-            if (mob->location() == adjacent_room->id()) adjacent_this_direction.push_back(colour + mob->name(Mobile::NAME_FLAG_NO_COLOUR) + "{w}");
+            adjacent_this_direction.push_back(colour + mob->name(Mobile::NAME_FLAG_NO_COLOUR) + "{w}");
         }
         if (!adjacent_this_direction.size()) continue;
         StrX::collapse_list(adjacent_this_direction);
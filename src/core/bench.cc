@@ -0,0 +1,257 @@
+// core/bench.cc -- Microbenchmarks for the game's hot paths, built as the separate greave_bench binary.
+// Copyright (c) 2021 Raine "Gravecat" Simmons. Licensed under the GNU Affero General Public License v3 or any later version.
+
+#include "3rdparty/SQLiteCpp/Transaction.h"
+#include "actions/ai.h"
+#include "core/bench.h"
+#include "core/core.h"
+#include "core/list.h"
+#include "core/pool.h"
+#include "core/save-writer.h"
+#include "core/strx.h"
+#include "world/inventory.h"
+#include "world/mobile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+
+extern std::shared_ptr<Core> greave;    // The main Core object, from core.cc.
+
+
+// Benchmark program entry point.
+int main(int argc, char* argv[])
+{
+    // Check command-line parameters.
+    std::vector<std::string> parameters(argv, argv + argc);
+    std::string filter;
+    double scale = 1;
+    uint32_t seed = 1;
+    for (size_t i = 1; i < parameters.size(); i++)
+    {
+        const std::string &param = parameters.at(i);
+        if (!param.compare("-filter") && i + 1 < parameters.size()) filter = parameters.at(++i);
+        else if (!param.compare("-scale") && i + 1 < parameters.size()) scale = std::strtod(parameters.at(++i).c_str(), nullptr);
+        else if (!param.compare("-seed") && i + 1 < parameters.size()) seed = std::strtoul(parameters.at(++i).c_str(), nullptr, 10);
+    }
+
+    greave = std::make_shared<Core>();
+    try
+    {
+        greave->init(true);
+        std::cout << "# greave_bench\tseed\t" << greave->headless_game(seed) << std::endl;
+        Bench::run_all(filter, scale > 0 ? scale : 1);
+        greave->cleanup();
+    }
+    catch (std::exception& e)
+    {
+        greave->guru()->halt(e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// AI::tick_mobs(), with extra Mobiles spawned into the active rooms.
+void Bench::ai_tick_mobs(size_t iterations)
+{
+    const auto world = core()->world();
+    const auto &active_rooms = world->active_rooms();
+    for (int i = 0; i < BENCH_ACTIVE_MOBS; i++)
+    {
+        auto mob = world->get_mob("FALLOW_DEER");
+        mob->set_location(active_rooms.at(active_rooms.size() > 1 ? 1 + i % (active_rooms.size() - 1) : 0));   // Keep them out of the player's room where possible.
+        world->add_mobile(mob);
+    }
+    time("ai_tick_mobs", iterations, [] { AI::tick_mobs(); });
+}
+
+// Inventory::add_item(), stacking onto an already well-stocked Inventory.
+void Bench::inventory_add_item(size_t iterations)
+{
+    const auto world = core()->world();
+    Inventory inv(Inventory::PID_PREFIX_INVENTORY);
+    const auto every_item = world->get_list("EVERY_ITEM");
+    for (int i = 0; i < BENCH_INVENTORY_SIZE; i++)
+        inv.add_item(every_item->rnd().str);
+
+    // The first stack is added last, so each new Item has to be checked against everything else in the Inventory before it stacks.
+    inv.add_item(world->get_item("BREAD"));
+    const auto bread = world->get_item("BREAD");
+    time("inventory_add_item", iterations, [&inv, &bread] { inv.add_item(bread); });
+}
+
+// Inventory::add_item() and erase(), on an Inventory that's running short of free parser IDs.
+void Bench::inventory_parser_ids(size_t iterations)
+{
+    Inventory inv(Inventory::PID_PREFIX_INVENTORY);
+    const auto sword = core()->world()->get_item("KNIGHTLY_SWORD");
+    for (int i = 0; i < BENCH_CROWDED_SIZE; i++)
+        inv.add_item(Pool::make_shared<Item>(*sword));
+    time("inventory_parser_ids", iterations, [&inv, &sword] {
+        inv.add_item(Pool::make_shared<Item>(*sword));
+        inv.erase(inv.count() - 1);
+    });
+}
+
+// Inventory::sort(), on a well-stocked Inventory.
+void Bench::inventory_sort(size_t iterations)
+{
+    Inventory inv(Inventory::PID_PREFIX_SHOP);
+    const auto every_item = core()->world()->get_list("EVERY_ITEM");
+    for (int i = 0; i < BENCH_INVENTORY_SIZE; i++)
+        inv.add_item(every_item->rnd().str);
+    time("inventory_sort", iterations, [&inv] { inv.sort(); });
+}
+
+// Item::is_identical(), comparing two Items that are identical.
+void Bench::item_is_identical(size_t iterations)
+{
+    const auto first = core()->world()->get_item("KNIGHTLY_SWORD"), second = core()->world()->get_item("KNIGHTLY_SWORD");
+    bool identical = true;
+    time("item_is_identical", iterations, [&first, &second, &identical] { identical = first->is_identical(second) && identical; });
+    if (!identical) throw std::runtime_error("Identical items failed to compare as identical.");
+}
+
+// List::rnd(), on a List which links to a sub-list.
+void Bench::list_rnd(size_t iterations)
+{
+    const auto list = core()->world()->get_list("GEAR_GOBLIN_SCOUT");
+    time("list_rnd", iterations, [&list] { list->rnd(); });
+}
+
+// MessageLog::reprocess_output(), on a full message log.
+void Bench::message_log_reprocess_output(size_t iterations)
+{
+    MessageLog log;
+    for (int i = 0; i < core()->prefs()->log_max_size; i++)
+        log.output_raw_.push_back("{G}The {g}goblin scout {G}swings its {Y}rusty shortsword {G}at you, but you {C}deflect the blow {G}with your {U}wooden shield{G}! [" + std::to_string(i) + "]");
+    time("message_log_reprocess_output", iterations, [&log] { log.reprocess_output(); });
+}
+
+// The attack speed and defensive modifiers a Mobile gets from its gear, as checked on every attack.
+void Bench::mobile_gear_stats(size_t iterations)
+{
+    const auto mob = core()->world()->get_mob("GOBLIN_SCOUT");
+    float total = 0;
+    time("mobile_gear_stats", iterations, [&mob, &total] { total += mob->attack_speed() + mob->block_mod() + mob->dodge_mod() + mob->parry_mod(); });
+    if (total <= 0) throw std::runtime_error("Invalid gear stats for " + mob->name() + ".");
+}
+
+// Parser::parse(), with a command that doesn't pass any time.
+void Bench::parser_parse(size_t iterations)
+{
+    const auto parser = core()->parser();
+    time("parser_parse", iterations, [&parser] { parser->parse("look"); });
+}
+
+// Runs every benchmark whose name contains the filter string, printing the results.
+void Bench::run_all(const std::string &filter, double scale)
+{
+    struct BenchEntry
+    {
+        std::string                     name;
+        size_t                          iterations;
+        std::function<void(size_t)>     func;
+    };
+
+    // AI and buff ticks are last, as the extra Mobiles they spawn would otherwise affect the other results. Saving comes after them, so there's plenty in the World to save.
+    const std::vector<BenchEntry> benches = {
+        { "strx_string_explode_colour", 100000, strx_string_explode_colour },
+        { "message_log_reprocess_output", 100, message_log_reprocess_output },
+        { "item_is_identical", 1000000, item_is_identical },
+        { "inventory_add_item", 100000, inventory_add_item },
+        { "inventory_parser_ids", 10000, inventory_parser_ids },
+        { "inventory_sort", 1000, inventory_sort },
+        { "world_get_item", 100000, world_get_item },
+        { "world_get_mob", 10000, world_get_mob },
+        { "mobile_gear_stats", 1000000, mobile_gear_stats },
+        { "list_rnd", 100000, list_rnd },
+        { "parser_parse", 10000, parser_parse },
+        { "ai_tick_mobs", 1000, ai_tick_mobs },
+        { "world_tick_buffs", 50000, world_tick_buffs },
+        { "world_save", 100, world_save },
+        { "world_save_gather", 100, world_save_gather } };
+
+    // Results are printed as tab-separated values, so they can be easily compared between releases.
+    std::cout << std::fixed << std::setprecision(3) << "benchmark\titerations\ttotal_ms\tns_per_op" << std::endl;
+    for (auto bench : benches)
+    {
+        if (filter.size() && bench.name.find(filter) == std::string::npos) continue;
+        bench.func(std::max<size_t>(1, static_cast<size_t>(bench.iterations * scale)));
+    }
+}
+
+// StrX::string_explode_colour(), on a long line with plenty of colour tags.
+void Bench::strx_string_explode_colour(size_t iterations)
+{
+    const std::string line = "{G}You are standing in the {Y}Brass Dirk{G}, a {g}dimly-lit tavern {G}with {c}sawdust on the floor {G}and the smell of {y}stale ale {G}hanging in the air. "
+        "{U}A grizzled barkeep {G}polishes a {w}tankard {G}behind the counter, while {M}a bard {G}tunes a {y}battered lute {G}in the corner.";
+    time("strx_string_explode_colour", iterations, [&line] { StrX::string_explode_colour(line, 80); });
+}
+
+// Runs a function a number of times, and prints how long it took.
+void Bench::time(const std::string &name, size_t iterations, std::function<void()> func)
+{
+    const auto clock_before = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+        func();
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - clock_before).count();
+    std::cout << name << "\t" << iterations << "\t" << ms << "\t" << ms * 1000000 / iterations << std::endl;
+}
+
+// World::get_item(), copying an Item from the item pool.
+void Bench::world_get_item(size_t iterations)
+{
+    const auto world = core()->world();
+    time("world_get_item", iterations, [&world] { world->get_item("KNIGHTLY_SWORD"); });
+}
+
+// World::get_mob(), copying a Mobile from the mobile pool, including its gear.
+void Bench::world_get_mob(size_t iterations)
+{
+    const auto world = core()->world();
+    time("world_get_mob", iterations, [&world] { world->get_mob("GOBLIN_SCOUT"); });
+}
+
+// World::save(), into an in-memory database, once the other benchmarks have filled the World with Mobiles.
+void Bench::world_save(size_t iterations)
+{
+    const auto world = core()->world();
+    time("world_save", iterations, [&world] {
+        const auto save_db = std::make_shared<SQLite::Database>(":memory:", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        SQLite::Transaction transaction(*save_db);
+        const auto writer = std::make_shared<SaveWriter>(save_db);
+        world->save(writer);
+        writer->flush();
+        transaction.commit();
+    });
+}
+
+// World::save(), gathering the rows for a whole new save file without writing them, which is as long as the game pauses when saving in the background.
+void Bench::world_save_gather(size_t iterations)
+{
+    const auto world = core()->world();
+    const auto save_db = std::make_shared<SQLite::Database>(":memory:", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+    time("world_save_gather", iterations, [&world, &save_db] { world->save(std::make_shared<SaveWriter>(save_db)); });
+}
+
+// World::tick_buffs(), with plenty of Mobiles carrying long-lasting buffs and a few with damage-over-time debuffs.
+void Bench::world_tick_buffs(size_t iterations)
+{
+    const auto world = core()->world();
+    const auto &active_rooms = world->active_rooms();
+    for (int i = 0; i < BENCH_ACTIVE_MOBS; i++)
+    {
+        auto mob = world->get_mob("FALLOW_DEER");
+        mob->set_location(active_rooms.at(active_rooms.size() > 1 ? 1 + i % (active_rooms.size() - 1) : 0));
+        world->add_mobile(mob);
+        mob->set_buff(Buff::Type::RECENTLY_FLED, UINT16_MAX - 1);
+        if (i % BENCH_DOT_MOBS == 0) mob->set_buff(Buff::Type::POISON, UINT16_MAX - 1);     // Zero-power poison still ticks, but does no harm.
+    }
+    time("world_tick_buffs", iterations, [&world] { world->tick_buffs(); });
+}
@@ -0,0 +1,42 @@
+// core/bench.h -- Microbenchmarks for the game's hot paths, built as the separate greave_bench binary.
+// Copyright (c) 2021 Raine "Gravecat" Simmons. Licensed under the GNU Affero General Public License v3 or any later version.
+
+#ifndef GREAVE_CORE_BENCH_H_
+#define GREAVE_CORE_BENCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+
+class Bench
+{
+public:
+    static void run_all(const std::string &filter, double scale);   // Runs every benchmark whose name contains the filter string, printing the results.
+
+private:
+    static constexpr int    BENCH_ACTIVE_MOBS =     256;    // How many extra Mobiles to spawn into the active rooms before benchmarking the AI or buff ticks.
+    static constexpr int    BENCH_DOT_MOBS =        8;      // When benchmarking buff ticks, one in this many of the spawned Mobiles has a damage-over-time debuff.
+    static constexpr int    BENCH_CROWDED_SIZE =    900;    // How many Items to fill an Inventory with before benchmarking parser ID allocation.
+    static constexpr int    BENCH_INVENTORY_SIZE =  50;     // How many different Items to fill an Inventory with before benchmarking add_item() or sort().
+
+    static void ai_tick_mobs(size_t iterations);                    // AI::tick_mobs(), with extra Mobiles spawned into the active rooms.
+    static void inventory_add_item(size_t iterations);              // Inventory::add_item(), stacking onto an already well-stocked Inventory.
+    static void inventory_parser_ids(size_t iterations);            // Inventory::add_item() and erase(), on an Inventory that's running short of free parser IDs.
+    static void inventory_sort(size_t iterations);                  // Inventory::sort(), on a well-stocked Inventory.
+    static void item_is_identical(size_t iterations);               // Item::is_identical(), comparing two Items that are identical.
+    static void list_rnd(size_t iterations);                        // List::rnd(), on a List which links to a sub-list.
+    static void message_log_reprocess_output(size_t iterations);    // MessageLog::reprocess_output(), on a full message log.
+    static void mobile_gear_stats(size_t iterations);               // The attack speed and defensive modifiers a Mobile gets from its gear, as checked on every attack.
+    static void parser_parse(size_t iterations);                    // Parser::parse(), with a command that doesn't pass any time.
+    static void strx_string_explode_colour(size_t iterations);      // StrX::string_explode_colour(), on a long line with plenty of colour tags.
+    static void time(const std::string &name, size_t iterations, std::function<void()> func);   // Runs a function a number of times, and prints how long it took.
+    static void world_get_item(size_t iterations);                  // World::get_item(), copying an Item from the item pool.
+    static void world_get_mob(size_t iterations);                   // World::get_mob(), copying a Mobile from the mobile pool, including its gear.
+    static void world_save(size_t iterations);                      // World::save(), into an in-memory database, once the other benchmarks have filled the World with Mobiles.
+    static void world_save_gather(size_t iterations);               // World::save(), gathering the rows for a whole new save file without writing them, which is as long as the game pauses when saving in the background.
+    static void world_tick_buffs(size_t iterations);                // World::tick_buffs(), with plenty of Mobiles carrying long-lasting buffs and a few with damage-over-time debuffs.
+};
+
+#endif  // GREAVE_CORE_BENCH_H_
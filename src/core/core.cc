@@ -10,6 +10,7 @@
 #include "core/core-constants.h"
 #include "core/bones.h"
 #include "core/filex.h"
+#include "core/save-writer.h"
 #include "core/strx.h"
 #include "core/terminal-curses.h"
 #include "core/terminal-sdl2.h"
@@ -17,6 +18,11 @@
 #ifdef GREAVE_TOLK
 #include <regex>
 #endif
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
 #include <thread>
 #ifdef GREAVE_TARGET_WINDOWS
 #include <windows.h>
@@ -26,21 +32,30 @@
 std::shared_ptr<Core> greave = nullptr;   // The main Core object.
 
 
+#ifndef GREAVE_BENCH
 // Main program entry point.
 int main(int argc, char* argv[])
 {
     // Check command-line parameters.
     std::vector<std::string> parameters(argv, argv + argc);
-    bool dry_run = false;
-    if (parameters.size() >= 2)
-        for (auto param : parameters)
-            if (!param.compare("-dry-run")) dry_run = true;
+    bool dry_run = false, verbose = false;
+    std::string replay_script;
+    uint32_t seed = 0;
+    for (size_t i = 1; i < parameters.size(); i++)
+    {
+        const std::string &param = parameters.at(i);
+        if (!param.compare("-dry-run")) dry_run = true;
+        else if (!param.compare("-verbose")) verbose = true;
+        else if (!param.compare("-replay") && i + 1 < parameters.size()) replay_script = parameters.at(++i);
+        else if (!param.compare("-seed") && i + 1 < parameters.size()) seed = std::strtoul(parameters.at(++i).c_str(), nullptr, 10);
+    }
 
     greave = std::make_shared<Core>();
     try
     {
-        greave->init(dry_run);
-        if (dry_run)
+        greave->init(dry_run || replay_script.size());
+        if (replay_script.size()) greave->replay(replay_script, seed, verbose);
+        else if (dry_run)
         {
             auto new_world =std::make_shared<World>();
         }
@@ -58,13 +73,24 @@ int main(int argc, char* argv[])
     }
     return EXIT_SUCCESS;
 }
+#endif
 
 // Constructor, doesn't do too much aside from setting default values for member variables. Use init() to set things up.
-Core::Core() : message_log_(nullptr), parser_(nullptr), rng_(nullptr), save_slot_(0), sql_unique_id_(0), terminal_(nullptr), prefs_(nullptr), world_(nullptr) { }
+Core::Core() : echo_messages_(false), message_log_(nullptr), parser_(nullptr), rng_(nullptr), save_new_file_(false), save_slot_(0), save_thread_done_(false), save_writer_(nullptr), sql_unique_id_(0), terminal_(nullptr), thread_pool_(nullptr), prefs_(nullptr), world_(nullptr) { }
+
+// Destructor, waits for any save still being written in the background.
+Core::~Core()
+{
+    // This only matters if the program exits without calling cleanup(); a thread that's still joinable when it's destroyed would bring the whole program down.
+    if (save_thread_.joinable()) save_thread_.join();
+}
 
 // Cleans up after we're d one.
 void Core::cleanup()
 {
+    // Don't quit while a save is still being written.
+    save_check(true);
+
     // Tell Guru to revert to exit() if an error happens at this point.
     guru()->console_ready(false);
 
@@ -83,6 +109,19 @@ const std::shared_ptr<Guru> Core::guru() const
     return guru_meditation_;
 }
 
+// Starts a new game with no terminal attached, using the specified RNG seed (or a random seed, if 0). Returns the seed used.
+uint32_t Core::headless_game(uint32_t seed)
+{
+    if (!seed) seed = rng_->rnd(1, UINT32_MAX);
+    rng_->set_prand_seed(seed);
+    save_check(true);
+    save_writer_ = nullptr;
+    sql_unique_id_ = 0;
+    world_ = std::make_shared<World>();
+    world_->new_game();
+    return seed;
+}
+
 // Sets up the core game classes and data.
 void Core::init(bool dry_run)
 {
@@ -95,6 +134,9 @@ void Core::init(bool dry_run)
     // Sets up the random number generator.
     rng_ = std::make_shared<Random>();
 
+    // Starts up the worker threads. They sleep until there's something for them to do.
+    thread_pool_ = std::make_shared<ThreadPool>();
+
     // Set up the user preferences.
     prefs_ = std::make_shared<Prefs>();
 
@@ -174,9 +216,16 @@ void Core::init(bool dry_run)
 // Loads a specified slot's saved game.
 void Core::load(int save_slot)
 {
+    save_check(true);
     save_slot_ = save_slot;
+    save_writer_ = nullptr;
     std::shared_ptr<SQLite::Database> save_db = std::make_shared<SQLite::Database>(save_filename(save_slot), SQLite::OPEN_READONLY);
     world_->load(save_db);
+
+    // Inventories and Mobiles keep their SQL IDs from one save to the next, so any new ones have to carry on from the highest ID already in use. Empty Inventories aren't saved, so every
+    // Inventory in the save file is the owner of at least one Item.
+    SQLite::Statement id_query(*save_db, "SELECT MAX(id) FROM ( SELECT MAX(owner_id) AS id FROM items UNION ALL SELECT MAX(sql_id) FROM mobiles )");
+    sql_unique_id_ = (id_query.executeStep() && !id_query.isColumnNull(0) ? id_query.getColumn(0).getUInt() : 0);
 }
 
 // The main game loop.
@@ -186,6 +235,7 @@ void Core::main_loop()
     // bröther may I have some lööps
     do
     {
+        save_check(false);
         world_->main_loop_events_pre_input();
         const std::string input = message_log_->render_message_log();
         parser_->parse(input);
@@ -204,6 +254,12 @@ void Core::main_loop()
 // Prints a message in the message log.
 void Core::message(std::string msg, bool interrupt)
 {
+    if (!message_log_)
+    {
+        // There's no message log in headless mode, so messages are either printed raw or discarded.
+        if (echo_messages_) std::cout << msg << std::endl;
+        return;
+    }
     message_log_->msg(msg);
     screen_read(msg, interrupt);
 }
@@ -241,12 +297,80 @@ const std::shared_ptr<Parser> Core::parser() const { return parser_; }
 // Returns a pointer to the Prefs object.
 const std::shared_ptr<Prefs> Core::prefs() const { return prefs_; }
 
+// Runs a script of commands through the parser with no terminal, reporting timings and a final world-state hash.
+void Core::replay(const std::string &script_file, uint32_t seed, bool echo_messages)
+{
+    std::ifstream script(script_file);
+    if (!script.good()) throw std::runtime_error("Could not open replay script: " + script_file);
+    echo_messages_ = echo_messages;
+
+    // The seed is always reported, so that a run without a fixed seed can still be reproduced later.
+    seed = headless_game(seed);
+    std::cout << "# replay\t" << script_file << "\tseed\t" << seed << std::endl;
+
+    const auto player = world_->player();
+    const auto time_weather = world_->time_weather();
+    const uint32_t start_time = time_weather->time_passed();
+
+    // Results are printed as tab-separated values: per-command timings first, then per-hour timings as each in-game hour passes, then the totals.
+    std::cout << std::fixed << std::setprecision(3) << "command\twall_ms\tgame_seconds\tinput" << std::endl;
+    std::string line;
+    int command_count = 0;
+    uint32_t next_hour = 1;
+    double total_ms = 0, hour_ms = 0;
+    while (std::getline(script, line) && !player->is_dead())
+    {
+        if (line.size() && line.back() == '\r') line.pop_back();
+        if (!line.size() || line[0] == '#') continue;
+
+        const uint32_t time_before = time_weather->time_passed();
+        save_check(false);
+        const auto clock_before = std::chrono::steady_clock::now();
+        world_->main_loop_events_pre_input();
+        parser_->parse(line);
+        world_->main_loop_events_post_input();
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - clock_before).count();
+        total_ms += ms;
+        hour_ms += ms;
+        std::cout << ++command_count << "\t" << ms << "\t" << time_weather->time_passed_since(time_before) << "\t" << line << std::endl;
+
+        while (time_weather->time_passed_since(start_time) >= next_hour * TimeWeather::Time::HOUR)
+        {
+            std::cout << "hour\t" << next_hour++ << "\t" << hour_ms << std::endl;
+            hour_ms = 0;
+        }
+    }
+
+    const uint32_t game_seconds = time_weather->time_passed_since(start_time);
+    if (player->is_dead()) std::cout << "# player died" << std::endl;
+    std::cout << "total_commands\t" << command_count << std::endl;
+    std::cout << "total_wall_ms\t" << total_ms << std::endl;
+    std::cout << "total_game_seconds\t" << game_seconds << std::endl;
+    if (game_seconds) std::cout << "wall_ms_per_game_hour\t" << total_ms * TimeWeather::Time::HOUR / game_seconds << std::endl;
+    std::cout << "world_hash\t" << StrX::itoh(world_->state_hash(), 8) << std::endl;
+}
+
+// Puts the backup saved game file back in place, after a failed save.
+void Core::restore_backup()
+{
+    const std::string save_fn = save_filename(save_slot_);
+    const std::string save_fn_old = save_filename(save_slot_, true);
+    if (!FileX::file_exists(save_fn_old)) return;
+    guru_meditation_->nonfatal("Attempting to restore backup saved game file.", Guru::GURU_WARN);
+    FileX::delete_file(save_fn);
+    if (FileX::file_exists(save_fn)) guru_meditation_->nonfatal("Could not delete current saved game file! Is it read-only?", Guru::GURU_ERROR);
+    else FileX::rename_file(save_fn_old, save_fn);
+}
+
 // Returns a pointer to the Random object.
 const std::shared_ptr<Random> Core::rng() const { return rng_; }
 
 // Saves the game to disk.
 void Core::save()
 {
+    // Only one save can be written at a time.
+    save_check(true);
+
     const std::string save_fn = save_filename(save_slot_);
     const std::string save_fn_old = save_filename(save_slot_, true);
     if (FileX::is_read_only(save_fn) || (FileX::file_exists(save_fn_old) && FileX::is_read_only(save_fn_old)))
@@ -254,6 +378,24 @@ void Core::save()
         core()->guru()->nonfatal("Saved game file is read-only!", Guru::GURU_ERROR);
         return;
     }
+
+    // If this game has been saved before, the save file is updated in place, writing only what's changed since the last save. The rows to write are gathered here, on the main thread, as
+    // nothing else can safely look at the World; actually writing them to disk is left to save_write().
+    if (save_writer_ && FileX::file_exists(save_fn))
+    {
+        try
+        {
+            world_->save(save_writer_);
+            save_writer_->finish();
+            save_write(false);
+            return;
+        } catch (std::exception &e)
+        {
+            guru_meditation_->nonfatal("Error while attempting to update the saved game, writing a new save file instead: " + std::string(e.what()), Guru::GURU_WARN);
+        }
+    }
+    save_writer_ = nullptr; // This closes the save file, so it can be renamed.
+
     if (FileX::file_exists(save_fn_old)) FileX::delete_file(save_fn_old);
     if (FileX::file_exists(save_fn))
     {
@@ -269,28 +411,48 @@ void Core::save()
     {
         std::shared_ptr<SQLite::Database> save_db = std::make_shared<SQLite::Database>(save_fn, SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
         save_db->exec("PRAGMA user_version = " + std::to_string(CoreConstants::SAVE_VERSION));
-        sql_unique_id_ = 0; // We're making a new save file each time, so we can reset the unique ID counter.
+        save_writer_ = std::make_shared<SaveWriter>(save_db);
+        world_->save(save_writer_);
+        save_writer_->finish();
+        save_write(true);
+    } catch (std::exception &e)
+    {
+        save_writer_ = nullptr;
+        guru_meditation_->nonfatal("SQL error while attempting to save the game: " + std::string(e.what()), Guru::GURU_CRITICAL);
+        restore_backup();
+    }
+}
 
-        SQLite::Transaction transaction(*save_db);
-        world_->save(save_db);
-        transaction.commit();
+// Checks on the save being written in the background, if any, and reports how it went once it's done. If wait is true, waits for it to finish.
+void Core::save_check(bool wait)
+{
+    if (!save_thread_.joinable() || (!wait && !save_thread_done_)) return;
+    save_thread_.join();
 
+    if (!save_error_.size())
+    {
         message("{M}Game saved in slot {Y}" + std::to_string(save_slot_) + "{M}.");
-    } catch (std::exception &e)
+        return;
+    }
+
+    // Either way, the SaveWriter no longer knows what's actually in the save file, so the next save has to start again from scratch.
+    save_writer_ = nullptr;
+    if (save_new_file_)
     {
-        guru_meditation_->nonfatal("SQL error while attempting to save the game: " + std::string(e.what()), Guru::GURU_CRITICAL);
-        if (FileX::file_exists(save_fn_old))
-        {
-            guru_meditation_->nonfatal("Attempting to restore backup saved game file.", Guru::GURU_WARN);
-            FileX::delete_file(save_fn);
-            if (FileX::file_exists(save_fn)) guru_meditation_->nonfatal("Could not delete current saved game file! Is it read-only?", Guru::GURU_ERROR);
-            else FileX::rename_file(save_fn_old, save_fn);
-        }
+        guru_meditation_->nonfatal("SQL error while attempting to save the game: " + save_error_, Guru::GURU_CRITICAL);
+        restore_backup();
     }
+    else guru_meditation_->nonfatal("SQL error while attempting to update the saved game, the last save has been kept: " + save_error_, Guru::GURU_ERROR);
+    save_error_.clear();
 }
 
 // Returns a filename for a saved game file.
-const std::string Core::save_filename(int slot, bool old_save) const { return "userdata/save/save-" + std::to_string(slot) + (old_save ? ".old" : ".sqlite"); }
+const std::string Core::save_filename(int slot, bool old_save) const
+{
+    // Headless games (replays and benchmarks) have no message log, and get their own saved game files, so a scripted save can never overwrite the player's real saved games.
+    const std::string prefix = (message_log_ ? "userdata/save/save-" : "userdata/save/replay-");
+    return prefix + std::to_string(slot) + (old_save ? ".old" : ".sqlite");
+}
 
 // Checks the saved game version of a save file.
 uint32_t Core::save_version(int slot)
@@ -302,12 +464,38 @@ uint32_t Core::save_version(int slot)
     return version;
 }
 
+// Writes the save data gathered by save_writer_ to disk, on a background thread if that's enabled in the prefs.
+void Core::save_write(bool new_file)
+{
+    // The SaveWriter already has everything it needs, so the thread never touches the World. Everything is written in a single transaction, so a save that fails or is interrupted never
+    // leaves a half-written file behind.
+    const std::shared_ptr<SaveWriter> writer = save_writer_;
+    save_new_file_ = new_file;
+    save_thread_done_ = false;
+    save_thread_ = std::thread([this, writer] {
+        try
+        {
+            SQLite::Transaction transaction(*writer->db());
+            writer->flush();
+            transaction.commit();
+        } catch (std::exception &e)
+        {
+            save_error_ = e.what();
+        }
+        save_thread_done_ = true;
+    });
+    if (!prefs_->save_in_background) save_check(true);
+}
+
 // Retrieves a new unique SQL ID.
 uint32_t Core::sql_unique_id() { return ++sql_unique_id_; }
 
 // Returns a pointer  to the terminal emulator object.
 const std::shared_ptr<Terminal> Core::terminal() const { return terminal_; }
 
+// Returns a pointer to the ThreadPool object.
+const std::shared_ptr<ThreadPool> Core::thread_pool() const { return thread_pool_; }
+
 // The 'title screen' and saved game selection.
 void Core::title()
 {
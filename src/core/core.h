@@ -10,19 +10,24 @@
 #include "core/prefs.h"
 #include "core/random.h"
 #include "core/terminal.h"
+#include "core/thread-pool.h"
 #include "world/world.h"
 
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <thread>
 
 
 class Core
 {
 public:
                                         Core();                 // Constructor, doesn't do too much aside from setting default values for member variables. Use init() to set things up.
+                                        ~Core();                // Destructor, waits for any save still being written in the background.
     void                                cleanup();              // Cleans up after we're done.
     const std::shared_ptr<Guru>         guru() const;           // Returns a pointer to the Guru Meditation object.
+    uint32_t                            headless_game(uint32_t seed);   // Starts a new game with no terminal attached, using the specified RNG seed (or a random seed, if 0). Returns the seed used.
     void                                init(bool dry_run);     // Sets up the core game classes and data.
     void                                load(int save_slot);    // Loads a specified slot's saved game.
     void                                main_loop();            // The main game loop.
@@ -34,21 +39,33 @@ public:
     void                                screen_read(std::string msg, bool interrupt);   // Reads a string in a screen reader, if any are active.
     uint32_t                            sql_unique_id();        // Retrieves a new unique SQL ID.
     const std::shared_ptr<Terminal>     terminal() const;       // Returns a pointer  to the terminal emulator object.
+    const std::shared_ptr<ThreadPool>   thread_pool() const;    // Returns a pointer to the ThreadPool object.
     void                                title();                // The 'title screen' and saved game selection.
     const std::shared_ptr<Prefs>        prefs() const;          // Returns a pointer to the Prefs object.
+    void                                replay(const std::string &script_file, uint32_t seed, bool echo_messages);  // Runs a script of commands through the parser with no terminal, reporting timings and a final world-state hash.
     const std::shared_ptr<World>        world() const;          // Returns a pointer to the World object.
 
 private:
-    const std::string           save_filename(int slot, bool old_save = false) const;   // Returns a filename for a saved game file.
+    void                        restore_backup();   // Puts the backup saved game file back in place, after a failed save.
+    void                        save_check(bool wait);  // Checks on the save being written in the background, if any, and reports how it went once it's done. If wait is true, waits for it to finish.
+    const std::string           save_filename(int slot, bool old_save = false) const;   // Returns a filename for a saved game file. Headless games use separate files from the player's own saved games.
     uint32_t                    save_version(int slot); // Checks the saved game version of a save file.
+    void                        save_write(bool new_file);  // Writes the save data gathered by save_writer_ to disk, on a background thread if that's enabled in the prefs.
 
+    bool                        echo_messages_;     // In headless replay mode, should messages be printed to standard output?
     std::shared_ptr<Guru>       guru_meditation_;   // The Guru Meditation error-handling system.
     std::shared_ptr<MessageLog> message_log_;       // The MessageLog object, which handles the scrolling message-log input/output window.
     std::shared_ptr<Parser>     parser_;            // The Parser object, which processes the player's input.
     std::shared_ptr<Random>     rng_;               // The random number generator.
+    std::string                 save_error_;        // The error message, if the last save written in the background failed. Only the save thread touches this until it has been joined.
+    bool                        save_new_file_;     // Is the save being written in the background a whole new file, rather than an update to the existing one?
     int                         save_slot_;         // The currently-active saved game slot, or 0 if no game is in progress.
+    std::thread                 save_thread_;       // The thread writing a save to disk in the background, if any.
+    std::atomic<bool>           save_thread_done_;  // Set by the save thread when it has finished, so the main thread can check on it without waiting.
+    std::shared_ptr<SaveWriter> save_writer_;       // Keeps the save file open after the first save, so later saves only have to write what's changed since. nullptr if the next save has to write a new file.
     uint32_t                    sql_unique_id_;     // The last unique SQL ID to have been used.
     std::shared_ptr<Terminal>   terminal_;          // The Terminal class, which handles low-level interaction with terminal emulation libraries.
+    std::shared_ptr<ThreadPool> thread_pool_;       // The worker threads which the AI's decisions can be split across.
     std::shared_ptr<Prefs>      prefs_;             // The Prefs object, containing various user settings in prefs.yml
     std::shared_ptr<World>      world_;             // The World object, which manages the current overall state of the game.
 };
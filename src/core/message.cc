@@ -14,7 +14,13 @@
 
 
 // SQL string to construct database table.
-constexpr char MessageLog::SQL_MSGLOG[] = "CREATE TABLE 'msglog' ( line INTEGER PRIMARY KEY, text TEXT NOT NULL )";
+constexpr char MessageLog::SQL_MSGLOG[] = "CREATE TABLE IF NOT EXISTS 'msglog' ( line INTEGER PRIMARY KEY, text TEXT NOT NULL )";
+
+// SQL statement for deleting a line of the message log.
+constexpr char MessageLog::SQL_MSGLOG_DELETE[] = "DELETE FROM msglog WHERE line = ?";
+
+// SQL statement for saving a line of the message log.
+constexpr char MessageLog::SQL_MSGLOG_INSERT[] = "INSERT OR REPLACE INTO msglog ( line, text ) VALUES ( :line, :text )";
 
 
 // Constructor, sets some default values.
@@ -68,8 +74,8 @@ void MessageLog::recalc_window_sizes()
 {
     const std::shared_ptr<Prefs> prefs = core()->prefs();
     const int padding_top = prefs->log_padding_top, padding_bottom = prefs->log_padding_bottom, padding_left = prefs->log_padding_left, padding_right = prefs->log_padding_right;
-    int screen_width, screen_height;
-    core()->terminal()->get_size(&screen_width, &screen_height);
+    int screen_width = HEADLESS_WIDTH, screen_height = HEADLESS_HEIGHT;
+    if (core()->terminal()) core()->terminal()->get_size(&screen_width, &screen_height);
     output_window_width_ = screen_width - padding_left - padding_right;
     output_window_height_ = screen_height - padding_top - padding_bottom;
     input_window_width_ = screen_width - padding_left - padding_right;
@@ -264,14 +270,14 @@ void MessageLog::reprocess_output()
 }
 
 // Saves the message log to disk.
-void MessageLog::save(std::shared_ptr<SQLite::Database> save_db)
+void MessageLog::save(std::shared_ptr<SaveWriter> writer)
 {
     for (unsigned int i = 0; i < output_raw_.size(); i++)
     {
-        SQLite::Statement query(*save_db, "INSERT INTO msglog ( line, text ) VALUES ( :line, :text )");
-        query.bind(":line", i);
-        query.bind(":text", output_raw_.at(i));
-        query.exec();
+        writer->upsert(SQL_MSGLOG_INSERT, SQL_MSGLOG_DELETE, i);
+        writer->bind(":line", i);
+        writer->bind(":text", output_raw_.at(i));
+        writer->write();
     }
 }
 
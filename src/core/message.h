@@ -6,6 +6,7 @@
 #define GREAVE_CORE_MESSAGE_H_
 
 #include "3rdparty/SQLiteCpp/Database.h"
+#include "core/save-writer.h"
 
 #include <string>
 #include <vector>
@@ -15,6 +16,8 @@ class MessageLog
 {
 public:
     static const char   SQL_MSGLOG[];   // SQL string to construct database table.
+    static const char   SQL_MSGLOG_DELETE[];    // SQL statement for deleting a line of the message log.
+    static const char   SQL_MSGLOG_INSERT[];    // SQL statement for saving a line of the message log.
 
                     MessageLog();                                           // Constructor, sets some default values.
 #ifdef GREAVE_TOLK
@@ -24,9 +27,14 @@ public:
     void            load(std::shared_ptr<SQLite::Database> save_db);        // Loads the message log from disk.
     void            msg(std::string str);                                   // Adds a message to the log.
     std::string     render_message_log(bool accept_blank_input = false);    // Renders the message log, returns user input.
-    void            save(std::shared_ptr<SQLite::Database> save_db);        // Saves the message log to disk.
+    void            save(std::shared_ptr<SaveWriter> writer);               // Saves the message log to disk.
 
 private:
+    friend class Bench; // Allows the benchmarks to reach reprocess_output() directly.
+
+    static constexpr int    HEADLESS_HEIGHT =   25; // The screen height to wrap to when there's no terminal, such as when benchmarking.
+    static constexpr int    HEADLESS_WIDTH =    80; // The screen width to wrap to when there's no terminal.
+
     void            clear_messages();                       // Clears the message log.
     void            recalc_window_sizes();                  // Recalculates the size and coordinates of the windows.
     void            reprocess_output();                     // Reprocesses the raw output to fit into the message window.
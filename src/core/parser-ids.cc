@@ -0,0 +1,58 @@
+// core/parser-ids.cc -- Hands out the semi-unique parser IDs used to tell apart Items or Mobiles with the same name.
+// Copyright (c) 2021 Raine "Gravecat" Simmons. Licensed under the GNU Affero General Public License v3 or any later version.
+
+#include "core/core.h"
+#include "core/parser-ids.h"
+
+
+// Constructor, sets default values.
+ParserIDs::ParserIDs() : counter_(0), multiplier_(0), offset_(0) { }
+
+// Returns a parser ID for something being added to this set: its current ID with the new prefix if that's not already taken, or a new unused ID if it is.
+uint16_t ParserIDs::assign(uint16_t current_id, uint8_t prefix)
+{
+    // Keeping the same ID where possible means an Item keeps its number when it's picked up or dropped, as long as nothing else is already using it.
+    uint16_t suffix = current_id % PREFIX_RANGE;
+    if (!current_id || used_.count(suffix)) suffix = next();
+    used_[suffix]++;
+    return suffix + prefix * PREFIX_RANGE;
+}
+
+// Marks a specific parser ID as used, even if it's already taken (e.g. when loading a saved game).
+void ParserIDs::claim(uint16_t id) { used_[id % PREFIX_RANGE]++; }
+
+// Releases every parser ID in this set.
+void ParserIDs::clear() { used_.clear(); }
+
+// Checks if a parser ID is currently in use.
+bool ParserIDs::exists(uint16_t id) const { return used_.count(id % PREFIX_RANGE); }
+
+// Picks the next unused ID from the permutation, ignoring the prefix.
+uint16_t ParserIDs::next()
+{
+    // The permutation is only picked when it's first needed, so that the many Inventories which never hold anything don't use up any random numbers.
+    if (!multiplier_)
+    {
+        do { multiplier_ = core()->rng()->rnd(1, PREFIX_RANGE - 1); } while (!(multiplier_ % 2) || !(multiplier_ % 5));
+        offset_ = core()->rng()->rnd(0, PREFIX_RANGE - 1);
+    }
+
+    // Stepping through (counter * multiplier + offset) % PREFIX_RANGE visits every ID in the range once, in an order that looks random to the player. IDs which are still in use are skipped, and
+    // if every single one is in use, there's nothing for it but to hand out a duplicate.
+    uint16_t id = 0;
+    for (int i = 0; i < PREFIX_RANGE; i++)
+    {
+        id = (static_cast<uint32_t>(counter_) * multiplier_ + offset_) % PREFIX_RANGE;
+        if (++counter_ >= PREFIX_RANGE) counter_ = 0;
+        if (!used_.count(id)) break;
+    }
+    return id;
+}
+
+// Marks a parser ID as no longer in use.
+void ParserIDs::release(uint16_t id)
+{
+    const auto it = used_.find(id % PREFIX_RANGE);
+    if (it == used_.end()) return;
+    if (!--it->second) used_.erase(it);
+}
@@ -0,0 +1,32 @@
+// core/parser-ids.h -- Hands out the semi-unique parser IDs used to tell apart Items or Mobiles with the same name.
+// Copyright (c) 2021 Raine "Gravecat" Simmons. Licensed under the GNU Affero General Public License v3 or any later version.
+
+#ifndef GREAVE_CORE_PARSER_IDS_H_
+#define GREAVE_CORE_PARSER_IDS_H_
+
+#include <cstdint>
+#include <unordered_map>
+
+
+class ParserIDs
+{
+public:
+    static constexpr uint16_t   PREFIX_RANGE =  1000;   // The number of parser IDs available for each prefix (e.g. 1000 to 1999 for prefix 1).
+
+                ParserIDs();                            // Constructor, sets default values.
+    uint16_t    assign(uint16_t current_id, uint8_t prefix);    // Returns a parser ID for something being added to this set: its current ID with the new prefix if that's not already taken, or a new unused ID if it is.
+    void        claim(uint16_t id);                     // Marks a specific parser ID as used, even if it's already taken (e.g. when loading a saved game).
+    void        clear();                                // Releases every parser ID in this set.
+    bool        exists(uint16_t id) const;              // Checks if a parser ID is currently in use.
+    void        release(uint16_t id);                   // Marks a parser ID as no longer in use.
+
+private:
+    uint16_t    next();                                 // Picks the next unused ID from the permutation, ignoring the prefix.
+
+    uint16_t    counter_;       // How far through the permutation we are.
+    uint16_t    multiplier_;    // The permutation's multiplier, which is coprime with PREFIX_RANGE so that every ID in the range comes up exactly once. 0 if it hasn't been picked yet.
+    uint16_t    offset_;        // The permutation's offset.
+    std::unordered_map<uint16_t, uint16_t>  used_;  // The parser IDs in use (without their prefixes), and how many things are using each one. This only goes above 1 if the whole range is taken.
+};
+
+#endif  // GREAVE_CORE_PARSER_IDS_H_
@@ -80,6 +80,7 @@ Parser::Parser() : special_state_(SpecialState::NONE)
     add_command("#heal <mobile>", ParserCommand::HEAL_CHEAT);
     add_command("#mix <txt>", ParserCommand::MIXUP);
     add_command("#money <txt>", ParserCommand::ADD_MONEY);
+    add_command("#pools", ParserCommand::POOL_STATS);
     add_command("[#spawnitem|#si] <txt>", ParserCommand::SPAWN_ITEM);
     add_command("[#spawnmobile|#spawnmob|#sm] <txt>", ParserCommand::SPAWN_MOBILE);
     add_command("#tp <txt>", ParserCommand::TELEPORT);
@@ -263,11 +264,8 @@ Parser::ParserSearchResult Parser::parse_target(std::vector<std::string> input,
     }
 
     // Mobiles in the player's room.
-    for (size_t i = 0; i < world->mob_count(); i++)
-    {
-        const std::shared_ptr<Mobile> mob = world->mob_vec(i);
-        if (mob->location() == player_location) candidates.push_back({0, StrX::str_tolower(mob->name(Mobile::NAME_FLAG_NO_COLOUR)), "", mob->parser_id(), i, ParserTarget::TARGET_MOBILE, count});
-    }
+    for (auto mob : world->mobs_in_room(player_location))
+        candidates.push_back({0, StrX::str_tolower(mob->name(Mobile::NAME_FLAG_NO_COLOUR)), "", mob->parser_id(), world->mob_vec_pos(mob->id()), ParserTarget::TARGET_MOBILE, count});
 
     // Score each candidate.
     for (size_t i = 0; i < candidates.size(); i++)
@@ -407,16 +405,12 @@ void Parser::parse_pcd(const std::string &first_word, const std::vector<std::str
                     uint32_t target_id = player->mob_target();
                     if (!target_id) continue;
 
-                    for (size_t i = 0; i < world->mob_count(); i++)
+                    const size_t target_pos = world->mob_vec_pos(target_id);
+                    if (target_pos != World::MOB_NOT_FOUND)
                     {
-                        const auto mob = world->mob_vec(i);
-                        if (mob->id() == target_id)
-                        {
-                            parsed_target = i;
-                            parsed_target_type = ParserTarget::TARGET_MOBILE;
-                            core()->message("{0}{m}(" + mob->name(Mobile::NAME_FLAG_THE | Mobile::NAME_FLAG_NO_COLOUR) + ")");
-                            break;
-                        }
+                        parsed_target = target_pos;
+                        parsed_target_type = ParserTarget::TARGET_MOBILE;
+                        core()->message("{0}{m}(" + world->mob_vec(target_pos)->name(Mobile::NAME_FLAG_THE | Mobile::NAME_FLAG_NO_COLOUR) + ")");
                     }
                 }
                 continue;
@@ -575,6 +569,7 @@ void Parser::parse_pcd(const std::string &first_word, const std::vector<std::str
             else ActionDoors::open_or_close(player, parsed_direction, pcd.command == ParserCommand::OPEN, confirm);
             break;
         case ParserCommand::PARTICIPATE: Arena::participate(); break;
+        case ParserCommand::POOL_STATS: ActionCheat::pool_stats(); break;
         case ParserCommand::QUICK_ROLL: Abilities::quick_roll(confirm); break;
         case ParserCommand::QUIT:
             core()->message("{R}Are you sure you want to quit? {M}Your game will not be saved. {R}Type {C}yes {R}to confirm.");
@@ -0,0 +1,74 @@
+// core/pool.cc -- Size-class object pools for the game objects that are created and destroyed most often, with an allocator for using them through std::allocate_shared().
+// Copyright (c) 2021 Raine "Gravecat" Simmons. Licensed under the GNU Affero General Public License v3 or any later version.
+
+#include "core/pool.h"
+
+#include <new>
+
+
+Pool::FreeSlot* Pool::free_slots_[POOL_SIZE_MAX / POOL_SIZE_CLASS] = { };   // The linked lists of unused slots, one for each size class.
+size_t          Pool::reserved_ = 0;                                        // The total amount of memory taken from the heap.
+Pool::Stats     Pool::stats_[static_cast<int>(PoolType::_END)];             // The object counts for each type of pooled object.
+
+
+// Allocates memory for an object from the appropriate size class.
+void* Pool::allocate(size_t size, PoolType type)
+{
+    Stats &stats = stats_[static_cast<int>(type)];
+    stats.total++;
+    if (++stats.live > stats.peak) stats.peak = stats.live;
+    if (!size || size > POOL_SIZE_MAX) return ::operator new(size);
+
+    const size_t size_class = (size - 1) / POOL_SIZE_CLASS;
+    FreeSlot* slot = free_slots_[size_class];
+    if (!slot)
+    {
+        // If this size class has run out of slots, grab a new block from the heap and split it into slots. They're linked in order, so objects created together stay close together.
+        const size_t slot_size = (size_class + 1) * POOL_SIZE_CLASS;
+        const size_t slot_count = POOL_BLOCK_SIZE / slot_size;
+        char* block = static_cast<char*>(::operator new(slot_count * slot_size));
+        reserved_ += slot_count * slot_size;
+        for (size_t i = slot_count; i-- > 0; )
+        {
+            FreeSlot* new_slot = reinterpret_cast<FreeSlot*>(block + i * slot_size);
+            new_slot->next = slot;
+            slot = new_slot;
+        }
+    }
+    free_slots_[size_class] = slot->next;
+    return slot;
+}
+
+// Returns an object's memory to its size class, ready to be reused.
+void Pool::deallocate(void* ptr, size_t size, PoolType type)
+{
+    stats_[static_cast<int>(type)].live--;
+    if (!size || size > POOL_SIZE_MAX)
+    {
+        ::operator delete(ptr);
+        return;
+    }
+
+    const size_t size_class = (size - 1) / POOL_SIZE_CLASS;
+    FreeSlot* slot = static_cast<FreeSlot*>(ptr);
+    slot->next = free_slots_[size_class];
+    free_slots_[size_class] = slot;
+}
+
+// The total amount of memory, in bytes, that the pools have taken from the heap.
+size_t Pool::reserved() { return reserved_; }
+
+// Returns the live and peak object counts for a given type of object.
+const Pool::Stats& Pool::stats(PoolType type) { return stats_[static_cast<int>(type)]; }
+
+// Returns the name of a type of pooled object.
+const char* Pool::type_name(PoolType type)
+{
+    switch (type)
+    {
+        case PoolType::INVENTORY: return "Inventory";
+        case PoolType::ITEM: return "Item";
+        case PoolType::MOBILE: return "Mobile";
+        default: return "Unknown";
+    }
+}
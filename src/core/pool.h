@@ -0,0 +1,80 @@
+// core/pool.h -- Size-class object pools for the game objects that are created and destroyed most often, with an allocator for using them through std::allocate_shared().
+// Copyright (c) 2021 Raine "Gravecat" Simmons. Licensed under the GNU Affero General Public License v3 or any later version.
+
+#ifndef GREAVE_CORE_POOL_H_
+#define GREAVE_CORE_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+
+class Inventory;    // defined in world/inventory.h
+class Item;         // defined in world/item.h
+class Mobile;       // defined in world/mobile.h
+
+enum class PoolType : uint8_t { INVENTORY, ITEM, MOBILE, _END };
+
+template<class T> struct PoolTraits { };    // Maps each pooled class to its PoolType.
+template<> struct PoolTraits<Inventory> { static constexpr PoolType type = PoolType::INVENTORY; };
+template<> struct PoolTraits<Item> { static constexpr PoolType type = PoolType::ITEM; };
+template<> struct PoolTraits<Mobile> { static constexpr PoolType type = PoolType::MOBILE; };
+
+
+class Pool
+{
+public:
+    static constexpr size_t POOL_BLOCK_SIZE =   16384;  // The size of each block of memory that gets carved up into slots for a size class.
+    static constexpr size_t POOL_SIZE_CLASS =   16;     // Allocations are rounded up to a multiple of this many bytes. This also has to be enough to align anything that goes in the pools.
+    static constexpr size_t POOL_SIZE_MAX =     1024;   // Allocations larger than this skip the pools, and go straight to the heap.
+
+    struct Stats
+    {
+        uint32_t    live = 0;   // How many objects of this type currently exist.
+        uint32_t    peak = 0;   // The most objects of this type that have existed at once.
+        uint64_t    total = 0;  // How many objects of this type have ever been allocated.
+    };
+
+    static void*        allocate(size_t size, PoolType type);               // Allocates memory for an object from the appropriate size class.
+    static void         deallocate(void* ptr, size_t size, PoolType type);  // Returns an object's memory to its size class, ready to be reused.
+    template<class T, class... Args> static std::shared_ptr<T>  make_shared(Args&&... args);    // Creates a new pooled object; use this instead of std::make_shared() for the pooled classes.
+    static size_t       reserved();                 // The total amount of memory, in bytes, that the pools have taken from the heap.
+    static const Stats& stats(PoolType type);       // Returns the live and peak object counts for a given type of object.
+    static const char*  type_name(PoolType type);   // Returns the name of a type of pooled object.
+
+private:
+    struct FreeSlot { FreeSlot* next; };    // An unused slot in a size class, which links to the next unused slot.
+
+    // Everything in here is trivially destructible on purpose: pooled objects can still be alive when the program exits, and their memory has to stay valid until they're gone. The pools' memory
+    // is never handed back to the heap, as it'll just be reused for more objects of the same size.
+    static FreeSlot*    free_slots_[POOL_SIZE_MAX / POOL_SIZE_CLASS];   // The linked lists of unused slots, one for each size class.
+    static size_t       reserved_;                                      // The total amount of memory taken from the heap.
+    static Stats        stats_[static_cast<int>(PoolType::_END)];       // The object counts for each type of pooled object.
+};
+
+
+// An allocator which gets its memory from the object pools, for use with std::allocate_shared(). It's only meant for the main thread; the pools have no locking.
+template<class T, PoolType P> class PoolAllocator
+{
+public:
+    typedef T   value_type;
+    template<class U> struct rebind { typedef PoolAllocator<U, P> other; };
+
+                                PoolAllocator() { }
+    template<class U>           PoolAllocator(const PoolAllocator<U, P>&) { }
+    T*      allocate(size_t n) { return static_cast<T*>(Pool::allocate(n * sizeof(T), P)); }
+    void    deallocate(T* ptr, size_t n) { Pool::deallocate(ptr, n * sizeof(T), P); }
+
+    static_assert(alignof(T) <= Pool::POOL_SIZE_CLASS, "Pooled objects cannot be aligned more strictly than the pool size class.");
+};
+
+template<class T, class U, PoolType P> bool operator==(const PoolAllocator<T, P>&, const PoolAllocator<U, P>&) { return true; }
+template<class T, class U, PoolType P> bool operator!=(const PoolAllocator<T, P>&, const PoolAllocator<U, P>&) { return false; }
+
+
+// Creates a new pooled object; use this instead of std::make_shared() for the pooled classes.
+template<class T, class... Args> std::shared_ptr<T> Pool::make_shared(Args&&... args)
+{ return std::allocate_shared<T>(PoolAllocator<T, PoolTraits<T>::type>(), std::forward<Args>(args)...); }
+
+#endif  // GREAVE_CORE_POOL_H_
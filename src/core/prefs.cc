@@ -71,6 +71,7 @@ Prefs::Prefs()
         log_padding_top = get_pref("log_padding_top");
         monochrome_mode = get_pref_bool("monochrome_mode");
         save_file_slots = get_pref("save_file_slots");
+        save_in_background = get_pref_bool("save_in_background");
     #ifdef GREAVE_TOLK
         screen_reader_external = get_pref_bool("screen_reader_external");
         screen_reader_process_square_brackets = get_pref_bool("screen_reader_process_square_brackets");
@@ -12,6 +12,9 @@
 // Constructor, sets up the PRNG.
 Random::Random() { set_prand_seed(); }
 
+// Constructor, sets up the PRNG with a specific seed and stream, for reproducible results.
+Random::Random(uint64_t seed, uint64_t stream) : pcg_rng_(seed, stream) { }
+
 // Returns a random number between min_float and max_float.
 float Random::frnd(float min_float, float max_float)
 {
@@ -13,6 +13,7 @@ class Random
 {
 public:
                 Random();                                   // Constructor, sets up the PRNG.
+                Random(uint64_t seed, uint64_t stream);     // Constructor, sets up the PRNG with a specific seed and stream, for reproducible results.
     float       frnd(float min_float, float max_float);     // Returns a random number between min_float and max_float.
     float       frnd(float max_float);                      // As above, but implicitly uses 1 as the minimum value.
     bool        percent_check(unsigned int percent);        // Returns true if a random number between 1 and 100 is lower than or equal to the specified value.
@@ -0,0 +1,36 @@
+// core/save-reader.cc -- Reads a saved game file, loading every saved Item in a single pass so that Inventories can claim them without querying the file again.
+// Copyright (c) 2021 Raine "Gravecat" Simmons. Licensed under the GNU Affero General Public License v3 or any later version.
+
+#include "core/save-reader.h"
+#include "world/item.h"
+
+#include <utility>
+
+
+// Creates a SaveReader for a save file that's already open, and loads every Item saved in it.
+SaveReader::SaveReader(std::shared_ptr<SQLite::Database> save_db) : save_db_(save_db)
+{
+    // Scanning in SQL ID order keeps each Inventory's Items in the same order as they were saved.
+    SQLite::Statement query(*save_db_, "SELECT * FROM items ORDER BY sql_id ASC");
+    while (query.executeStep())
+    {
+        SavedItem saved_item;
+        saved_item.item = Item::load(query);
+        saved_item.inventory_id = (query.isColumnNull("inventory") ? 0 : query.getColumn("inventory").getUInt());
+        items_[query.getColumn("owner_id").getUInt()].push_back(saved_item);
+    }
+}
+
+// The save file being read.
+std::shared_ptr<SQLite::Database> SaveReader::db() const { return save_db_; }
+
+// Takes all the Items belonging to a specified Inventory, in the order they were saved.
+std::vector<SaveReader::SavedItem> SaveReader::items(uint32_t owner_id)
+{
+    std::vector<SavedItem> result;
+    const auto it = items_.find(owner_id);
+    if (it == items_.end()) return result;
+    result = std::move(it->second);
+    items_.erase(it);
+    return result;
+}
@@ -0,0 +1,35 @@
+// core/save-reader.h -- Reads a saved game file, loading every saved Item in a single pass so that Inventories can claim them without querying the file again.
+// Copyright (c) 2021 Raine "Gravecat" Simmons. Licensed under the GNU Affero General Public License v3 or any later version.
+
+#ifndef GREAVE_CORE_SAVE_READER_H_
+#define GREAVE_CORE_SAVE_READER_H_
+
+#include "3rdparty/SQLiteCpp/Database.h"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+
+class Item; // defined in world/item.h
+
+class SaveReader
+{
+public:
+    struct SavedItem
+    {
+        std::shared_ptr<Item>   item;           // The loaded Item, without its contents.
+        uint32_t                inventory_id;   // The SQL ID of the Item's own Inventory, or 0 if it doesn't have one.
+    };
+
+                SaveReader(std::shared_ptr<SQLite::Database> save_db);  // Creates a SaveReader for a save file that's already open, and loads every Item saved in it.
+    std::shared_ptr<SQLite::Database>   db() const;                 // The save file being read.
+    std::vector<SavedItem>  items(uint32_t owner_id);               // Takes all the Items belonging to a specified Inventory, in the order they were saved.
+
+private:
+    std::shared_ptr<SQLite::Database>   save_db_;                   // The save file being read.
+    std::unordered_map<uint32_t, std::vector<SavedItem>>    items_; // Items which haven't been claimed yet, grouped by the SQL ID of the Inventory they belong to.
+};
+
+#endif  // GREAVE_CORE_SAVE_READER_H_
@@ -0,0 +1,201 @@
+// core/save-writer.cc -- Gathers the rows for a saved game file, skipping any which haven't changed since the last save, then writes them all at once, compiling each INSERT statement once and reusing it for every row.
+// Copyright (c) 2021 Raine "Gravecat" Simmons. Licensed under the GNU Affero General Public License v3 or any later version.
+
+#include "core/core.h"
+#include "core/save-writer.h"
+#include "core/strx.h"
+
+#include <stdexcept>
+
+
+// Creates a SaveWriter for a save file that's already open.
+SaveWriter::SaveWriter(std::shared_ptr<SQLite::Database> save_db) : current_(false), current_hash_(0), current_keyed_(nullptr), generation_(1), save_db_(save_db) { }
+
+// Adds a value to the current row, returning it so it can be filled in.
+SaveWriter::Value& SaveWriter::add_value(const char* param, ValueType type)
+{
+    current().value_count++;
+    values_.emplace_back();
+    Value &value = values_.back();
+    value.param = param;
+    value.type = type;
+    return value;
+}
+
+// Sets a value in the current row. Anything that isn't bound is left as NULL.
+void SaveWriter::bind(const char* param, int value)
+{
+    add_value(param, ValueType::INTEGER).integer = value;
+    hash(param, &value, sizeof(value));
+}
+
+// As above, but with an unsigned integer value.
+void SaveWriter::bind(const char* param, uint32_t value)
+{
+    add_value(param, ValueType::INTEGER).integer = value;
+    hash(param, &value, sizeof(value));
+}
+
+// As above, but with a 64-bit integer value.
+void SaveWriter::bind(const char* param, int64_t value)
+{
+    add_value(param, ValueType::INTEGER).integer = value;
+    hash(param, &value, sizeof(value));
+}
+
+// As above, but with a floating-point value.
+void SaveWriter::bind(const char* param, double value)
+{
+    add_value(param, ValueType::REAL).real = value;
+    hash(param, &value, sizeof(value));
+}
+
+// As above, but with a string value.
+void SaveWriter::bind(const char* param, const std::string &value)
+{
+    add_value(param, ValueType::TEXT).text = value;
+    hash(param, value.data(), value.size());
+}
+
+// The current row, or an exception if there isn't one.
+SaveWriter::Row& SaveWriter::current()
+{
+    if (!current_) throw std::runtime_error("Attempt to write save data without starting a row.");
+    return rows_.back();
+}
+
+// The save file being written.
+std::shared_ptr<SQLite::Database> SaveWriter::db() const { return save_db_; }
+
+// Deletes any keyed rows which weren't written again since the last call to finish(). Call this once at the end of each save.
+void SaveWriter::finish()
+{
+    if (current_) throw std::runtime_error("Attempt to finish saving with a row still unwritten.");
+    for (auto &kv : keyed_tables_)
+    {
+        KeyedTable &table = kv.second;
+        std::vector<int64_t> stale_keys;
+        for (const auto &row : table.rows)
+            if (row.second.generation != generation_) stale_keys.push_back(row.first);
+        for (auto key : stale_keys)
+        {
+            // Delete statements have the row's key as their only parameter, which is bound by position rather than by name.
+            rows_.emplace_back();
+            rows_.back().sql = table.delete_sql;
+            rows_.back().first_value = values_.size();
+            rows_.back().value_count = 1;
+            values_.emplace_back();
+            values_.back().integer = key;
+            table.rows.erase(key);
+        }
+    }
+    generation_++;
+}
+
+// Writes everything gathered since the last flush to the save file. This doesn't touch the World, so it can run on another thread, as long as nothing else uses this SaveWriter until it's done.
+void SaveWriter::flush()
+{
+    if (current_) throw std::runtime_error("Attempt to write save data with a row still unfinished.");
+    for (const auto &row : rows_)
+    {
+        if (!row.sql)
+        {
+            save_db_->exec(row.run_sql);
+            continue;
+        }
+        SQLite::Statement* row_statement = statement(row.sql);
+        for (size_t i = row.first_value; i < row.first_value + row.value_count; i++)
+        {
+            const Value &value = values_[i];
+            switch (value.type)
+            {
+                case ValueType::INTEGER:
+                    if (value.param) row_statement->bind(value.param, static_cast<long long>(value.integer));
+                    else row_statement->bind(1, static_cast<long long>(value.integer));
+                    break;
+                case ValueType::REAL: row_statement->bind(value.param, value.real); break;
+                case ValueType::TEXT: row_statement->bind(value.param, value.text); break;
+            }
+        }
+        row_statement->exec();
+    }
+    rows_.clear();
+    values_.clear();
+}
+
+// Adds a bound value to the current row's hash, if it's a keyed row.
+void SaveWriter::hash(const char* param, const void* data, size_t size)
+{
+    if (!current_keyed_) return;
+
+    // FNV-1a, over the parameter's address (rows can leave different parameters unbound), then the value itself and its size.
+    const uintptr_t param_address = reinterpret_cast<uintptr_t>(param);
+    StrX::fnv_mix(&current_hash_, &param_address, sizeof(param_address));
+    StrX::fnv_mix(&current_hash_, data, size);
+    StrX::fnv_mix(&current_hash_, &size, sizeof(size));
+}
+
+// Starts a new row, using one of the static INSERT statements (e.g. Item::SQL_ITEMS_INSERT). Statements are cached by their address, not their text.
+void SaveWriter::insert(const char* sql)
+{
+    if (current_) throw std::runtime_error("Attempt to start a new row of save data before writing the last one.");
+    rows_.emplace_back();
+    rows_.back().sql = sql;
+    rows_.back().first_value = values_.size();
+    current_ = true;
+}
+
+// Adds a one-off SQL statement, such as creating a table.
+void SaveWriter::run(const std::string &sql)
+{
+    if (current_) throw std::runtime_error("Attempt to run an SQL statement before writing the last row of save data.");
+    rows_.emplace_back();
+    rows_.back().run_sql = sql;
+}
+
+// Retrieves a cached statement, compiling it if needed. Statements are reset and cleared before they're returned.
+SQLite::Statement* SaveWriter::statement(const char* sql)
+{
+    auto &statement = statements_[sql];
+    if (!statement) statement = std::make_unique<SQLite::Statement>(*save_db_, sql);
+    else
+    {
+        // Resetting a statement doesn't clear its bindings, and anything left unbound has to be NULL, as it would be in a freshly-compiled statement.
+        statement->reset();
+        statement->clearBindings();
+    }
+    return statement.get();
+}
+
+// As insert(), but for a row with a unique key, which replaces the row written with the same key in an earlier save. If nothing in the row has changed, it isn't written at all.
+void SaveWriter::upsert(const char* sql, const char* delete_sql, int64_t key)
+{
+    insert(sql);
+    KeyedTable &table = keyed_tables_[sql];
+    table.delete_sql = delete_sql;
+    current_keyed_ = &table.rows[key];  // References to elements of an unordered_map stay valid when it rehashes.
+    current_hash_ = StrX::FNV_OFFSET_64;
+}
+
+// Finishes the current row, ready for the next flush().
+void SaveWriter::write()
+{
+    current();
+    KeyedRow* keyed = current_keyed_;
+    current_ = false;
+    current_keyed_ = nullptr;
+
+    if (keyed)
+    {
+        const bool unchanged = (keyed->generation && keyed->hash == current_hash_);
+        keyed->generation = generation_;
+        if (unchanged)
+        {
+            // Nothing has changed, so the row is dropped again, along with its values.
+            values_.resize(rows_.back().first_value);
+            rows_.pop_back();
+            return;
+        }
+        keyed->hash = current_hash_;
+    }
+}
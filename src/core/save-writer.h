@@ -0,0 +1,82 @@
+// core/save-writer.h -- Gathers the rows for a saved game file, skipping any which haven't changed since the last save, then writes them all at once, compiling each INSERT statement once and reusing it for every row.
+// Copyright (c) 2021 Raine "Gravecat" Simmons. Licensed under the GNU Affero General Public License v3 or any later version.
+
+#ifndef GREAVE_CORE_SAVE_WRITER_H_
+#define GREAVE_CORE_SAVE_WRITER_H_
+
+#include "3rdparty/SQLiteCpp/Database.h"
+#include "3rdparty/SQLiteCpp/Statement.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+class SaveWriter
+{
+public:
+                SaveWriter(std::shared_ptr<SQLite::Database> save_db);  // Creates a SaveWriter for a save file that's already open.
+    void        bind(const char* param, int value);                 // Sets a value in the current row. Anything that isn't bound is left as NULL.
+    void        bind(const char* param, uint32_t value);            // As above, but with an unsigned integer value.
+    void        bind(const char* param, int64_t value);             // As above, but with a 64-bit integer value.
+    void        bind(const char* param, double value);              // As above, but with a floating-point value.
+    void        bind(const char* param, const std::string &value);  // As above, but with a string value.
+    std::shared_ptr<SQLite::Database>   db() const;                 // The save file being written.
+    void        finish();                                           // Deletes any keyed rows which weren't written again since the last call to finish(). Call this once at the end of each save.
+    void        flush();                                            // Writes everything gathered since the last flush to the save file. This doesn't touch the World, so it can run on another thread, as long as nothing else uses this SaveWriter until it's done.
+    void        insert(const char* sql);                            // Starts a new row, using one of the static INSERT statements (e.g. Item::SQL_ITEMS_INSERT). Statements are cached by their address, not their text.
+    void        run(const std::string &sql);                        // Adds a one-off SQL statement, such as creating a table.
+    void        upsert(const char* sql, const char* delete_sql, int64_t key);   // As insert(), but for a row with a unique key, which replaces the row written with the same key in an earlier save. If nothing in the row has changed, it isn't written at all.
+    void        write();                                            // Finishes the current row, ready for the next flush().
+
+private:
+    enum class ValueType : uint8_t { INTEGER, REAL, TEXT };     // The types of value that can be bound to a row.
+
+    struct Value
+    {
+        const char* param = nullptr;                // The parameter this value is bound to, or nullptr for the first positional parameter.
+        ValueType   type = ValueType::INTEGER;      // Which of the fields below holds the value.
+        int64_t     integer = 0;                    // The value, if it's an integer.
+        double      real = 0;                       // The value, if it's a floating-point number.
+        std::string text;                           // The value, if it's a string.
+    };
+
+    struct Row
+    {
+        const char* sql = nullptr;          // The statement to run for this row, or nullptr to run run_sql instead.
+        std::string run_sql;                // A one-off SQL statement, from run().
+        size_t      first_value = 0;        // The index of this row's first value in values_.
+        size_t      value_count = 0;        // The number of values bound to this row.
+    };
+
+    struct KeyedRow
+    {
+        uint64_t    hash = 0;       // A hash of the values last written to this row.
+        uint32_t    generation = 0; // The generation_ when this row was last seen, or 0 if it hasn't been written yet.
+    };
+
+    struct KeyedTable
+    {
+        const char* delete_sql = nullptr;               // The statement for deleting a row from this table, with the row's key as its only parameter.
+        std::unordered_map<int64_t, KeyedRow>   rows;   // Every row in this table that's in the save file, indexed by key.
+    };
+
+    Value&              add_value(const char* param, ValueType type);   // Adds a value to the current row, returning it so it can be filled in.
+    Row&                current();                                  // The current row, or an exception if there isn't one.
+    void                hash(const char* param, const void* data, size_t size); // Adds a bound value to the current row's hash, if it's a keyed row.
+    SQLite::Statement*  statement(const char* sql);                 // Retrieves a cached statement, compiling it if needed. Statements are reset and cleared before they're returned.
+
+    bool                                current_;                   // Is there a row currently being gathered? It's always the last one in rows_.
+    uint64_t                            current_hash_;              // The hash of the values bound to the current keyed row so far.
+    KeyedRow*                           current_keyed_;             // The keyed row currently being written, if any.
+    uint32_t                            generation_;                // Counts calls to finish(), so rows which weren't written during the current save can be spotted.
+    std::unordered_map<const char*, KeyedTable> keyed_tables_;      // The keyed rows written so far, indexed by the address of their INSERT statement's SQL.
+    std::vector<Row>                    rows_;                      // The rows gathered since the last flush, in the order they'll be written.
+    std::shared_ptr<SQLite::Database>   save_db_;                   // The save file being written. This has to outlive the cached statements below.
+    std::unordered_map<const char*, std::unique_ptr<SQLite::Statement>> statements_;   // The statements compiled so far, indexed by the address of their SQL.
+    std::vector<Value>                  values_;                    // The values bound to the rows in rows_.
+};
+
+#endif  // GREAVE_CORE_SAVE_WRITER_H_
@@ -176,6 +176,29 @@ bool StrX::find_and_replace(std::string &input, const std::string &to_find, cons
     return found;
 }
 
+// Mixes some bytes into a 32-bit FNV-1a hash.
+void StrX::fnv_mix(uint32_t *hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++)
+        *hash = (*hash ^ bytes[i]) * FNV_PRIME_32;
+}
+
+// As above, but with an integer, mixed in lowest byte first so the hash is the same on any platform.
+void StrX::fnv_mix(uint32_t *hash, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        *hash = (*hash ^ ((value >> (i * 8)) & 0xFF)) * FNV_PRIME_32;
+}
+
+// As above, but for a 64-bit FNV-1a hash.
+void StrX::fnv_mix(uint64_t *hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++)
+        *hash = (*hash ^ bytes[i]) * FNV_PRIME_64;
+}
+
 // Converts a float or double to a string.
 std::string StrX::ftos(double num, bool force_decimal)
 {
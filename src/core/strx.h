@@ -5,11 +5,11 @@
 #define GREAVE_CORE_STRX_H_
 
 #include "core/core-constants.h"
+#include "core/tag-set.h"
 
 #include <cstddef>
 #include <cstdint>
 #include <map>
-#include <set>
 #include <string>
 #include <vector>
 
@@ -22,6 +22,12 @@ public:
     static constexpr int    CL_OR =             (1 << 1);   // Include "or" before the last entry in the list.
     static constexpr int    CL_OXFORD_COMMA =   (1 << 2);   // Insert an Oxford comma before the last entry in the list.
 
+    // Constants for the fnv_mix() functions.
+    static constexpr uint32_t   FNV_OFFSET_32 = 2166136261U;                // The 32-bit FNV-1a offset basis, which a 32-bit hash starts from.
+    static constexpr uint64_t   FNV_OFFSET_64 = 14695981039346656037ULL;    // The 64-bit FNV-1a offset basis, which a 64-bit hash starts from.
+    static constexpr uint32_t   FNV_PRIME_32 =  16777619U;                  // The 32-bit FNV-1a prime.
+    static constexpr uint64_t   FNV_PRIME_64 =  1099511628211ULL;           // The 64-bit FNV-1a prime.
+
     enum class DirNameType : uint8_t { NORMAL, TO_THE, TO_THE_ALT, FROM_THE, FROM_THE_ALT };
     enum class MGSC : uint8_t { SHORT, SHORT_ROUND, LONG, LONG_COINS }; // mgsc_string() modes.
 
@@ -35,6 +41,9 @@ public:
     static std::string  dir_to_name(Direction dir, DirNameType dnt = DirNameType::NORMAL);  // Converts a direction enum into a string.
     static std::string  dir_to_name(uint8_t dir, DirNameType dnt = DirNameType::NORMAL);    // As above, but with an integer instead of an enum.
     static bool         find_and_replace(std::string &input, const std::string &to_find, const std::string &to_replace);    // Find and replace one string with another.
+    static void         fnv_mix(uint32_t *hash, const void* data, size_t size); // Mixes some bytes into a 32-bit FNV-1a hash.
+    static void         fnv_mix(uint32_t *hash, uint32_t value);    // As above, but with an integer, mixed in lowest byte first so the hash is the same on any platform.
+    static void         fnv_mix(uint64_t *hash, const void* data, size_t size); // As above, but for a 64-bit FNV-1a hash.
     static std::string  ftos(double num, bool force_decimal = false);   // Converts a float or double to a string.
     static uint32_t     hash(const std::string &str);               // FNV string hash function.
     static uint32_t     htoi(const std::string &hex_str);           // Converts a hex string back to an integer.
@@ -60,20 +69,22 @@ public:
     static std::string  time_string_rough(float seconds);           // Returns a time string as a rough description ("a few seconds", "a moment", "a few minutes").
     static size_t       word_count(const std::string &str, const std::string &word);    // Returns a count of the amount of times a string is found in a parent string.
 
-    template<class T> static void string_to_tags(const std::string &tag_string, std::set<T> &tags)
+    template<class T, size_t N, size_t D> static void string_to_tags(const std::string &tag_string, TagSet<T, N, D> &tags)
     {
         if (!tag_string.size()) return;
         std::vector<std::string> split_tags = string_explode(tag_string, " ");
         for (auto tag : split_tags)
-            tags.insert(static_cast<T>(htoi(tag)));
+            tags.set(static_cast<T>(htoi(tag)));
     }
 
-    template<class T> static std::string tags_to_string(std::set<T> tags)
+    template<class T, size_t N, size_t D> static std::string tags_to_string(const TagSet<T, N, D> &tags)
     {
-        if (!tags.size()) return "";
+        // Permanent tags are never saved, as they come from the YAML data anyway.
+        if (!tags.count()) return "";
         std::string tags_str;
-        for (auto tag : tags)
+        tags.for_each([&tags_str](T tag) {
             if (static_cast<uint32_t>(tag) < CoreConstants::TAGS_PERMANENT) tags_str += itoh(static_cast<long long>(tag), 1) + " ";
+        });
         if (tags_str.size()) tags_str.pop_back();   // Strip off the excess space at the end.
         return tags_str;
     }
@@ -0,0 +1,86 @@
+// core/tag-set.h -- A fixed-size set of tags, stored as a bitset, for tags that are checked far more often than they change.
+// Copyright (c) 2021 Raine "Gravecat" Simmons. Licensed under the GNU Affero General Public License v3 or any later version.
+
+#ifndef GREAVE_CORE_TAG_SET_H_
+#define GREAVE_CORE_TAG_SET_H_
+
+#include "core/core-constants.h"
+
+#include <bitset>
+#include <cstddef>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+
+
+// T is the tag enum, and N is the number of tags in it (normally its _End marker). For tag enums which also have permanent tags, counting up from CoreConstants::TAGS_PERMANENT, D is
+// the number of dynamic tags below that; the permanent tags are packed into the bits straight after them, and N is the total of both.
+template<class T, size_t N, size_t D = N> class TagSet
+{
+public:
+                TagSet();                                   // Creates a new, empty TagSet.
+                TagSet(std::initializer_list<T> tags);      // Creates a TagSet with the specified tags set, for use as a mask.
+    bool        any(const TagSet &mask) const;              // Checks if any of the tags in a mask are set.
+    void        clear(T tag);                               // Clears a tag.
+    size_t      count() const;                              // The number of tags that are set.
+    template<class F> void  for_each(F func) const;         // Calls a function on every tag that is set, in ascending order.
+    bool        operator==(const TagSet &other) const;      // Checks if two TagSets have exactly the same tags set.
+    bool        operator!=(const TagSet &other) const;      // Checks if two TagSets have any different tags set.
+    void        set(T tag);                                 // Sets a tag.
+    bool        test(T tag) const;                          // Checks if a tag is set.
+
+private:
+    static size_t   pos(T tag);                             // Converts a tag into a bit position, checking that it's in range.
+
+    std::bitset<N>  bits_;  // One bit for each tag.
+};
+
+
+// Creates a new, empty TagSet.
+template<class T, size_t N, size_t D> TagSet<T, N, D>::TagSet() { }
+
+// Creates a TagSet with the specified tags set, for use as a mask.
+template<class T, size_t N, size_t D> TagSet<T, N, D>::TagSet(std::initializer_list<T> tags)
+{
+    for (auto tag : tags)
+        set(tag);
+}
+
+// Checks if any of the tags in a mask are set.
+template<class T, size_t N, size_t D> bool TagSet<T, N, D>::any(const TagSet &mask) const { return (bits_ & mask.bits_).any(); }
+
+// Clears a tag.
+template<class T, size_t N, size_t D> void TagSet<T, N, D>::clear(T tag) { bits_.reset(pos(tag)); }
+
+// The number of tags that are set.
+template<class T, size_t N, size_t D> size_t TagSet<T, N, D>::count() const { return bits_.count(); }
+
+// Calls a function on every tag that is set, in ascending order.
+template<class T, size_t N, size_t D> template<class F> void TagSet<T, N, D>::for_each(F func) const
+{
+    for (size_t i = 0; i < N; i++)
+        if (bits_[i]) func(static_cast<T>(i < D ? i : i - D + CoreConstants::TAGS_PERMANENT));
+}
+
+// Checks if two TagSets have exactly the same tags set.
+template<class T, size_t N, size_t D> bool TagSet<T, N, D>::operator==(const TagSet &other) const { return bits_ == other.bits_; }
+
+// Checks if two TagSets have any different tags set.
+template<class T, size_t N, size_t D> bool TagSet<T, N, D>::operator!=(const TagSet &other) const { return bits_ != other.bits_; }
+
+// Converts a tag into a bit position, checking that it's in range.
+template<class T, size_t N, size_t D> size_t TagSet<T, N, D>::pos(T tag)
+{
+    const size_t value = static_cast<size_t>(tag);
+    const size_t result = (value >= CoreConstants::TAGS_PERMANENT ? value - CoreConstants::TAGS_PERMANENT + D : value);
+    if ((value < CoreConstants::TAGS_PERMANENT && value >= D) || result >= N) throw std::runtime_error("Invalid tag: " + std::to_string(value));
+    return result;
+}
+
+// Sets a tag.
+template<class T, size_t N, size_t D> void TagSet<T, N, D>::set(T tag) { bits_.set(pos(tag)); }
+
+// Checks if a tag is set.
+template<class T, size_t N, size_t D> bool TagSet<T, N, D>::test(T tag) const { return bits_[pos(tag)]; }
+
+#endif  // GREAVE_CORE_TAG_SET_H_
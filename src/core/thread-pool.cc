@@ -0,0 +1,71 @@
+// core/thread-pool.cc -- A set of worker threads, started once and woken up whenever there's work to share out between them.
+// Copyright (c) 2021 Raine "Gravecat" Simmons. Licensed under the GNU Affero General Public License v3 or any later version.
+
+#include "core/thread-pool.h"
+
+#include <stdexcept>
+
+
+// Constructor, starts one worker thread for each hardware thread, other than the one it's called from.
+ThreadPool::ThreadPool() : generation_(0), job_(nullptr), jobs_(0), pending_(0), shutdown_(false)
+{
+    const size_t hardware_threads = std::thread::hardware_concurrency();
+    for (size_t i = 1; i < hardware_threads; i++)
+        threads_.push_back(std::thread(&ThreadPool::worker, this, i));
+}
+
+// Destructor, wakes up the worker threads and waits for them to finish.
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shutdown_ = true;
+    }
+    start_cv_.notify_all();
+    for (auto &thread : threads_)
+        thread.join();
+}
+
+// Runs a job once for each number from 0 to jobs-1, spread across the worker threads and the calling thread, and waits for them all to finish. The job must not throw.
+void ThreadPool::run(size_t jobs, const std::function<void(size_t)> &job)
+{
+    if (jobs > size()) throw std::runtime_error("Too many jobs for the thread pool.");
+    if (!jobs) return;
+
+    // Only the workers with a job in this batch are waited for. Any others just note the new batch when they wake up, and go back to sleep.
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &job;
+        jobs_ = jobs;
+        pending_ = jobs - 1;
+        generation_++;
+    }
+    start_cv_.notify_all();
+    job(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return !pending_; });
+    job_ = nullptr;
+}
+
+// The number of jobs that can be run at the same time, including the one on the calling thread.
+size_t ThreadPool::size() const { return threads_.size() + 1; }
+
+// The loop each worker thread runs, waiting for jobs until the pool is destroyed.
+void ThreadPool::worker(size_t index)
+{
+    uint32_t last_generation = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        start_cv_.wait(lock, [this, last_generation] { return shutdown_ || generation_ != last_generation; });
+        if (shutdown_) return;
+        last_generation = generation_;
+        if (index >= jobs_) continue;
+        const auto job = job_;
+        lock.unlock();
+        (*job)(index);
+        lock.lock();
+        if (!--pending_) done_cv_.notify_one();
+    }
+}
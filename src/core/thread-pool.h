@@ -0,0 +1,38 @@
+// core/thread-pool.h -- A set of worker threads, started once and woken up whenever there's work to share out between them.
+// Copyright (c) 2021 Raine "Gravecat" Simmons. Licensed under the GNU Affero General Public License v3 or any later version.
+
+#ifndef GREAVE_CORE_THREAD_POOL_H_
+#define GREAVE_CORE_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class ThreadPool
+{
+public:
+                ThreadPool();   // Constructor, starts one worker thread for each hardware thread, other than the one it's called from.
+                ~ThreadPool();  // Destructor, wakes up the worker threads and waits for them to finish.
+    void        run(size_t jobs, const std::function<void(size_t)> &job);  // Runs a job once for each number from 0 to jobs-1, spread across the worker threads and the calling thread, and waits for them all to finish. The job must not throw.
+    size_t      size() const;   // The number of jobs that can be run at the same time, including the one on the calling thread.
+
+private:
+    void        worker(size_t index);   // The loop each worker thread runs, waiting for jobs until the pool is destroyed.
+
+    std::condition_variable             done_cv_;       // Wakes up the calling thread when the last worker has finished its job.
+    uint32_t                            generation_;    // Goes up each time run() hands out new jobs, so the workers can tell a new batch from one they've already done.
+    const std::function<void(size_t)>*  job_;           // The job being run by run(), if any.
+    size_t                              jobs_;          // The number of jobs being run by run().
+    std::mutex                          mutex_;         // Guards everything else here, aside from threads_.
+    size_t                              pending_;       // How many workers still have to finish their job in the current batch.
+    bool                                shutdown_;      // Set when the pool is being destroyed, to tell the workers to stop.
+    std::condition_variable             start_cv_;      // Wakes up the workers when there's a new batch of jobs, or when it's time to stop.
+    std::vector<std::thread>            threads_;       // The worker threads. Worker N runs job number N; the calling thread always runs job 0 itself.
+};
+
+#endif  // GREAVE_CORE_THREAD_POOL_H_
@@ -5,54 +5,61 @@
 #include "world/inventory.h"
 
 #include <algorithm>
+#include <utility>
 
 
 // Creates a new, blank inventory.
-Inventory::Inventory(uint8_t pid_prefix) : pid_prefix_(pid_prefix) { }
+Inventory::Inventory(uint8_t pid_prefix) : container_(nullptr), pid_prefix_(pid_prefix), sql_id_(0), version_(1), weight_(0) { }
+
+// Destructor, makes sure none of the Items still think they're in here.
+Inventory::~Inventory()
+{
+    for (auto item : items_)
+        if (item->owner() == this) item->set_owner(nullptr);
+}
 
 // Adds an Item to this Inventory (this will later handle auto-stacking, etc.)
 void Inventory::add_item(std::shared_ptr<Item> item, bool force_stack)
 {
-    // Checks if there's anything else here that can be stacked.
+    version_++;
+
+    // Checks if there's anything else here that can be stacked. Only Items with the same stack hash can be identical, so there's no need to check anything else.
     if (force_stack || item->tag(ItemTag::Stackable))
     {
-        for (size_t i = 0; i < items_.size(); i++)
+        std::shared_ptr<Item> stack_item = nullptr;
+        const auto range = stack_index_.equal_range(item->stack_hash());
+        for (auto it = range.first; it != range.second; ++it)
         {
-            if (!force_stack && !items_.at(i)->tag(ItemTag::Stackable)) continue;
-            if (item->is_identical(items_.at(i)))
-            {
-                items_.at(i)->set_stack(item->stack() + items_.at(i)->stack());
+            if (!force_stack && !it->second->tag(ItemTag::Stackable)) continue;
+            if (!item->is_identical(it->second)) continue;
+            stack_item = it->second;
+            break;
+        }
 
-                // Compare appraised values, and pick the most accurate of the two.
-                const int appraised_value_a = items_.at(i)->meta_int("appraised_value");
-                const int appraised_value_b = item->meta_int("appraised_value");
-                if (appraised_value_a != appraised_value_b)
+        if (stack_item)
+        {
+            stack_item->set_stack(item->stack() + stack_item->stack());
+
+            // Compare appraised values, and pick the most accurate of the two.
+            const int appraised_value_a = stack_item->appraisal();
+            const int appraised_value_b = item->appraisal();
+            if (appraised_value_a != appraised_value_b)
+            {
+                if (!appraised_value_a) stack_item->set_appraised_value(appraised_value_b);
+                else
                 {
-                    if (!appraised_value_a) items_.at(i)->set_meta("appraised_value", appraised_value_b);
-                    else
-                    {
-                        const int diff_a = std::abs(appraised_value_a - static_cast<int>(items_.at(i)->value(true)));
-                        const int diff_b = std::abs(appraised_value_b - static_cast<int>(items_.at(i)->value(true)));
-                        if (diff_a > diff_b) items_.at(i)->set_meta("appraised_value", appraised_value_b);
-                    }
+                    const int diff_a = std::abs(appraised_value_a - static_cast<int>(stack_item->value(true)));
+                    const int diff_b = std::abs(appraised_value_b - static_cast<int>(stack_item->value(true)));
+                    if (diff_a > diff_b) stack_item->set_appraised_value(appraised_value_b);
                 }
-                return;
             }
+            return;
         }
     }
 
-    update_prefix(item);
-    items_.push_back(item);
-}
-
-// Updates the prefix of an item to match this inventory.
-void Inventory::update_prefix(std::shared_ptr<Item> item) const
-{
-    // Check the item's parser ID. If it's unset, or if another item in the inventory shares its ID, we'll need a new one. Infinite loops relying on RNG to break out are VERY BAD so let's put a threshold on this bad boy.
-    int tries = 0;
-    item->set_parser_id_prefix(pid_prefix_);
-    while (parser_id_exists(item->parser_id()) && ++tries < 10000)
-        item->new_parser_id(pid_prefix_);
+    item->set_parser_id(parser_ids_.assign(item->parser_id(), pid_prefix_));
+    push_item(item);
+    stack_index_add(items_.size() - 1);
 }
 
 // As above, but generates a new Item from a template with a specified ID.
@@ -75,7 +82,28 @@ size_t Inventory::ammo_pos(std::shared_ptr<Item> item)
 }
 
 // Erases everything from this inventory.
-void Inventory::clear() { items_.clear(); }
+void Inventory::clear()
+{
+    for (auto item : items_)
+        if (item->owner() == this) item->set_owner(nullptr);
+    items_.clear();
+    cached_.clear();
+    slots_.fill(nullptr);
+    parser_ids_.clear();
+    stack_index_.clear();
+    version_++;
+    if (weight_)
+    {
+        weight_ = 0;
+        container_update();
+    }
+}
+
+// The Item this Inventory is inside, if any.
+Item* Inventory::container() const { return container_; }
+
+// Lets the Item containing this Inventory know that its weight has changed.
+void Inventory::container_update() { if (container_ && container_->owner()) container_->owner()->item_changed(container_); }
 
 // Returns the number of Items in this Inventory.
 size_t Inventory::count() const { return items_.size(); }
@@ -84,7 +112,26 @@ size_t Inventory::count() const { return items_.size(); }
 void Inventory::erase(size_t pos)
 {
     if (pos >= items_.size()) throw std::runtime_error("Invalid inventory position requested.");
+    parser_ids_.release(items_.at(pos)->parser_id());
+    stack_index_erase(pos);
+    erase_item(pos);
+    version_++;
+}
+
+// Removes an Item from items_, along with its cached weight and equipment slot.
+void Inventory::erase_item(size_t pos)
+{
+    const auto item = items_.at(pos);
+    const CachedItem cached = cached_.at(pos);
+    if (item->owner() == this) item->set_owner(nullptr);
     items_.erase(items_.begin() + pos);
+    cached_.erase(cached_.begin() + pos);
+    if (slots_[static_cast<size_t>(cached.slot)] == item) index_slot(cached.slot);
+    if (cached.weight)
+    {
+        weight_ -= cached.weight;
+        container_update();
+    }
 }
 
 // Retrieves an Item from this Inventory.
@@ -97,48 +144,113 @@ std::shared_ptr<Item> Inventory::get(size_t pos) const
 // As above, but retrieves an item based on a given equipment slot.
 std::shared_ptr<Item> Inventory::get(EquipSlot es) const
 {
-    for (auto item : items_)
-        if (item->equip_slot() == es) return item;
-    return nullptr;
+    const size_t slot = static_cast<size_t>(es);
+    if (slot >= slots_.size()) throw std::runtime_error("Invalid equipment slot requested.");
+    return slots_[slot];
+}
+
+// Finds the first Item in this Inventory for an equipment slot, after the Items in that slot have changed.
+void Inventory::index_slot(EquipSlot es)
+{
+    auto &slot_item = slots_[static_cast<size_t>(es)];
+    slot_item = nullptr;
+    for (size_t i = 0; i < cached_.size(); i++)
+    {
+        if (cached_.at(i).slot != es) continue;
+        slot_item = items_.at(i);
+        return;
+    }
+}
+
+// Updates the cached weight, equipment slots and stack index after one of this Inventory's Items has changed. Called by the Item itself.
+void Inventory::item_changed(const Item* item)
+{
+    for (size_t i = 0; i < items_.size(); i++)
+    {
+        if (items_.at(i).get() != item) continue;
+        CachedItem &cached = cached_.at(i);
+        const EquipSlot old_slot = cached.slot;
+        cached.slot = item->equip_slot();
+        if (cached.slot != old_slot)
+        {
+            index_slot(old_slot);
+            index_slot(cached.slot);
+        }
+
+        const uint32_t new_weight = item->weight();
+        if (new_weight != cached.weight)
+        {
+            weight_ = weight_ - cached.weight + new_weight;
+            cached.weight = new_weight;
+            container_update();
+        }
+
+        // If the Item can no longer stack with the same things, it has to be filed under its new hash. Containers are taken out of the index altogether.
+        const uint32_t new_hash = item->stack_hash();
+        if (new_hash != cached.stack_hash || items_.at(i)->inv())
+        {
+            stack_index_erase(i);
+            cached.stack_hash = new_hash;
+            stack_index_add(i);
+        }
+        return;
+    }
 }
 
 // Loads an Inventory from the save file.
-void Inventory::load(std::shared_ptr<SQLite::Database> save_db, uint32_t sql_id)
+void Inventory::load(std::shared_ptr<SaveReader> reader, uint32_t sql_id)
 {
-    items_.clear();
-    SQLite::Statement query(*save_db, "SELECT sql_id FROM items WHERE owner_id = :owner_id ORDER BY sql_id ASC");
-    query.bind(":owner_id", sql_id);
-    bool loaded_items = false;
-    while (query.executeStep())
+    clear();
+    sql_id_ = sql_id;
+    const auto saved_items = reader->items(sql_id);
+    if (!saved_items.size()) throw std::runtime_error("Could not load inventory data " + std::to_string(sql_id));
+    for (auto saved_item : saved_items)
     {
-        auto new_item = Item::load(save_db, query.getColumn("sql_id").getUInt());
-        items_.push_back(new_item);
-        loaded_items = true;
+        auto new_item = saved_item.item;
+        if (saved_item.inventory_id)
+        {
+            new_item->new_inventory();
+            new_item->inv()->load(reader, saved_item.inventory_id);
+        }
+        push_item(new_item);
+        parser_ids_.claim(new_item->parser_id());
+        stack_index_add(items_.size() - 1);
     }
-    if (!loaded_items) throw std::runtime_error("Could not load inventory data " + std::to_string(sql_id));
 }
 
-// Checks if a given parser ID already exists on an Item in this Inventory.
-bool Inventory::parser_id_exists(uint16_t id) const
+// Adds an Item to the end of items_, and caches its weight, equipment slot and stack hash.
+void Inventory::push_item(std::shared_ptr<Item> item)
 {
-    for (auto item : items_)
-        if (item->parser_id() == id) return true;
-    return false;
+    const CachedItem cached = { item->equip_slot(), item->stack_hash(), item->weight() };
+    item->set_owner(this);
+    items_.push_back(item);
+    cached_.push_back(cached);
+    auto &slot_item = slots_[static_cast<size_t>(cached.slot)];
+    if (!slot_item) slot_item = item;
+    if (cached.weight)
+    {
+        weight_ += cached.weight;
+        container_update();
+    }
 }
 
 // Removes an Item from this Inventory.
 void Inventory::remove_item(size_t pos)
 {
     if (pos >= items_.size()) throw std::runtime_error("Attempt to remove item with invalid inventory position.");
-    items_.erase(items_.begin() + pos);
+    parser_ids_.release(items_.at(pos)->parser_id());
+    stack_index_erase(pos);
+    erase_item(pos);
+    version_++;
 }
 
 // As above, but with a specified equipment slot.
 void Inventory::remove_item(EquipSlot es)
 {
-    for (size_t i = 0; i < items_.size(); i++)
+    const auto item = get(es);
+    for (size_t i = 0; item && i < items_.size(); i++)
     {
-        if (items_.at(i)->equip_slot() == es)
+        if (items_.at(i) == item)
         {
             remove_item(i);
             return;
@@ -148,48 +260,85 @@ void Inventory::remove_item(EquipSlot es)
 }
 
 // Saves this Inventory, returns its SQL ID.
-uint32_t Inventory::save(std::shared_ptr<SQLite::Database> save_db)
+uint32_t Inventory::save(std::shared_ptr<SaveWriter> writer)
 {
     if (!items_.size()) return 0;
-    const uint32_t sql_id = core()->sql_unique_id();
+    if (!sql_id_) sql_id_ = core()->sql_unique_id();
     for (size_t i = 0; i < items_.size(); i++)
-        items_.at(i)->save(save_db, sql_id);
-    return sql_id;
+        items_.at(i)->save(writer, sql_id_, i);
+    return sql_id_;
 }
 
+// Sets the Item this Inventory is inside, so it can be told whenever this Inventory's weight changes.
+void Inventory::set_container(Item* item) { container_ = item; }
+
 // Sets the parser ID prefix.
 void Inventory::set_prefix(uint8_t prefix)
 {
     pid_prefix_ = prefix;
     for (auto item : items_)
-        update_prefix(item);
+        item->set_parser_id_prefix(prefix);
+}
+
+// Adds the Item at a given position to the stack index, unless it can never be stacked onto, or an identical Item is already in there.
+void Inventory::stack_index_add(size_t pos)
+{
+    // Only the first of several identical (unstackable) Items needs to be in the index, as that's the only one add_item() would stack onto. Leaving the rest out keeps the index's buckets small.
+    const auto item = items_.at(pos);
+    if (item->inv()) return;
+    const uint32_t hash = cached_.at(pos).stack_hash;
+    const auto range = stack_index_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+        if (item->is_identical(it->second)) return;
+    stack_index_.insert(std::make_pair(hash, item));
+}
+
+// Removes the Item at a given position from the stack index, before it's removed from the Inventory or filed under a new hash.
+void Inventory::stack_index_erase(size_t pos)
+{
+    // The Item is filed under the hash cached when it was added, which may not be its current hash if it's in the middle of being changed.
+    const auto item = items_.at(pos);
+    const uint32_t hash = cached_.at(pos).stack_hash;
+    const auto range = stack_index_.equal_range(hash);
+    auto it = range.first;
+    while (it != range.second && it->second != item) ++it;
+
+    // Containers, and Items with an identical copy already in the index, were never added, so there's nothing to remove.
+    if (it == range.second) return;
+    stack_index_.erase(it);
+
+    // If there's another identical Item in the Inventory, it takes this one's place in the index.
+    for (size_t i = 0; i < items_.size(); i++)
+        if (i != pos && cached_.at(i).stack_hash == hash) stack_index_add(i);
 }
 
 // Sorts the inventory into alphabetical order.
 void Inventory::sort()
 {
-    // Quick and dirty bubble sort. It does the job.
-    bool sorted = false;
-    do
+    // Each Item's name is only worked out once, rather than on every comparison. Ties are broken by the Items' current positions, so identically-named Items stay in the same order.
+    std::vector<std::pair<std::string, size_t>> sort_keys;
+    sort_keys.reserve(items_.size());
+    for (size_t i = 0; i < items_.size(); i++)
+        sort_keys.push_back(std::make_pair(items_.at(i)->name(Item::NAME_FLAG_NO_COLOUR | Item::NAME_FLAG_NO_COUNT), i));
+    std::sort(sort_keys.begin(), sort_keys.end());
+
+    std::vector<std::shared_ptr<Item>> sorted_items;
+    std::vector<CachedItem> sorted_cache;
+    sorted_items.reserve(items_.size());
+    sorted_cache.reserve(cached_.size());
+    for (const auto &key : sort_keys)
     {
-        sorted = false;
-        for (size_t i = 0; i < items_.size() - 1; i++)
-        {
-            const size_t j = i + 1;
-            if (items_.at(i)->name(Item::NAME_FLAG_NO_COLOUR | Item::NAME_FLAG_NO_COUNT) > items_.at(j)->name(Item::NAME_FLAG_NO_COLOUR | Item::NAME_FLAG_NO_COUNT))
-            {
-                std::iter_swap(items_.begin() + i, items_.begin() + j);
-                sorted = true;
-            }
-        }
-    } while (sorted);
+        sorted_items.push_back(items_.at(key.second));
+        sorted_cache.push_back(cached_.at(key.second));
+    }
+    items_.swap(sorted_items);
+    cached_.swap(sorted_cache);
+    for (size_t i = 0; i < slots_.size(); i++)
+        index_slot(static_cast<EquipSlot>(i));
 }
 
+// A counter which changes whenever Items are added to or removed from this Inventory, so anything derived from its contents can tell when it's out of date.
+uint32_t Inventory::version() const { return version_; }
+
 // Returns the weight of all items in this inventory.
-uint32_t Inventory::weight() const
-{
-    uint32_t total_weight = 0;
-    for (auto item : items_)
-        total_weight += item->weight();
-    return total_weight;
-}
+uint32_t Inventory::weight() const { return weight_; }
@@ -5,12 +5,15 @@
 #define GREAVE_WORLD_INVENTORY_H_
 
 #include "3rdparty/SQLiteCpp/Database.h"
+#include "core/parser-ids.h"
 #include "world/item.h"
 
+#include <array>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 
@@ -25,28 +28,52 @@ public:
     static constexpr int    PID_PREFIX_MOBILE =     9;  // All mobiles have a parser ID prefixed with 9 (e.g. 9876).
 
                 Inventory(uint8_t pid_prefix);          // Creates a new, blank inventory.
+                ~Inventory();                           // Destructor, makes sure none of the Items still think they're in here.
     void        add_item(std::shared_ptr<Item> item, bool force_stack = false); // Adds an Item to this Inventory (this will later handle auto-stacking, etc.)
     void        add_item(const std::string &id, bool force_stack = false);      // As above, but generates a new Item from a template with a specified ID.
     size_t      ammo_pos(std::shared_ptr<Item> item);   // Locates the position of an ammunition item used by the specified weapon.
     void        clear();                                // Erases everything from this inventory.
+    Item*       container() const;                      // The Item this Inventory is inside, if any.
     size_t      count() const;                          // Returns the number of Items in this Inventory.
     void        erase(size_t pos);                      // Deletes an Item from this Inventory.
     std::shared_ptr<Item> get(size_t pos) const;        // Retrieves an Item from this Inventory.
     std::shared_ptr<Item> get(EquipSlot es) const;      // As above, but retrieves an item based on a given equipment slot.
-    void        load(std::shared_ptr<SQLite::Database> save_db, uint32_t sql_id);   // Loads an Inventory from the save file.
+    void        item_changed(const Item* item);         // Updates the cached weight, equipment slots and stack index after one of this Inventory's Items has changed. Called by the Item itself.
+    void        load(std::shared_ptr<SaveReader> reader, uint32_t sql_id);  // Loads an Inventory from the save file.
     void        remove_item(size_t pos);                // Removes an Item from this Inventory.
     void        remove_item(EquipSlot es);              // As above, but with a specified equipment slot.
-    uint32_t    save(std::shared_ptr<SQLite::Database> save_db);    // Saves this Inventory, returns its SQL ID.
+    uint32_t    save(std::shared_ptr<SaveWriter> writer);    // Saves this Inventory, returns its SQL ID.
+    void        set_container(Item* item);              // Sets the Item this Inventory is inside, so it can be told whenever this Inventory's weight changes.
     void        set_prefix(uint8_t prefix);             // Sets the parser ID prefix.
     void        sort();                                 // Sorts the inventory into alphabetical order.
-    void        update_prefix(std::shared_ptr<Item> item) const;    // Updates the prefix of an item to match this inventory.
+    uint32_t    version() const;                        // A counter which changes whenever Items are added to or removed from this Inventory, so anything derived from its contents can tell when it's out of date.
     uint32_t    weight() const;                         // Returns the weight of all items in this inventory.
 
 private:
-    bool        parser_id_exists(uint16_t id) const;    // Checks if a given parser ID already exists on an Item in this Inventory.
+    struct CachedItem
+    {
+        EquipSlot   slot;       // The equipment slot the Item was in, last time it was checked.
+        uint32_t    stack_hash; // The Item's stack hash, last time it was checked. This is the hash it's filed under in stack_index_.
+        uint32_t    weight;     // The weight of the Item, last time it was checked.
+    };
 
+    void        container_update();                     // Lets the Item containing this Inventory know that its weight has changed.
+    void        erase_item(size_t pos);                 // Removes an Item from items_, along with its cached weight and equipment slot.
+    void        index_slot(EquipSlot es);               // Finds the first Item in this Inventory for an equipment slot, after the Items in that slot have changed.
+    void        push_item(std::shared_ptr<Item> item);  // Adds an Item to the end of items_, and caches its weight, equipment slot and stack hash.
+    void        stack_index_add(size_t pos);            // Adds the Item at a given position to the stack index, unless it can never be stacked onto, or an identical Item is already in there.
+    void        stack_index_erase(size_t pos);          // Removes the Item at a given position from the stack index, before it's removed from the Inventory or filed under a new hash.
+
+    std::vector<CachedItem>             cached_;        // The weight, equipment slot and stack hash of each Item in items_, in the same order.
+    Item*                               container_;     // The Item this Inventory is inside, if any. It doesn't own the Item, it's just so the Item's weight can be kept up to date.
     std::vector<std::shared_ptr<Item>>  items_;         // The Items stored in this Inventory.
+    ParserIDs                           parser_ids_;    // The parser IDs used by the Items in this Inventory.
     uint8_t                             pid_prefix_;    // The prefix for all parser ID numbers in this Inventory.
+    std::array<std::shared_ptr<Item>, static_cast<size_t>(EquipSlot::_END)>   slots_; // The first Item in this Inventory for each equipment slot, so get() doesn't have to search for them.
+    uint32_t                            sql_id_;        // This Inventory's unique ID in the save file, which stays the same from one save to the next. 0 if it hasn't been saved yet.
+    std::unordered_multimap<uint32_t, std::shared_ptr<Item>>    stack_index_;   // The Items in this Inventory which could be stacked onto, indexed by their stack hashes, so add_item() can find identical Items without checking everything.
+    uint32_t                            version_;       // Changes whenever Items are added to or removed from this Inventory. Starts at 1, so 0 can mean 'never seen'.
+    uint32_t                            weight_;        // The total weight of all the Items in this Inventory, kept up to date as they're added, removed and changed.
 };
 
 #endif  // GREAVE_WORLD_INVENTORY_H_
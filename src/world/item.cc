@@ -3,35 +3,62 @@
 
 #include "core/core.h"
 #include "core/mathx.h"
+#include "core/parser-ids.h"
+#include "core/pool.h"
 #include "core/strx.h"
 #include "world/item.h"
 
 #include <cmath>
+#include <cstring>
 
 
 // The SQL table construction string for saving items.
-constexpr char Item::SQL_ITEMS[] = "CREATE TABLE items ( description TEXT, inventory INTEGER, metadata TEXT, name TEXT NOT NULL, owner_id INTEGER NOT NULL, parser_id INTEGER NOT NULL, rare INTEGER NOT NULL, sql_id INTEGER PRIMARY KEY UNIQUE NOT NULL, stack INTEGER, subtype INTEGER, tags TEXT, type INTEGER, value INTEGER, weight INTEGER NOT NULL )";
+constexpr char Item::SQL_ITEMS[] = "CREATE TABLE IF NOT EXISTS items ( description TEXT, inventory INTEGER, metadata TEXT, name TEXT NOT NULL, owner_id INTEGER NOT NULL, parser_id INTEGER NOT NULL, rare INTEGER NOT NULL, sql_id INTEGER PRIMARY KEY UNIQUE NOT NULL, stack INTEGER, subtype INTEGER, tags TEXT, type INTEGER, value INTEGER, weight INTEGER NOT NULL )";
+
+// The SQL statement for deleting an item which is no longer in the save file.
+constexpr char Item::SQL_ITEMS_DELETE[] = "DELETE FROM items WHERE sql_id = ?";
+
+// The SQL statement for saving an item.
+constexpr char Item::SQL_ITEMS_INSERT[] = "INSERT OR REPLACE INTO items ( description, inventory, metadata, name, owner_id, parser_id, rare, sql_id, stack, subtype, tags, type, value, weight ) VALUES ( :desc, :inventory, :meta, :name, :owner_id, :parser_id, :rare, :sql_id, :stack, :subtype, :tags, :type, :value, :weight )";
+
+
+// Checks if two sets of stats are identical.
+bool ItemStats::identical(const ItemStats &other) const
+{
+    return ammo_power == other.ammo_power && bleed == other.bleed && block_mod == other.block_mod && capacity == other.capacity && crit == other.crit && damage_type == other.damage_type && dodge_mod == other.dodge_mod &&
+        parry_mod == other.parry_mod && poison == other.poison && power == other.power && speed == other.speed && warmth == other.warmth;
+}
 
 
 // Constructor, sets default values.
-Item::Item() : inventory_(nullptr), parser_id_(0), rarity_(1), stack_(1), type_(ItemType::NONE), type_sub_(ItemSub::NONE), value_(0) { }
+Item::Item() : appraised_value_(0), charge_(0), inventory_(nullptr), owner_(nullptr), parser_id_(0), slot_(EquipSlot::NONE), stack_(1), template_(std::make_shared<Template>()) { }
+
+// Copy constructor. The copy isn't in any Inventory yet, even if the original is.
+Item::Item(const Item &other) : appraised_value_(other.appraised_value_), charge_(other.charge_), inventory_(other.inventory_), liquid_(other.liquid_), owner_(nullptr), parser_id_(other.parser_id_),
+    slot_(other.slot_), stack_(other.stack_), template_(other.template_) { }
+
+// Destructor, lets this Item's own inventory know that it's gone.
+Item::~Item() { if (inventory_ && inventory_->container() == this) inventory_->set_container(nullptr); }
 
 // The damage multiplier for ammunition.
-float Item::ammo_power() const { return meta_float("ammo_power"); }
+float Item::ammo_power() const { return template_->stats.ammo_power; }
+
+// Retrieves the player's stored appraisal of this Item's value, or 0 if it hasn't been appraised yet.
+int Item::appraisal() const { return appraised_value_; }
 
 // Attempts to guess the value of an item.
 int Item::appraised_value()
 {
-    if (!value_) return 0;
-    else if (meta_int("appraised_value")) return meta_int("appraised_value");
+    if (!template_->value) return 0;
+    else if (appraised_value_) return appraised_value_;
 
-    int required_skill = (rarity_ * APPRAISAL_RARITY_MULTIPLIER) + APPRAISAL_BASE_SKILL_REQUIRED;
+    int required_skill = (template_->rarity * APPRAISAL_RARITY_MULTIPLIER) + APPRAISAL_BASE_SKILL_REQUIRED;
     if (required_skill < 0) required_skill = 0;
     const int appraisal_skill = core()->world()->player()->skill_level("APPRAISAL");
     if (appraisal_skill >= required_skill)
     {
-        int value_fuzzed = MathX::fuzz(value_);
-        set_meta("appraised_value", value_fuzzed);
+        int value_fuzzed = MathX::fuzz(template_->value);
+        appraised_value_ = value_fuzzed;
         core()->world()->player()->gain_skill_xp("APPRAISAL", APPRAISAL_XP_EASY);
         if (tag(ItemTag::Stackable)) value_fuzzed *= stack_;
         return value_fuzzed;
@@ -46,9 +73,9 @@ int Item::appraised_value()
     else penalty = 1;
     const int rolled_penalty = core()->rng()->rnd(penalty);
     int value_appraised;
-    if (core()->rng()->rnd(3) == 1) value_appraised = MathX::fuzz(MathX::mixup(value_ / rolled_penalty, true));
-    else value_appraised = MathX::fuzz(MathX::mixup(value_ * rolled_penalty, true));
-    set_meta("appraised_value", value_appraised);
+    if (core()->rng()->rnd(3) == 1) value_appraised = MathX::fuzz(MathX::mixup(template_->value / rolled_penalty, true));
+    else value_appraised = MathX::fuzz(MathX::mixup(template_->value * rolled_penalty, true));
+    appraised_value_ = value_appraised;
     core()->world()->player()->gain_skill_xp("APPRAISAL", APPRAISAL_XP_HARD);
     if (tag(ItemTag::Stackable)) value_appraised *= stack_;
     return value_appraised;
@@ -57,7 +84,7 @@ int Item::appraised_value()
 // Returns the armour damage reduction value of this Item, if any.
 float Item::armour(int bonus_power) const
 {
-    if ((type_ != ItemType::ARMOUR && type_ != ItemType::SHIELD) || !power()) return 0;
+    if ((template_->type != ItemType::ARMOUR && template_->type != ItemType::SHIELD) || !power()) return 0;
     return std::pow(power() + bonus_power + 4, 1.2) / 100.0f;
 }
 
@@ -66,35 +93,43 @@ void Item::assign_inventory(std::shared_ptr<Inventory> inventory)
 {
     inventory_ = inventory;
     inventory_->set_prefix(Inventory::PID_PREFIX_ITEM_INV);
+    inventory_->set_container(this);
+    owner_update();
 }
 
 // Returns thie bleed chance of this Item, if any.
-int Item::bleed() const { return meta_int("bleed"); }
+int Item::bleed() const { return template_->stats.bleed; }
 
 // Returns the block modifier% for this Item, if any.
-int Item::block_mod() const { return meta_int("block_mod"); }
+int Item::block_mod() const { return template_->stats.block_mod; }
 
 // Returns this Item's capacity, if any.
-int Item::capacity() const { return meta_int("capacity"); }
+int Item::capacity() const { return template_->stats.capacity; }
 
 // Returns this Item's charge, if any.
-int Item::charge() const { return meta_int("charge"); }
+int Item::charge() const { return charge_; }
 
 // Clears a metatag from an Item. Use with caution!
-void Item::clear_meta(const std::string &key) { metadata_.erase(key); }
+void Item::clear_meta(const std::string &key)
+{
+    if (!template_->metadata.count(key)) return;
+    mutable_template()->metadata.erase(key);
+    owner_update();
+}
 
 // Clears a tag on this Item.
 void Item::clear_tag(ItemTag the_tag)
 {
-    if (!(tags_.count(the_tag) > 0)) return;
-    tags_.erase(the_tag);
+    if (!template_->tags.test(the_tag)) return;
+    mutable_template()->tags.clear(the_tag);
+    owner_update();
 }
 
 // Retrieves this Item's critical power, if any.
-int Item::crit() const { return meta_int("crit"); }
+int Item::crit() const { return template_->stats.crit; }
 
 // Retrieves this Item's damage type, if any.
-DamageType Item::damage_type() const { return static_cast<DamageType>(meta_int("damage_type")); }
+DamageType Item::damage_type() const { return template_->stats.damage_type; }
 
 // Returns a string indicator of this Item's damage type (e.g. edged = E)
 std::string Item::damage_type_string() const
@@ -119,13 +154,13 @@ std::string Item::damage_type_string() const
 }
 
 // Retrieves this Item's description.
-std::string Item::desc() const { return description_; }
+std::string Item::desc() const { return template_->description; }
 
 // Returns the dodge modifier% for this Item, if any.
-int Item::dodge_mod() const { return meta_int("dodge_mod"); }
+int Item::dodge_mod() const { return template_->stats.dodge_mod; }
 
 // Checks what slot this Item equips in, if any.
-EquipSlot Item::equip_slot() const { return static_cast<EquipSlot>(meta_int("slot")); }
+EquipSlot Item::equip_slot() const { return slot_; }
 
 // The inventory of this item, or nullptr if none exists.
 const std::shared_ptr<Inventory> Item::inv() { return inventory_; }
@@ -138,78 +173,71 @@ bool Item::is_identical(std::shared_ptr<Item> item) const
     // If an item has an inventory, it should be unstackable.
     if (inventory_ || item->inventory_) return false;
 
+    // Per-copy comparison. Appraised values might differ, so they're ignored here.
+    if (charge_ != item->charge_) return false;
+    if (slot_ != item->slot_) return false;
+    if (liquid_ != item->liquid_) return false;
+
+    // Copies of the same Item which haven't been changed share the same Template, so there's nothing more to check.
+    if (template_ == item->template_) return true;
+    const auto &ta = *template_, &tb = *item->template_;
+
     // Integer comparison.
-    if (rarity_ != item->rarity_) return false;
-    if (type_ != item->type_) return false;
-    if (type_sub_ != item->type_sub_) return false;
-    if (value_ != item->value_) return false;
-    if (weight_ != item->weight_) return false;
+    if (ta.rarity != tb.rarity) return false;
+    if (ta.type != tb.type) return false;
+    if (ta.type_sub != tb.type_sub) return false;
+    if (ta.value != tb.value) return false;
+    if (ta.weight != tb.weight) return false;
+    if (!ta.stats.identical(tb.stats)) return false;
 
     // String comparison.
-    if (name_ != item->name_) return false;
-    if (description_ != item->description_) return false;
+    if (ta.name != tb.name) return false;
+    if (ta.description != tb.description) return false;
 
     // Way more complicated comparison stuff below here.
-
-    // For metadata comparison, appraised values might differ. So we'll take that out of the equation.
-    auto copy_a = std::make_shared<Item>(*this);
-    auto copy_b = std::make_shared<Item>(*item);
-    copy_a->clear_meta("appraised_value");
-    copy_b->clear_meta("appraised_value");
-    if (StrX::metadata_to_string(copy_a->metadata_) != StrX::metadata_to_string(copy_b->metadata_)) return false;
-
-    // Tag matches are easier.
-    if (StrX::tags_to_string(tags_) != StrX::tags_to_string(item->tags_)) return false;
+    if (ta.metadata != tb.metadata) return false;
+    if (ta.tags != tb.tags) return false;
 
     return true;
 }
 
 // Returns the liquid type contained in this Item, if any.
-std::string Item::liquid_type() const { return meta("liquid"); }
+std::string Item::liquid_type() const { return liquid_; }
 
-// Loads a new Item from the save file.
-std::shared_ptr<Item> Item::load(std::shared_ptr<SQLite::Database> save_db, uint32_t sql_id)
+// Loads a new Item from the current row of a query on the items table.
+std::shared_ptr<Item> Item::load(SQLite::Statement &query)
 {
-    auto new_item = std::make_shared<Item>();
-    uint32_t inventory_id = 0;
-
-    SQLite::Statement query(*save_db, "SELECT * FROM items WHERE sql_id = :id");
-    query.bind(":id", sql_id);
-    if (query.executeStep())
-    {
-        ItemType new_type = ItemType::NONE;
-        ItemSub new_subtype = ItemSub::NONE;
-
-        if (!query.getColumn("description").isNull()) new_item->set_description(query.getColumn("description").getString());
-        if (!query.getColumn("inventory").isNull()) inventory_id = query.getColumn("inventory").getUInt();
-        if (!query.getColumn("metadata").isNull()) StrX::string_to_metadata(query.getColumn("metadata").getString(), new_item->metadata_);
-        new_item->set_name(query.getColumn("name").getString());
-        new_item->parser_id_ = query.getColumn("parser_id").getUInt();
-        new_item->rarity_ = query.getColumn("rare").getInt();
-        if (!query.isColumnNull("stack")) new_item->stack_ = query.getColumn("stack").getUInt(); else new_item->stack_ = 1;
-        if (!query.isColumnNull("subtype")) new_subtype = static_cast<ItemSub>(query.getColumn("subtype").getInt());
-        if (!query.getColumn("tags").isNull()) StrX::string_to_tags(query.getColumn("tags").getString(), new_item->tags_);
-        if (!query.isColumnNull("type")) new_type = static_cast<ItemType>(query.getColumn("type").getInt());
-        if (!query.isColumnNull("value")) new_item->value_ = query.getColumn("value").getUInt();
-        new_item->weight_ = query.getColumn("weight").getUInt();
-        new_item->set_type(new_type, new_subtype);
-    }
-    else throw std::runtime_error("Could not retrieve data for item ID " + std::to_string(sql_id));
+    auto new_item = Pool::make_shared<Item>();
+    ItemType new_type = ItemType::NONE;
+    ItemSub new_subtype = ItemSub::NONE;
 
-    if (inventory_id)
+    if (!query.getColumn("description").isNull()) new_item->set_description(query.getColumn("description").getString());
+    if (!query.getColumn("metadata").isNull())
     {
-        new_item->new_inventory();
-        new_item->inv()->load(save_db, inventory_id);
+        StrX::string_to_metadata(query.getColumn("metadata").getString(), new_item->mutable_template()->metadata);
+        new_item->metadata_to_stats();
     }
-
+    new_item->set_name(query.getColumn("name").getString());
+    new_item->parser_id_ = query.getColumn("parser_id").getUInt();
+    new_item->set_rare(query.getColumn("rare").getInt());
+    if (!query.isColumnNull("stack")) new_item->stack_ = query.getColumn("stack").getUInt(); else new_item->stack_ = 1;
+    if (!query.isColumnNull("subtype")) new_subtype = static_cast<ItemSub>(query.getColumn("subtype").getInt());
+    if (!query.getColumn("tags").isNull()) StrX::string_to_tags(query.getColumn("tags").getString(), new_item->mutable_template()->tags);
+    if (!query.isColumnNull("type")) new_type = static_cast<ItemType>(query.getColumn("type").getInt());
+    if (!query.isColumnNull("value")) new_item->set_value(query.getColumn("value").getUInt());
+    new_item->set_weight(query.getColumn("weight").getUInt());
+    new_item->set_type(new_type, new_subtype);
+
+    // The Item's own Inventory, if it has one, is loaded by Inventory::load() once the SaveReader has read every Item.
     return new_item;
 }
 
 // Retrieves Item metadata.
 std::string Item::meta(const std::string &key) const
 {
-    if (metadata_.find(key) == metadata_.end()) return "";
-    std::string result = metadata_.at(key);
+    const auto it = template_->metadata.find(key);
+    if (it == template_->metadata.end()) return "";
+    std::string result = it->second;
     StrX::find_and_replace(result, "_", " ");
     return result;
 }
@@ -230,8 +258,62 @@ int Item::meta_int(const std::string &key) const
     else return std::stoi(key_str);
 }
 
+// Moves any numerical stats out of the metadata map, when loading from the old string format.
+void Item::metadata_to_stats()
+{
+    Template *item_template = mutable_template();
+    auto &metadata = item_template->metadata;
+    auto take_int = [&metadata](const std::string &key) -> int {
+        const auto it = metadata.find(key);
+        if (it == metadata.end()) return 0;
+        const int result = std::stoi(it->second);
+        metadata.erase(it);
+        return result;
+    };
+    auto take_float = [&metadata](const std::string &key) -> float {
+        const auto it = metadata.find(key);
+        if (it == metadata.end()) return 0;
+        const float result = std::stof(it->second);
+        metadata.erase(it);
+        return result;
+    };
+
+    auto &stats = item_template->stats;
+    stats.ammo_power = take_float("ammo_power");
+    stats.bleed = take_int("bleed");
+    stats.block_mod = take_int("block_mod");
+    stats.capacity = take_int("capacity");
+    stats.crit = take_int("crit");
+    stats.damage_type = static_cast<DamageType>(take_int("damage_type"));
+    stats.dodge_mod = take_int("dodge_mod");
+    stats.parry_mod = take_int("parry_mod");
+    stats.poison = take_int("poison");
+    stats.power = take_int("power");
+    stats.speed = take_float("speed");
+    stats.warmth = take_int("warmth");
+
+    appraised_value_ = take_int("appraised_value");
+    charge_ = take_int("charge");
+    slot_ = static_cast<EquipSlot>(take_int("slot"));
+    const auto liquid_it = metadata.find("liquid");
+    if (liquid_it != metadata.end())
+    {
+        liquid_ = liquid_it->second;
+        StrX::find_and_replace(liquid_, "_", " ");
+        metadata.erase(liquid_it);
+    }
+}
+
 // Accesses the metadata map directly. Use with caution!
-std::map<std::string, std::string>* Item::meta_raw() { return &metadata_; }
+std::map<std::string, std::string>* Item::meta_raw() { return &mutable_template()->metadata; }
+
+// Returns this Item's Template for writing, copying it first if any other Items share it.
+Item::Template* Item::mutable_template()
+{
+    if (template_.use_count() > 1) template_ = std::make_shared<Template>(*template_);
+    template_->hash = 0;
+    return template_.get();
+}
 
 // Retrieves the name of thie Item.
 std::string Item::name(int flags) const
@@ -248,7 +330,7 @@ std::string Item::name(int flags) const
     const bool rarity = ((flags & Item::NAME_FLAG_RARE) == Item::NAME_FLAG_RARE);
 
     bool using_plural_name = false;
-    std::string ret = name_, plural_name = meta("plural_name");
+    std::string ret = template_->name, plural_name = meta("plural_name");
     if (plural && plural_name.size())
     {
         ret = plural_name;
@@ -258,7 +340,7 @@ std::string Item::name(int flags) const
     if (stack_ > 1 && !no_count) ret = StrX::number_to_word(stack_) + " " + name(NAME_FLAG_PLURAL | NAME_FLAG_NO_COUNT);
 
     if (the && !tag(ItemTag::ProperNoun)) ret = "the " + ret;
-    else if (a && !tag(ItemTag::PluralName) && !tag(ItemTag::NoA) && !tag(ItemTag::ProperNoun))
+    else if (a && !tag_any({ItemTag::PluralName, ItemTag::NoA, ItemTag::ProperNoun}))
     {
         if (StrX::is_vowel(ret[0])) ret = "an " + ret;
         else ret = "a " + ret;
@@ -269,7 +351,7 @@ std::string Item::name(int flags) const
     if (core_stats || full_stats)
     {
         std::string core_stats_str, full_stats_str;
-        switch (type_)
+        switch (template_->type)
         {
             case ItemType::ARMOUR: case ItemType::SHIELD: full_stats_str += " {c}[{U}" + std::to_string(power()) + "{c}]"; break;
             case ItemType::DRINK:
@@ -287,7 +369,7 @@ std::string Item::name(int flags) const
     if (rarity)
     {
         std::string colour_a = "{w}", colour_b = "{w}";
-        switch (rarity_)
+        switch (template_->rarity)
         {
             case 4: case 5: case 6: colour_a = "{U}"; colour_b = "{C}"; break;
             case 7: case 8: colour_a = "{g}"; colour_b = "{G}"; break;
@@ -295,8 +377,8 @@ std::string Item::name(int flags) const
             case 10: colour_a = "{y}"; colour_b = "{Y}"; break;
             case 11: colour_a = "{r}"; colour_b = "{R}"; break;
         }
-        if (rarity_ == 12) ret += " {M}[" + StrX::rainbow_text("RARE-12", "mB") + "{M}]";
-        else ret += " " + colour_a + "[" + colour_b + "RARE-" + std::to_string(rarity_) + colour_a + "]";
+        if (template_->rarity == 12) ret += " {M}[" + StrX::rainbow_text("RARE-12", "mB") + "{M}]";
+        else ret += " " + colour_a + "[" + colour_b + "RARE-" + std::to_string(template_->rarity) + colour_a + "]";
     }
     if (id) ret += " {B}{" + StrX::itos(parser_id_, 4) + "}";
     if (no_colour) ret = StrX::strip_ansi(ret);
@@ -304,61 +386,91 @@ std::string Item::name(int flags) const
 }
 
 // Creates an inventory for this item.
-void Item::new_inventory() { inventory_ = std::make_shared<Inventory>(Inventory::PID_PREFIX_ITEM_INV); }
+void Item::new_inventory()
+{
+    inventory_ = Pool::make_shared<Inventory>(Inventory::PID_PREFIX_ITEM_INV);
+    inventory_->set_container(this);
+    owner_update();
+}
+
+// The Inventory this Item is stored in, if any.
+Inventory* Item::owner() const { return owner_; }
 
-// Generates a new parser ID for this Item.
-void Item::new_parser_id(uint8_t prefix) { parser_id_ = core()->rng()->rnd(0, 999) + (prefix * 1000); }
+// Lets the Inventory holding this Item know that its weight, equipment slot or stack hash might have changed.
+void Item::owner_update() { if (owner_) owner_->item_changed(this); }
 
 // Returns the parry% modifier of this Item, if any.
-int Item::parry_mod() const { return meta_int("parry_mod"); }
+int Item::parry_mod() const { return template_->stats.parry_mod; }
 
 // Retrieves the current ID of this Item, for parser differentiation.
 uint16_t Item::parser_id() const { return parser_id_; }
 
 // Returns thie poison chance of this Item, if any.
-int Item::poison() const { return meta_int("poison"); }
+int Item::poison() const { return template_->stats.poison; }
 
 // Retrieves this Item's power.
-int Item::power() const { return meta_int("power"); }
+int Item::power() const { return template_->stats.power; }
 
 // Retrieves this Item's rarity.
-int Item::rare() const { return rarity_; }
+int Item::rare() const { return template_->rarity; }
 
-// Saves the Item.
-void Item::save(std::shared_ptr<SQLite::Database> save_db, uint32_t owner_id)
+// Saves the Item to the save file, as the Item at a given position in the specified Inventory.
+void Item::save(std::shared_ptr<SaveWriter> writer, uint32_t owner_id, uint32_t position)
 {
     uint32_t inventory_id = 0;
-    if (inventory_) inventory_id = inventory_->save(save_db);
-
-    SQLite::Statement query(*save_db, "INSERT INTO items ( description, inventory, metadata, name, owner_id, parser_id, rare, sql_id, stack, subtype, tags, type, value, weight ) VALUES ( :desc, :inventory, :meta, :name, :owner_id, :parser_id, :rare, :sql_id, :stack, :subtype, :tags, :type, :value, :weight )");
-    if (description_.size()) query.bind(":desc", description_);
-    if (inventory_id) query.bind(":inventory", inventory_id);
-    if (metadata_.size()) query.bind(":meta", StrX::metadata_to_string(metadata_));
-    query.bind(":name", name_);
-    query.bind(":owner_id", owner_id);
-    query.bind(":parser_id", parser_id_);
-    query.bind(":rare", rarity_);
-    query.bind(":sql_id", core()->sql_unique_id());
-    if (stack_ != 1) query.bind(":stack", stack_);
-    if (type_sub_ != ItemSub::NONE) query.bind(":subtype", static_cast<int>(type_sub_));
-    if (tags_.size()) query.bind(":tags", StrX::tags_to_string(tags_));
-    if (type_ != ItemType::NONE) query.bind(":type", static_cast<int>(type_));
-    if (value_) query.bind(":value", value_);
-    query.bind(":weight", weight_);
-    query.exec();
+    if (inventory_) inventory_id = inventory_->save(writer);
+
+    // Items are keyed by their owner and their position in its Inventory, which also keeps them in the right order when they're loaded.
+    const int64_t sql_id = (static_cast<int64_t>(owner_id) << 32) | static_cast<int64_t>(position);
+    writer->upsert(SQL_ITEMS_INSERT, SQL_ITEMS_DELETE, sql_id);
+    if (template_->description.size()) writer->bind(":desc", template_->description);
+    if (inventory_id) writer->bind(":inventory", inventory_id);
+    const std::string metadata = stats_to_metadata();
+    if (metadata.size()) writer->bind(":meta", metadata);
+    writer->bind(":name", template_->name);
+    writer->bind(":owner_id", owner_id);
+    writer->bind(":parser_id", parser_id_);
+    writer->bind(":rare", template_->rarity);
+    writer->bind(":sql_id", sql_id);
+    if (stack_ != 1) writer->bind(":stack", stack_);
+    if (template_->type_sub != ItemSub::NONE) writer->bind(":subtype", static_cast<int>(template_->type_sub));
+    if (template_->tags.count()) writer->bind(":tags", StrX::tags_to_string(template_->tags));
+    if (template_->type != ItemType::NONE) writer->bind(":type", static_cast<int>(template_->type));
+    if (template_->value) writer->bind(":value", template_->value);
+    writer->bind(":weight", template_->weight);
+    writer->write();
 }
 
+// Sets the player's appraisal of this Item's value.
+void Item::set_appraised_value(int value) { appraised_value_ = value; }
+
 // Sets the charge level of this Item.
-void Item::set_charge(int new_charge) { set_meta("charge", new_charge); }
+void Item::set_charge(int new_charge)
+{
+    charge_ = new_charge;
+    owner_update();
+}
 
 // Sets this Item's description.
-void Item::set_description(const std::string &desc) { description_ = desc; }
+void Item::set_description(const std::string &desc)
+{
+    mutable_template()->description = desc;
+    owner_update();
+}
 
 // Sets this Item's equipment slot.
-void Item::set_equip_slot(EquipSlot es) { set_meta("slot", static_cast<int>(es)); }
+void Item::set_equip_slot(EquipSlot es)
+{
+    slot_ = es;
+    owner_update();
+}
 
 // Sets the liquid contents of this Item.
-void Item::set_liquid(const std::string &new_liquid) { set_meta("liquid", new_liquid); }
+void Item::set_liquid(const std::string &new_liquid)
+{
+    liquid_ = new_liquid;
+    owner_update();
+}
 
 // Adds Item metadata.
 void Item::set_meta(const std::string &key, std::string value)
@@ -369,8 +481,10 @@ void Item::set_meta(const std::string &key, std::string value)
         return;
     }
     StrX::find_and_replace(value, " ", "_");
-    if (metadata_.find(key) == metadata_.end()) metadata_.insert(std::pair<std::string, std::string>(key, value));
-    else metadata_.at(key) = value;
+    const auto it = template_->metadata.find(key);
+    if (it != template_->metadata.end() && it->second == value) return;
+    mutable_template()->metadata[key] = value;
+    owner_update();
 }
 
 // As above, but with an integer value.
@@ -395,67 +509,137 @@ void Item::set_meta(const std::string &key, float value)
 }
 
 // Sets the name of this Item.
-void Item::set_name(const std::string &name) { name_ = name; }
-
-// Sets this item's parser ID prefix.
-void Item::set_parser_id_prefix(uint8_t prefix)
+void Item::set_name(const std::string &name)
 {
-    if (!parser_id_)
-    {
-        new_parser_id(prefix);
-        return;
-    }
-    int old_prefix = parser_id_ / 1000;
-    parser_id_ -= (old_prefix * 1000);
-    parser_id_ += (prefix * 1000);
+    mutable_template()->name = name;
+    owner_update();
 }
 
+// Sets the Inventory this Item is stored in. This should only be called by Inventory itself.
+void Item::set_owner(Inventory* owner) { owner_ = owner; }
+
+// Sets this Item's parser ID.
+void Item::set_parser_id(uint16_t id) { parser_id_ = id; }
+
+// Sets this item's parser ID prefix.
+void Item::set_parser_id_prefix(uint8_t prefix) { parser_id_ = (parser_id_ % ParserIDs::PREFIX_RANGE) + (prefix * ParserIDs::PREFIX_RANGE); }
+
 // Sets this Item's rarity.
-void Item::set_rare(int rarity) { rarity_ = rarity; }
+void Item::set_rare(int rarity)
+{
+    mutable_template()->rarity = rarity;
+    owner_update();
+}
 
 // Sets the stack size for this Item.
-void Item::set_stack(uint32_t size) { stack_ = size; }
+void Item::set_stack(uint32_t size)
+{
+    stack_ = size;
+    owner_update();
+}
 
 // Sets a tag on this Item.
 void Item::set_tag(ItemTag the_tag)
 {
-    if (tags_.count(the_tag) > 0) return;
-    tags_.insert(the_tag);
+    if (template_->tags.test(the_tag)) return;
+    mutable_template()->tags.set(the_tag);
+    owner_update();
 }
 
 // Sets the type of this Item.
 void Item::set_type(ItemType type, ItemSub sub)
 {
-    type_ = type;
-    type_sub_ = sub;
+    Template *item_template = mutable_template();
+    item_template->type = type;
+    item_template->type_sub = sub;
+    owner_update();
 }
 
 // Sets this Item's value.
-void Item::set_value(uint32_t val) { value_ = val; }
+void Item::set_value(uint32_t val)
+{
+    mutable_template()->value = val;
+    owner_update();
+}
 
 // Sets this Item's weight.
-void Item::set_weight(uint32_t pacs) { weight_ = pacs; }
+void Item::set_weight(uint32_t pacs)
+{
+    mutable_template()->weight = pacs;
+    owner_update();
+}
 
 // Retrieves the speed of this Item.
-float Item::speed() const { return meta_float("speed"); }
+float Item::speed() const { return template_->stats.speed; }
 
 // Splits an Item into a stack.
 std::shared_ptr<Item> Item::split(int split_count)
 {
     const bool stackable = tag(ItemTag::Stackable);
-    if (split_count < 0) throw std::runtime_error("Invalid item stack split: " + name_);
+    if (split_count < 0) throw std::runtime_error("Invalid item stack split: " + template_->name);
     if (!split_count || (split_count == 1 && !stackable) || static_cast<int64_t>(split_count) == stack_) return nullptr;
-    if (!stackable) throw std::runtime_error("Attempt to split unstackable item: " + name_);
-    if (static_cast<unsigned int>(split_count) > stack_) throw std::runtime_error("Invalid stack split size: " + name_);
-    auto new_item = std::make_shared<Item>(*this);
+    if (!stackable) throw std::runtime_error("Attempt to split unstackable item: " + template_->name);
+    if (static_cast<unsigned int>(split_count) > stack_) throw std::runtime_error("Invalid stack split size: " + template_->name);
+    auto new_item = Pool::make_shared<Item>(*this);
     new_item->stack_ = split_count;
     stack_ -= split_count;
+    owner_update();
     return new_item;
 }
 
 // Retrieves the stack size of this Item.
 uint32_t Item::stack() const { return stack_; }
 
+// A hash of everything that is_identical() compares, for quickly finding Items which might stack together.
+uint32_t Item::stack_hash() const
+{
+    // This is an FNV-1a hash, made with StrX::fnv_mix(). The Template's part of the hash is cached, as it's shared with every other copy of this Item.
+    uint32_t hash = StrX::FNV_OFFSET_32;
+    auto mix = [&hash](uint32_t value) { StrX::fnv_mix(&hash, value); };
+    auto mix_float = [&mix](float value) {
+        uint32_t bits = 0;
+        if (value) std::memcpy(&bits, &value, sizeof(bits));    // Positive and negative zero compare as equal, so they have to hash the same too.
+        mix(bits);
+    };
+
+    if (!template_->hash)
+    {
+        const auto &stats = template_->stats;
+        mix(StrX::hash(template_->name));
+        mix(StrX::hash(template_->description));
+        mix(template_->rarity);
+        mix(static_cast<uint32_t>(template_->type));
+        mix(static_cast<uint32_t>(template_->type_sub));
+        mix(template_->value);
+        mix(template_->weight);
+        mix_float(stats.ammo_power);
+        mix(stats.bleed);
+        mix(stats.block_mod);
+        mix(stats.capacity);
+        mix(stats.crit);
+        mix(static_cast<uint32_t>(stats.damage_type));
+        mix(stats.dodge_mod);
+        mix(stats.parry_mod);
+        mix(stats.poison);
+        mix(stats.power);
+        mix_float(stats.speed);
+        mix(stats.warmth);
+        for (auto meta : template_->metadata)
+        {
+            mix(StrX::hash(meta.first));
+            mix(StrX::hash(meta.second));
+        }
+        template_->tags.for_each([&mix](ItemTag tag) { mix(static_cast<uint32_t>(tag)); });
+        template_->hash = (hash ? hash : 1);
+    }
+
+    hash = template_->hash;
+    mix(charge_);
+    mix(static_cast<uint32_t>(slot_));
+    if (liquid_.size()) mix(StrX::hash(liquid_));
+    return hash;
+}
+
 // Like name(), but provides an appropriate name for a given stack size. Works on non-stackable items too.
 std::string Item::stack_name(int stack_size, int flags)
 {
@@ -480,31 +664,73 @@ std::string Item::stack_name(int stack_size, int flags)
     return the_str + StrX::number_to_word(stack_size) + " " + name(NAME_FLAG_PLURAL | NAME_FLAG_NO_COUNT | flags);
 }
 
+// Retrieves this Item's numerical stats.
+const ItemStats& Item::stats() const { return template_->stats; }
+
+// Accesses the numerical stats directly. Use with caution!
+ItemStats* Item::stats_raw() { return &mutable_template()->stats; }
+
+// Converts the metadata and numerical stats into a single metadata string, for saving.
+std::string Item::stats_to_metadata() const
+{
+    // Stats are written into the same metadata string they used to be stored in, so saved games stay compatible either way. Like the old metadata, zero values are left out.
+    auto metadata = template_->metadata;
+    auto put_int = [&metadata](const std::string &key, int value) { if (value) metadata[key] = std::to_string(value); };
+    auto put_float = [&metadata](const std::string &key, float value) { if (value) metadata[key] = StrX::ftos(value, 1); };
+
+    const auto &stats = template_->stats;
+    put_float("ammo_power", stats.ammo_power);
+    put_int("appraised_value", appraised_value_);
+    put_int("bleed", stats.bleed);
+    put_int("block_mod", stats.block_mod);
+    put_int("capacity", stats.capacity);
+    put_int("charge", charge_);
+    put_int("crit", stats.crit);
+    put_int("damage_type", static_cast<int>(stats.damage_type));
+    put_int("dodge_mod", stats.dodge_mod);
+    put_int("parry_mod", stats.parry_mod);
+    put_int("poison", stats.poison);
+    put_int("power", stats.power);
+    put_int("slot", static_cast<int>(slot_));
+    put_float("speed", stats.speed);
+    put_int("warmth", stats.warmth);
+    if (liquid_.size())
+    {
+        std::string liquid = liquid_;
+        StrX::find_and_replace(liquid, " ", "_");
+        metadata["liquid"] = liquid;
+    }
+    return StrX::metadata_to_string(metadata);
+}
+
 // Returns the ItemSub (sub-type) of this Item.
-ItemSub Item::subtype() const { return type_sub_; }
+ItemSub Item::subtype() const { return template_->type_sub; }
 
 // Checks if a tag is set on this Item.
-bool Item::tag(ItemTag the_tag) const { return (tags_.count(the_tag) > 0); }
+bool Item::tag(ItemTag the_tag) const { return template_->tags.test(the_tag); }
+
+// Checks if any of the tags in a mask are set on this Item.
+bool Item::tag_any(const ItemTags &mask) const { return template_->tags.any(mask); }
 
 // Returns the ItemType of this Item.
-ItemType Item::type() const { return type_; }
+ItemType Item::type() const { return template_->type; }
 
 // The Item's value in money.
 uint32_t Item::value(bool individual) const
 {
-    if (individual || !tag(ItemTag::Stackable)) return value_;
-    else return value_ * stack_;
+    if (individual || !tag(ItemTag::Stackable)) return template_->value;
+    else return template_->value * stack_;
 }
 
 // The Item's warmth rating, if any.
-int Item::warmth() const { return meta_int("warmth"); }
+int Item::warmth() const { return template_->stats.warmth; }
 
 // The Item's weight, in pacs.
 uint32_t Item::weight(bool individual) const
 {
     uint32_t water_weight = 0, container_weight = 0;
-    if (type_ == ItemType::DRINK) water_weight = std::round(charge() * WATER_WEIGHT);
+    if (template_->type == ItemType::DRINK) water_weight = std::round(charge() * WATER_WEIGHT);
     if (inventory_) container_weight = inventory_->weight();
-    if (individual || !tag(ItemTag::Stackable)) return weight_ + water_weight + container_weight;
-    else return (weight_ + water_weight + container_weight) * stack_;
+    if (individual || !tag(ItemTag::Stackable)) return template_->weight + water_weight + container_weight;
+    else return (template_->weight + water_weight + container_weight) * stack_;
 }
@@ -5,11 +5,13 @@
 #define GREAVE_WORLD_ITEM_H_
 
 #include "3rdparty/SQLiteCpp/Database.h"
+#include "core/save-reader.h"
+#include "core/save-writer.h"
+#include "core/tag-set.h"
 
 #include <cstdint>
 #include <map>
 #include <memory>
-#include <set>
 #include <string>
 
 class Inventory;    // Forward declarations are bad, I know, but this is the only way to avoid item.h and inventory.h trying to include each other.
@@ -55,6 +57,29 @@ enum class ItemTag : uint16_t { _None = 0,  // Do not use this tag, it's just a
     // Tags specific to consumable items.
     DiscardWhenEmpty,   // Throw this item away automatically when it's empty.
     TavernOnly,         // This item will have to be left behind if you leave a tavern.
+
+    _End                // Do not use this tag, it's just a marker for the number of tags above.
+};
+
+typedef TagSet<ItemTag, static_cast<size_t>(ItemTag::_End)> ItemTags;   // A set of ItemTags, or a mask of them.
+
+// The numerical stats of an Item, kept in a fixed layout so they don't have to be parsed from strings every time they're checked.
+struct ItemStats
+{
+    float       ammo_power = 0;         // The damage multiplier for ammunition.
+    int         bleed = 0;              // The bleed chance of this Item.
+    int         block_mod = 0;          // The block modifier% for this Item.
+    int         capacity = 0;           // This Item's capacity, for liquid containers.
+    int         crit = 0;               // This Item's critical power.
+    DamageType  damage_type = DamageType::ACID; // This Item's damage type. Defaults to the first damage type, as the old metadata did when it was unset.
+    int         dodge_mod = 0;          // The dodge modifier% for this Item.
+    int         parry_mod = 0;          // The parry modifier% for this Item.
+    int         poison = 0;             // The poison chance of this Item.
+    int         power = 0;              // This Item's power.
+    float       speed = 0;              // The speed of this Item.
+    int         warmth = 0;             // This Item's warmth rating.
+
+    bool    identical(const ItemStats &other) const;    // Checks if two sets of stats are identical.
 };
 
 class Item
@@ -74,9 +99,14 @@ public:
 
     static constexpr float  WATER_WEIGHT =                  58.68f;     // The weight of 1 unit of water.
     static const char       SQL_ITEMS[];                                // The SQL table construction string for saving items.
+    static const char       SQL_ITEMS_DELETE[];                         // The SQL statement for deleting an item which is no longer in the save file.
+    static const char       SQL_ITEMS_INSERT[];                         // The SQL statement for saving an item.
 
                 Item();                                     // Constructor, sets default values.
+                Item(const Item &other);                    // Copy constructor. The copy isn't in any Inventory yet, even if the original is.
+                ~Item();                                    // Destructor, lets this Item's own inventory know that it's gone.
     float       ammo_power() const;                         // The damage multiplier for ammunition.
+    int         appraisal() const;                          // Retrieves the player's stored appraisal of this Item's value, or 0 if it hasn't been appraised yet.
     int         appraised_value();                          // Attempts to guess the value of an item.
     float       armour(int bonus_power = 0) const;          // Returns the armour damage reduction value of this Item, if any.
     void        assign_inventory(std::shared_ptr<Inventory> inventory); // Assigns another inventory to this item. Use with caution.
@@ -95,20 +125,20 @@ public:
     const std::shared_ptr<Inventory> inv();                 // The inventory of this item, or nullptr if none exists.
     bool        is_identical(std::shared_ptr<Item> item) const; // Checks if this Item is identical to another (except stack size).
     std::string liquid_type() const;                        // Returns the liquid type contained in this Item, if any.
-    static std::shared_ptr<Item> load(std::shared_ptr<SQLite::Database> save_db, uint32_t sql_id);  // Loads a new Item from the save file.
+    static std::shared_ptr<Item> load(SQLite::Statement &query);    // Loads a new Item from the current row of a query on the items table.
     std::string meta(const std::string &key) const;         // Retrieves Item metadata.
     float       meta_float(const std::string &key) const;   // Retrieves metadata, in float format.
     int         meta_int(const std::string &key) const;     // Retrieves metadata, in int format.
     std::map<std::string, std::string>* meta_raw();         // Accesses the metadata map directly. Use with caution!
     std::string name(int flags = 0) const;                  // Retrieves the name of thie Item.
     void        new_inventory();                            // Creates an inventory for this item.
-    void        new_parser_id(uint8_t prefix);              // Generates a new parser ID for this Item.
+    Inventory*  owner() const;                              // The Inventory this Item is stored in, if any.
     int         parry_mod() const;                          // Returns the parry% modifier of this Item, if any.
     uint16_t    parser_id() const;                          // Retrieves the current ID of this Item, for parser differentiation.
     int         poison() const;                             // Returns the poison chance of this item, if any.
     int         power() const;                              // Retrieves this Item's power.
     int         rare() const;                               // Retrieves this Item's rarity.
-    void        save(std::shared_ptr<SQLite::Database> save_db, uint32_t owner_id); // Saves the Item to the save file.
+    void        save(std::shared_ptr<SaveWriter> writer, uint32_t owner_id, uint32_t position);  // Saves the Item to the save file, as the Item at a given position in the specified Inventory.
     void        set_charge(int new_charge);                 // Sets the charge level of this Item.
     void        set_description(const std::string &desc);   // Sets this Item's description.
     void        set_equip_slot(EquipSlot es);               // Sets this Item's equipment slot.
@@ -118,7 +148,10 @@ public:
     void        set_meta(const std::string &key, uint32_t value);       // As above, but with an unsigned integer value.
     void        set_meta(const std::string &key, float value);          // As above again, but this time for floats.
     void        set_name(const std::string &name);          // Sets the name of this Item.
+    void        set_owner(Inventory* owner);                // Sets the Inventory this Item is stored in. This should only be called by Inventory itself.
+    void        set_parser_id(uint16_t id);                 // Sets this Item's parser ID.
     void        set_parser_id_prefix(uint8_t prefix);       // Sets this item's parser ID prefix.
+    void        set_appraised_value(int value);             // Sets the player's appraisal of this Item's value.
     void        set_rare(int rarity);                       // Sets this Item's rarity.
     void        set_stack(uint32_t size);                   // Sets the stack size for this Item.
     void        set_tag(ItemTag the_tag);                   // Sets a tag on this Item.
@@ -128,9 +161,13 @@ public:
     float       speed() const;                              // Retrieves the speed of this Item.
     std::shared_ptr<Item>    split(int split_count);        // Splits an Item into a stack.
     uint32_t    stack() const;                              // Retrieves the stack size of this Item.
+    uint32_t    stack_hash() const;                         // A hash of everything that is_identical() compares, for quickly finding Items which might stack together.
     std::string stack_name(int stack_size, int flags = 0);  // Like name(), but provides an appropriate name for a given stack size. Works on non-stackable items too.
+    const ItemStats&    stats() const;                      // Retrieves this Item's numerical stats.
+    ItemStats*  stats_raw();                                // Accesses the numerical stats directly. Use with caution!
     ItemSub     subtype() const;                            // Returns the ItemSub (sub-type) of this Item.
     bool        tag(ItemTag the_tag) const;                 // Checks if a tag is set on this Item.
+    bool        tag_any(const ItemTags &mask) const;        // Checks if any of the tags in a mask are set on this Item.
     ItemType    type() const;                               // Returns the ItemType of this Item.
     uint32_t    value(bool individual = false) const;       // The Item's value in money.
     int         warmth() const;                             // The Item's warmth rating, if any.
@@ -142,18 +179,36 @@ private:
     static constexpr int    APPRAISAL_XP_EASY =             1;      // The amount of appraisal XP gained for an easy item appraisal.
     static constexpr int    APPRAISAL_XP_HARD =             5;      // The amount of appraisal XP gained for a difficult item appraisal.
 
-    std::string                         description_;   // The description of this Item.
+    // The parts of an Item that rarely change after it's created. Copies of an Item share the same Template, until one of them changes something in it.
+    struct Template
+    {
+        std::string                         description;    // The description of this Item.
+        std::map<std::string, std::string>  metadata;       // The Item's free-form metadata, if any. Numerical stats are kept in stats instead.
+        std::string                         name;           // The name of this Item!
+        uint8_t                             rarity = 1;     // The rarity of this Item.
+        ItemStats                           stats;          // The numerical stats of this Item.
+        ItemTags                            tags;           // Any and all ItemTags on this Item.
+        ItemType                            type = ItemType::NONE;      // The primary type of this Item.
+        ItemSub                             type_sub = ItemSub::NONE;   // The subtype of this Item, if any.
+        mutable uint32_t                    hash = 0;       // The cached hash of everything above, or 0 if it needs to be recalculated.
+        uint32_t                            value = 0;      // The value of this Item, if any.
+        uint32_t                            weight = 0;     // The weight of this Item.
+    };
+
+    void        metadata_to_stats();                        // Moves any numerical stats out of the metadata map, when loading from the old string format.
+    Template*   mutable_template();                         // Returns this Item's Template for writing, copying it first if any other Items share it.
+    void        owner_update();                             // Lets the Inventory holding this Item know that its weight, equipment slot or stack hash might have changed.
+    std::string stats_to_metadata() const;                  // Converts the metadata and numerical stats into a single metadata string, for saving.
+
+    int                                 appraised_value_;   // The player's best guess at this Item's value, or 0 if it hasn't been appraised.
+    int                                 charge_;        // This Item's charge, for liquid containers.
     std::shared_ptr<Inventory>          inventory_;     // The contents of this item, if any.
-    std::map<std::string, std::string>  metadata_;      // The Item's metadata, if any.
-    std::string                         name_;          // The name of this Item!
+    std::string                         liquid_;        // The liquid contained in this Item, if any.
+    Inventory*                          owner_;         // The Inventory this Item is stored in, if any. It doesn't own the Inventory, it's just so the Inventory can be told about changes.
     uint16_t                            parser_id_;     // The semi-unique ID of this Item, for parser differentiation.
-    uint8_t                             rarity_;        // The rarity of this Item.
+    EquipSlot                           slot_;          // The slot this Item equips in. This isn't part of the Template, as shields and off-hand weapons have their slot changed when equipped.
     uint32_t                            stack_;         // If this Item can be stacked, this is how many is in the stack.
-    std::set<ItemTag>                   tags_;          // Any and all ItemTags on this Item.
-    ItemType                            type_;          // The primary type of this Item.
-    ItemSub                             type_sub_;      // The subtype of this Item, if any.
-    uint32_t                            value_;         // The value of this Item, if any.
-    uint32_t                            weight_;        // The weight of this Item.
+    std::shared_ptr<Template>           template_;      // The parts of this Item which are shared with other copies of it.
 };
 
 #endif  // GREAVE_WORLD_ITEM_H_
@@ -4,46 +4,72 @@
 #include "actions/arena.h"
 #include "actions/combat.h"
 #include "core/core.h"
+#include "core/pool.h"
 #include "core/strx.h"
 #include "world/mobile.h"
 
 
 // The SQL table construction string for the buffs table.
-constexpr char Buff::SQL_BUFFS[] = "CREATE TABLE buffs ( owner INTEGER, power INTEGER, sql_id INTEGER PRIMARY KEY UNIQUE NOT NULL, time INTEGER, type INTEGER NOT NULL )";
+constexpr char Buff::SQL_BUFFS[] = "CREATE TABLE IF NOT EXISTS buffs ( owner INTEGER, power INTEGER, sql_id INTEGER PRIMARY KEY UNIQUE NOT NULL, time INTEGER, type INTEGER NOT NULL )";
+
+// The SQL statement for deleting a row from the buffs table.
+constexpr char Buff::SQL_BUFFS_DELETE[] = "DELETE FROM buffs WHERE sql_id = ?";
+
+// The SQL statement for saving a row in the buffs table.
+constexpr char Buff::SQL_BUFFS_INSERT[] = "INSERT OR REPLACE INTO BUFFS ( owner, power, sql_id, time, type ) VALUES ( :owner, :power, :sql_id, :time, :type )";
 
 // The SQL table construction string for the mobiles table.
-constexpr char Mobile::SQL_MOBILES[] = "CREATE TABLE mobiles ( action_timer REAL, equipment INTEGER UNIQUE, gender INTEGER, hostility TEXT, hp INTEGER NOT NULL, hp_max INTEGER NOT NULL, id INTEGER UNIQUE NOT NULL, inventory INTEGER UNIQUE, location INTEGER NOT NULL, metadata TEXT, name TEXT, parser_id INTEGER, score INTEGER, spawn_room INTEGER, species TEXT NOT NULL, sql_id INTEGER PRIMARY KEY UNIQUE NOT NULL, stance INTEGER, tags TEXT )";
+constexpr char Mobile::SQL_MOBILES[] = "CREATE TABLE IF NOT EXISTS mobiles ( action_timer REAL, equipment INTEGER UNIQUE, gender INTEGER, hostility TEXT, hp INTEGER NOT NULL, hp_max INTEGER NOT NULL, id INTEGER UNIQUE NOT NULL, inventory INTEGER UNIQUE, last_active INTEGER NOT NULL, location INTEGER NOT NULL, metadata TEXT, name TEXT, parser_id INTEGER, score INTEGER, spawn_room INTEGER, species TEXT NOT NULL, sql_id INTEGER PRIMARY KEY UNIQUE NOT NULL, stance INTEGER, tags TEXT )";
 
+// The SQL statement for deleting a row from the mobiles table.
+constexpr char Mobile::SQL_MOBILES_DELETE[] = "DELETE FROM mobiles WHERE sql_id = ?";
+
+// The SQL statement for saving a row in the mobiles table.
+constexpr char Mobile::SQL_MOBILES_INSERT[] = "INSERT OR REPLACE INTO mobiles ( action_timer, equipment, gender, hostility, hp, hp_max, id, inventory, last_active, location, metadata, name, parser_id, score, spawn_room, species, sql_id, stance, tags ) VALUES ( :action_timer, :equipment, :gender, :hostility, :hp, :hp_max, :id, :inventory, :last_active, :location, :metadata, :name, :parser_id, :score, :spawn_room, :species, :sql_id, :stance, :tags )";
 
-// Loads this Buff from a save file.
-std::shared_ptr<Buff> Buff::load(SQLite::Statement &query)
-{
-    auto new_buff = std::make_shared<Buff>();
-    if (!query.isColumnNull("power")) new_buff->power = query.getColumn("power").getUInt();
-    if (!query.isColumnNull("time")) new_buff->time = query.getColumn("time").getUInt();
-    new_buff->type = static_cast<Buff::Type>(query.getColumn("type").getUInt());
-    return new_buff;
-}
 
 // Saves this Buff to a save file.
-void Buff::save(std::shared_ptr<SQLite::Database> save_db, uint32_t owner_id)
+void Buff::save(std::shared_ptr<SaveWriter> writer, uint32_t owner_id, Type type, uint16_t time) const
 {
-    SQLite::Statement query(*save_db, "INSERT INTO BUFFS ( owner, power, sql_id, time, type ) VALUES ( :owner, :power, :sql_id, :time, :type )");
-    query.bind(":owner", owner_id);
-    if (power) query.bind(":power", power);
-    query.bind(":sql_id", core()->sql_unique_id());
-    if (time != UINT16_MAX) query.bind(":time", time);
-    query.bind(":type", static_cast<int>(type));
-    query.exec();
+    // Each Mobile can only have one Buff of each type, so the owner and type together make a key that stays the same from one save to the next.
+    const int64_t sql_id = (static_cast<int64_t>(owner_id) << 8) | static_cast<int64_t>(type);
+    writer->upsert(SQL_BUFFS_INSERT, SQL_BUFFS_DELETE, sql_id);
+    writer->bind(":owner", owner_id);
+    if (power) writer->bind(":power", power);
+    writer->bind(":sql_id", sql_id);
+    if (time != UINT16_MAX) writer->bind(":time", time);
+    writer->bind(":type", static_cast<int>(type));
+    writer->write();
 }
 
 
 // Constructor, sets default values.
-Mobile::Mobile() : action_timer_(0), equipment_(std::make_shared<Inventory>(Inventory::PID_PREFIX_EQUIPMENT)), gender_(Gender::IT), id_(0), inventory_(std::make_shared<Inventory>(Inventory::PID_PREFIX_INVENTORY)), location_(0), parser_id_(0), score_(0), spawn_room_(0), stance_(CombatStance::BALANCED)
+Mobile::Mobile() : action_timer_(0), equipment_(Pool::make_shared<Inventory>(Inventory::PID_PREFIX_EQUIPMENT)), gear_version_(0), gender_(Gender::IT), id_(0), inventory_(Pool::make_shared<Inventory>(Inventory::PID_PREFIX_INVENTORY)), last_active_(0), location_(0), parser_id_(0), score_(0), spawn_room_(0), sql_id_(0), stance_(CombatStance::BALANCED)
 {
     hp_[0] = hp_[1] = HP_DEFAULT;
 }
 
+// Copy constructor, gives the copy its own Inventories rather than sharing them with the original. The copy is a new Mobile as far as the save file and the World are concerned, and gets its own unique ID when it's added to the World.
+Mobile::Mobile(const Mobile &other) : action_timer_(other.action_timer_), buff_types_(other.buff_types_), buffs_(other.buffs_), equipment_(Pool::make_shared<Inventory>(Inventory::PID_PREFIX_EQUIPMENT)), gear_version_(0), gender_(other.gender_), hostility_(other.hostility_), id_(0),
+    inventory_(Pool::make_shared<Inventory>(Inventory::PID_PREFIX_INVENTORY)), last_active_(other.last_active_), location_(other.location_), metadata_(other.metadata_), name_(other.name_), parser_id_(other.parser_id_), score_(other.score_),
+    spawn_room_(other.spawn_room_), species_(other.species_), sql_id_(0), stance_(other.stance_), tags_(other.tags_)
+{
+    hp_[0] = other.hp_[0];
+    hp_[1] = other.hp_[1];
+
+    // The original's events in the World's buff schedule belong to the original. The copy's buffs/debuffs are scheduled by set_id(), once it has an ID of its own.
+    for (auto &b : buffs_)
+        b.scheduled = 0;
+
+    for (size_t i = 0; i < other.equipment_->count(); i++)
+        equipment_->add_item(Pool::make_shared<Item>(*other.equipment_->get(i)));
+    for (size_t i = 0; i < other.inventory_->count(); i++)
+        inventory_->add_item(Pool::make_shared<Item>(*other.inventory_->get(i)));
+}
+
+// Checks how much action time this Mobile has built up.
+float Mobile::action_timer() const { return action_timer_; }
+
 // Adds a Mobile (or the player, with ID 0) to this Mobile's hostility list.
 void Mobile::add_hostility(uint32_t mob_id)
 {
@@ -55,8 +81,12 @@ void Mobile::add_hostility(uint32_t mob_id)
     hostility_.push_back(mob_id);
 }
 
-// Adds a second to this Mobile's action timer.
-void Mobile::add_second() { if (++action_timer_ > ACTION_TIMER_CAP_MAX) action_timer_ = ACTION_TIMER_CAP_MAX; }
+// Adds a second (or more) to this Mobile's action timer.
+void Mobile::add_second(uint32_t seconds)
+{
+    action_timer_ += seconds;
+    if (action_timer_ > ACTION_TIMER_CAP_MAX) action_timer_ = ACTION_TIMER_CAP_MAX;
+}
 
 // Adds to this Mobile's score.
 void Mobile::add_score(int score) { score_ += score; }
@@ -64,57 +94,28 @@ void Mobile::add_score(int score) { score_ += score; }
 // Returns the number of seconds needed for this Mobile to make an attack.
 float Mobile::attack_speed() const
 {
-    auto main_hand = equipment_->get(EquipSlot::HAND_MAIN);
-    auto off_hand = equipment_->get(EquipSlot::HAND_OFF);
-    const bool main_can_attack = (main_hand && main_hand->type() == ItemType::WEAPON);
-    const bool off_can_attack = (off_hand && off_hand->type() == ItemType::WEAPON);
-
-    // Attack speed is the slowest of the equipped weapons.
-    float speed = 0.0f;
-    if (main_can_attack) speed = main_hand->speed();
-    if (off_can_attack && off_hand->speed() > speed) speed = off_hand->speed();
-    if (!main_can_attack && !off_can_attack) speed = 1.0f;
-
-    if (!speed)
-    {
-        speed = 1.0f;
-        throw std::runtime_error("Cannot determine attack speed for " + name() + "!");
-    }
-
+    const float speed = gear_stats().attack_speed;
+    if (!speed) throw std::runtime_error("Cannot determine attack speed for " + name() + "!");
     return speed * Combat::BASE_ATTACK_SPEED_MULTIPLIER;
 }
 
 // Returns the modified chance to block for this Mobile, based on equipped gear.
-float Mobile::block_mod() const
-{
-    float mod_perc = 100.0f;
-    for (size_t i = 0; i < equipment_->count(); i++)
-        mod_perc += equipment_->get(i)->block_mod();
-    return mod_perc / 100.0f;
-}
-
-// Returns a pointer to a specified Buff.
-std::shared_ptr<Buff> Mobile::buff(Buff::Type type) const
-{
-    for (auto b : buffs_)
-        if (b->type == type) return b;
-    return nullptr;
-}
+float Mobile::block_mod() const { return gear_stats().block_mod; }
 
 // Returns the power level of the specified buff/debuff.
 uint32_t Mobile::buff_power(Buff::Type type) const
 {
-    auto b = buff(type);
-    if (b) return b->power;
-    else return 0;
+    if (!buff_types_.test(type)) return 0;
+    return buffs_[static_cast<size_t>(type)].power;
 }
 
 // Returns the time remaining for the specifieid buff/debuff.
 uint16_t Mobile::buff_time(Buff::Type type) const
 {
-    auto b = buff(type);
-    if (b) return b->time;
-    else return 0;
+    if (!buff_types_.test(type)) return 0;
+    const Buff &b = buffs_[static_cast<size_t>(type)];
+    if (b.expires == UINT32_MAX) return UINT16_MAX;
+    return b.expires - core()->world()->buff_ticks();
 }
 
 // Checks if this Mobile has enough action timer built up to perform an action.
@@ -126,25 +127,15 @@ uint32_t Mobile::carry_weight() const { return inventory_->weight() + equipment_
 // Clears a specified buff/debuff from the Actor, if it exists.
 void Mobile::clear_buff(Buff::Type type)
 {
-    for (size_t i = 0; i < buffs_.size(); i++)
-    {
-        if (buffs_.at(i)->type == type)
-        {
-            buffs_.erase(buffs_.begin() + i);
-            return;
-        }
-    }
+    buff_types_.clear(type);
+    buffs_[static_cast<size_t>(type)] = Buff();
 }
 
 // Clears a metatag from an Mobile. Use with caution!
 void Mobile::clear_meta(const std::string &key) { metadata_.erase(key); }
 
 // Clears a MobileTag from this Mobile.
-void Mobile::clear_tag(MobileTag the_tag)
-{
-    if (!(tags_.count(the_tag) > 0)) return;
-    tags_.erase(the_tag);
-}
+void Mobile::clear_tag(MobileTag the_tag) { tags_.clear(the_tag); }
 
 // Causes this mobile to die and leave a corpse behind.
 void Mobile::die(bool death_message)
@@ -182,27 +173,66 @@ void Mobile::die(bool death_message)
 }
 
 // Returns the modified chance to dodge for this Mobile, based on equipped gear.
-float Mobile::dodge_mod() const
-{
-    float mod_perc = 100.0f;
-    for (size_t i = 0; i < equipment_->count(); i++)
-        mod_perc += equipment_->get(i)->dodge_mod();
-    return mod_perc / 100.0f;
-}
+float Mobile::dodge_mod() const { return gear_stats().dodge_mod; }
 
 // Returns a pointer to the Movile's equipment.
 const std::shared_ptr<Inventory> Mobile::equ() const { return equipment_; }
 
+// Returns the stats derived from this Mobile's equipment, only recalculating them if the equipment has changed.
+const Mobile::GearStats& Mobile::gear_stats() const
+{
+    if (gear_version_ == equipment_->version()) return gear_stats_;
+    GearStats stats;
+    const auto main_hand = equipment_->get(EquipSlot::HAND_MAIN);
+    const auto off_hand = equipment_->get(EquipSlot::HAND_OFF);
+    Combat::wield_type_for_gear(main_hand, off_hand, &stats.wield_type, &stats.can_main_attack, &stats.can_off_attack);
+
+    // Attack speed is the slowest of the equipped weapons.
+    const bool main_weapon = (main_hand && main_hand->type() == ItemType::WEAPON);
+    const bool off_weapon = (off_hand && off_hand->type() == ItemType::WEAPON);
+    if (main_weapon) stats.attack_speed = main_hand->speed();
+    if (off_weapon && off_hand->speed() > stats.attack_speed) stats.attack_speed = off_hand->speed();
+    if (!main_weapon && !off_weapon) stats.attack_speed = 1.0f;
+
+    // The defensive modifiers and warmth are totals from everything equipped.
+    int block_perc = 100, dodge_perc = 100, parry_perc = 100;
+    for (size_t i = 0; i < equipment_->count(); i++)
+    {
+        const auto item = equipment_->get(i);
+        block_perc += item->block_mod();
+        dodge_perc += item->dodge_mod();
+        parry_perc += item->parry_mod();
+        stats.warmth += item->warmth();
+    }
+    stats.block_mod = block_perc / 100.0f;
+    stats.dodge_mod = dodge_perc / 100.0f;
+    stats.parry_mod = parry_perc / 100.0f;
+
+    // Body armour, outer armour and shields all count towards the weight of armour being worn.
+    const auto armour_type = [&stats](std::shared_ptr<Item> item) {
+        if (!item) return;
+        switch (item->subtype())
+        {
+            case ItemSub::HEAVY: stats.armour_heavy = true; break;
+            case ItemSub::LIGHT: stats.armour_light = true; break;
+            case ItemSub::MEDIUM: stats.armour_medium = true; break;
+            default: break;
+        }
+    };
+    armour_type(equipment_->get(EquipSlot::BODY));
+    armour_type(equipment_->get(EquipSlot::ARMOUR));
+    if (off_hand && off_hand->type() == ItemType::SHIELD) armour_type(off_hand);
+
+    gear_stats_ = stats;
+    gear_version_ = equipment_->version();
+    return gear_stats_;
+}
+
 // Retrieves the anatomy vector for this Mobile.
 const std::vector<std::shared_ptr<BodyPart>>& Mobile::get_anatomy() const { return core()->world()->get_anatomy(species_); }
 
 // Checks if this Actor has the specified buff/debuff active.
-bool Mobile::has_buff(Buff::Type type) const
-{
-    for (auto b : buffs_)
-        if (b->type == type) return true;
-    return false;
-}
+bool Mobile::has_buff(Buff::Type type) const { return buff_types_.test(type); }
 
 // Returns a gender string (he/she/it/they/etc.)
 std::string Mobile::he_she() const
@@ -257,46 +287,62 @@ bool Mobile::is_hostile() const
 // Returns true if this Mobile is a Player, false if not.
 bool Mobile::is_player() const { return false; }
 
+// Checks when this Mobile's AI was last processed.
+uint32_t Mobile::last_active() const { return last_active_; }
+
 // Loads a Mobile.
-uint32_t Mobile::load(std::shared_ptr<SQLite::Database> save_db, uint32_t sql_id)
+uint32_t Mobile::load(std::shared_ptr<SaveReader> reader, uint32_t sql_id)
 {
-    uint32_t inventory_id = 0, equipment_id = 0;
-    SQLite::Statement query(*save_db, "SELECT * FROM mobiles WHERE sql_id = :sql_id");
+    SQLite::Statement query(*reader->db(), "SELECT * FROM mobiles WHERE sql_id = :sql_id");
     query.bind(":sql_id", sql_id);
-    if (query.executeStep())
-    {
-        if (!query.isColumnNull("action_timer")) action_timer_ = query.getColumn("action_timer").getDouble();
-        if (!query.isColumnNull("equipment")) equipment_id = query.getColumn("equipment").getUInt();
-        if (!query.isColumnNull("gender")) gender_ = static_cast<Gender>(query.getColumn("gender").getInt());
-        if (!query.isColumnNull("hostility")) hostility_ = StrX::stoi_vec(StrX::string_explode(query.getColumn("hostility").getString(), " "));
-        hp_[0] = query.getColumn("hp").getInt();
-        hp_[1] = query.getColumn("hp_max").getInt();
-        id_ = query.getColumn("id").getUInt();
-        if (!query.isColumnNull("inventory")) inventory_id = query.getColumn("inventory").getUInt();
-        location_ = query.getColumn("location").getUInt();
-        if (!query.getColumn("metadata").isNull()) StrX::string_to_metadata(query.getColumn("metadata").getString(), metadata_);
-        if (!query.isColumnNull("name")) name_ = query.getColumn("name").getString();
-        if (!query.isColumnNull("parser_id")) parser_id_ = query.getColumn("parser_id").getInt();
-        if (!query.isColumnNull("score")) score_ = query.getColumn("score").getUInt();
-        if (!query.isColumnNull("spawn_room")) spawn_room_ = query.getColumn("spawn_room").getUInt();
-        species_ = query.getColumn("species").getString();
-        if (!query.isColumnNull("stance")) stance_ = static_cast<CombatStance>(query.getColumn("stance").getInt());
-        if (!query.isColumnNull("tags")) StrX::string_to_tags(query.getColumn("tags").getString(), tags_);
-    }
+    if (query.executeStep()) load_row(query, reader);
     else throw std::runtime_error("Could not load mobile data!");
 
-    if (inventory_id) inventory_->load(save_db, inventory_id);
-    if (equipment_id) equipment_->load(save_db, equipment_id);
-
     // Load any and all buffs/debuffs.
-    SQLite::Statement buff_query(*save_db, "SELECT * FROM buffs WHERE owner = :sql_id");
+    SQLite::Statement buff_query(*reader->db(), "SELECT * FROM buffs WHERE owner = :sql_id");
     buff_query.bind(":sql_id", sql_id);
     while (buff_query.executeStep())
-        buffs_.push_back(Buff::load(buff_query));
+        load_buff(buff_query);
 
     return sql_id;
 }
 
+// Loads a buff/debuff on this Mobile, from the current row of a query on the buffs table.
+void Mobile::load_buff(SQLite::Statement &query)
+{
+    const uint32_t power = (query.isColumnNull("power") ? 0 : query.getColumn("power").getUInt());
+    const uint16_t time = (query.isColumnNull("time") ? UINT16_MAX : query.getColumn("time").getUInt());
+    set_buff(static_cast<Buff::Type>(query.getColumn("type").getUInt()), time, power);
+}
+
+// Loads a Mobile and its inventory, from the current row of a query on the mobiles table. Buffs/debuffs are stored in a separate table, and aren't loaded here.
+void Mobile::load_row(SQLite::Statement &query, std::shared_ptr<SaveReader> reader)
+{
+    uint32_t inventory_id = 0, equipment_id = 0;
+    if (!query.isColumnNull("action_timer")) action_timer_ = query.getColumn("action_timer").getDouble();
+    if (!query.isColumnNull("equipment")) equipment_id = query.getColumn("equipment").getUInt();
+    if (!query.isColumnNull("gender")) gender_ = static_cast<Gender>(query.getColumn("gender").getInt());
+    if (!query.isColumnNull("hostility")) hostility_ = StrX::stoi_vec(StrX::string_explode(query.getColumn("hostility").getString(), " "));
+    hp_[0] = query.getColumn("hp").getInt();
+    hp_[1] = query.getColumn("hp_max").getInt();
+    id_ = query.getColumn("id").getUInt();
+    if (!query.isColumnNull("inventory")) inventory_id = query.getColumn("inventory").getUInt();
+    last_active_ = query.getColumn("last_active").getUInt();
+    location_ = query.getColumn("location").getUInt();
+    if (!query.getColumn("metadata").isNull()) StrX::string_to_metadata(query.getColumn("metadata").getString(), metadata_);
+    if (!query.isColumnNull("name")) name_ = query.getColumn("name").getString();
+    if (!query.isColumnNull("parser_id")) parser_id_ = query.getColumn("parser_id").getInt();
+    if (!query.isColumnNull("score")) score_ = query.getColumn("score").getUInt();
+    if (!query.isColumnNull("spawn_room")) spawn_room_ = query.getColumn("spawn_room").getUInt();
+    species_ = query.getColumn("species").getString();
+    sql_id_ = query.getColumn("sql_id").getUInt();
+    if (!query.isColumnNull("stance")) stance_ = static_cast<CombatStance>(query.getColumn("stance").getInt());
+    if (!query.isColumnNull("tags")) StrX::string_to_tags(query.getColumn("tags").getString(), tags_);
+
+    if (inventory_id) inventory_->load(reader, inventory_id);
+    if (equipment_id) equipment_->load(reader, equipment_id);
+}
+
 // Retrieves the location of this Mobile, in the form of a Room ID.
 uint32_t Mobile::location() const { return location_; }
 
@@ -406,17 +452,8 @@ std::string Mobile::name(int flags) const
     return ret;
 }
 
-// Generates a new parser ID for this Item.
-void Mobile::new_parser_id() { parser_id_ = core()->rng()->rnd(0, 999) + (1000 * Inventory::PID_PREFIX_MOBILE); }
-
 // Returns the modified chance to parry for this Mobile, based on equipped gear.
-float Mobile::parry_mod() const
-{
-    float mod_perc = 100.0f;
-    for (size_t i = 0; i < equipment_->count(); i++)
-        mod_perc += equipment_->get(i)->parry_mod();
-    return mod_perc / 100.0f;
-}
+float Mobile::parry_mod() const { return gear_stats().parry_mod; }
 
 // Retrieves the current ID of this Item, for parser differentiation.
 uint16_t Mobile::parser_id() const { return parser_id_; }
@@ -457,39 +494,60 @@ int Mobile::restore_hp(int amount)
 }
 
 // Saves this Mobile.
-uint32_t Mobile::save(std::shared_ptr<SQLite::Database> save_db)
-{
-    const uint32_t inventory_id = inventory_->save(save_db);
-    const uint32_t equipment_id = equipment_->save(save_db);
-
-    const uint32_t sql_id = core()->sql_unique_id();
-    SQLite::Statement query(*save_db, "INSERT INTO mobiles ( action_timer, equipment, gender, hostility, hp, hp_max, id, inventory, location, metadata, name, parser_id, score, spawn_room, species, sql_id, stance, tags ) VALUES ( :action_timer, :equipment, :gender, :hostility, :hp, :hp_max, :id, :inventory, :location, :metadata, :name, :parser_id, :score, :spawn_room, :species, :sql_id, :stance, :tags )");
-    if (action_timer_) query.bind(":action_timer", action_timer_);
-    if (equipment_id) query.bind(":equipment", equipment_id);
-    if (gender_ != Gender::IT) query.bind(":gender", static_cast<int>(gender_));
-    if (hostility_.size()) query.bind(":hostility", StrX::collapse_vector(hostility_));
-    query.bind(":hp", hp_[0]);
-    query.bind(":hp_max", hp_[1]);
-    query.bind(":id", id_);
-    if (inventory_id) query.bind(":inventory", inventory_id);
-    query.bind(":location", location_);
-    if (metadata_.size()) query.bind(":metadata", StrX::metadata_to_string(metadata_));
-    if (name_.size()) query.bind(":name", name_);
-    if (parser_id_) query.bind(":parser_id", parser_id_);
-    if (score_) query.bind(":score", score_);
-    if (spawn_room_) query.bind(":spawn_room", spawn_room_);
-    query.bind(":species", species_);
-    query.bind(":sql_id", sql_id);
-    if (stance_ != CombatStance::BALANCED) query.bind(":stance", static_cast<int>(stance_));
+uint32_t Mobile::save(std::shared_ptr<SaveWriter> writer)
+{
+    const uint32_t inventory_id = inventory_->save(writer);
+    const uint32_t equipment_id = equipment_->save(writer);
+
+    if (!sql_id_) sql_id_ = core()->sql_unique_id();
+    writer->upsert(SQL_MOBILES_INSERT, SQL_MOBILES_DELETE, sql_id_);
+    if (action_timer_) writer->bind(":action_timer", action_timer_);
+    if (equipment_id) writer->bind(":equipment", equipment_id);
+    if (gender_ != Gender::IT) writer->bind(":gender", static_cast<int>(gender_));
+    if (hostility_.size()) writer->bind(":hostility", StrX::collapse_vector(hostility_));
+    writer->bind(":hp", hp_[0]);
+    writer->bind(":hp_max", hp_[1]);
+    writer->bind(":id", id_);
+    if (inventory_id) writer->bind(":inventory", inventory_id);
+    writer->bind(":last_active", last_active_);
+    writer->bind(":location", location_);
+    if (metadata_.size()) writer->bind(":metadata", StrX::metadata_to_string(metadata_));
+    if (name_.size()) writer->bind(":name", name_);
+    if (parser_id_) writer->bind(":parser_id", parser_id_);
+    if (score_) writer->bind(":score", score_);
+    if (spawn_room_) writer->bind(":spawn_room", spawn_room_);
+    writer->bind(":species", species_);
+    writer->bind(":sql_id", sql_id_);
+    if (stance_ != CombatStance::BALANCED) writer->bind(":stance", static_cast<int>(stance_));
     const std::string tags = StrX::tags_to_string(tags_);
-    if (tags.size()) query.bind(":tags", tags);
-    query.exec();
+    if (tags.size()) writer->bind(":tags", tags);
+    writer->write();
 
     // Save any and all buffs/debuffs.
-    for (auto b : buffs_)
-        b->save(save_db, sql_id);
+    buff_types_.for_each([this, &writer](Buff::Type type) { buffs_[static_cast<size_t>(type)].save(writer, sql_id_, type, buff_time(type)); });
 
-    return sql_id;
+    return sql_id_;
+}
+
+// Adds the next event for a buff/debuff to the World's buff schedule, once this Mobile has a unique ID.
+void Mobile::schedule_buff(Buff::Type type)
+{
+    Buff &b = buffs_[static_cast<size_t>(type)];
+    const auto world = core()->world();
+    uint32_t due = 0;
+
+    // Bleed and poison do something every tick, but other buffs/debuffs don't need looking at again until they run out.
+    if (b.expires != UINT32_MAX)
+    {
+        if (type == Buff::Type::BLEED || type == Buff::Type::POISON) due = world->buff_ticks() + 1;
+        else due = b.expires;
+    }
+    if (due == b.scheduled) return;
+
+    // Events in the schedule are found by the Mobile's unique ID, with 0 meaning the player, so a Mobile that hasn't been given an ID yet has to wait until set_id() is called.
+    if (!id_ && !is_player()) return;
+    b.scheduled = due;
+    if (due) world->schedule_buff(id_, type, due);
 }
 
 // Checks this Mobile's score.
@@ -498,25 +556,27 @@ uint32_t Mobile::score() const { return score_; }
 // Sets a specified buff/debuff on the Actor, or extends an existing buff/debuff.
 void Mobile::set_buff(Buff::Type type, uint16_t time, uint32_t power, bool additive_power, bool additive_time)
 {
-    for (auto b : buffs_)
+    Buff &b = buffs_[static_cast<size_t>(type)];
+    if (buff_types_.test(type))
     {
-        if (b->type == type)
+        if (time != UINT16_MAX)
         {
-            if (time != UINT16_MAX)
-            {
-                if (additive_time) b->time += time;
-                else if (b->time < time) b->time = time;
-            }
-            if (additive_power) b->power += power;
-            else if (b->power < power) b->power = power;
-            return;
+            uint16_t new_time = buff_time(type);
+            if (additive_time) new_time += time;
+            else if (new_time < time) new_time = time;
+            time = new_time;
         }
+        else time = buff_time(type);
+        if (additive_power) b.power += power;
+        else if (b.power < power) b.power = power;
+    }
+    else
+    {
+        buff_types_.set(type);
+        b.power = power;
     }
-    auto new_buff = std::make_shared<Buff>();
-    new_buff->type = type;
-    new_buff->time = time;
-    new_buff->power = power;
-    buffs_.push_back(new_buff);
+    b.expires = (time == UINT16_MAX ? UINT32_MAX : core()->world()->buff_ticks() + time);
+    schedule_buff(type);
 }
 
 // Sets the gender of this Mobile.
@@ -529,14 +589,23 @@ void Mobile::set_hp(int hp, int hp_max)
     if (hp_max) hp_[1] = hp_max;
 }
 
-// Sets this Mobile's unique ID.
-void Mobile::set_id(uint32_t new_id) { id_ = new_id; }
+// Sets this Mobile's unique ID, and schedules any buffs/debuffs which were waiting for it.
+void Mobile::set_id(uint32_t new_id)
+{
+    id_ = new_id;
+    buff_types_.for_each([this](Buff::Type type) { schedule_buff(type); });
+}
+
+// Records when this Mobile's AI was last processed.
+void Mobile::set_last_active(uint32_t time) { last_active_ = time; }
 
 // Sets the location of this Mobile with a Room ID.
 void Mobile::set_location(uint32_t rooid_)
 {
+    const uint32_t old_location = location_;
     location_ = rooid_;
     if (is_player()) core()->world()->recalc_active_rooms();
+    else if (id_) core()->world()->mob_moved(id_, old_location, location_);
 }
 
 // As above, but with a string Room ID.
@@ -563,6 +632,9 @@ void Mobile::set_meta(const std::string &key, float value) { set_meta(key, StrX:
 // As above, but with an unsigned 32-bit integer.
 void Mobile::set_meta_uint(const std::string &key, uint32_t value) { set_meta(key, std::to_string(value)); }
 
+// Sets this Mobile's parser ID.
+void Mobile::set_parser_id(uint16_t id) { parser_id_ = id; }
+
 // Sets the name of this Mobile.
 void Mobile::set_name(const std::string &name) { name_ = name; }
 
@@ -576,11 +648,10 @@ void Mobile::set_species(const std::string &species) { species_ = species; }
 void Mobile::set_stance(CombatStance stance) { stance_ = stance; }
 
 // Sets a MobileTag on this Mobile.
-void Mobile::set_tag(MobileTag the_tag)
-{
-    if (tags_.count(the_tag) > 0) return;
-    tags_.insert(the_tag);
-}
+void Mobile::set_tag(MobileTag the_tag) { tags_.set(the_tag); }
+
+// Checks this Mobile's spawn room.
+uint32_t Mobile::spawn_room() const { return spawn_room_; }
 
 // Checks the species of this Mobile.
 std::string Mobile::species() const { return species_; }
@@ -589,7 +660,10 @@ std::string Mobile::species() const { return species_; }
 CombatStance Mobile::stance() const { return stance_; }
 
 // Checks if a MobileTag is set on this Mobile.
-bool Mobile::tag(MobileTag the_tag) const { return (tags_.count(the_tag) > 0); }
+bool Mobile::tag(MobileTag the_tag) const { return tags_.test(the_tag); }
+
+// Checks if any of the MobileTags in a mask are set on this Mobile.
+bool Mobile::tag_any(const MobileTags &mask) const { return tags_.any(mask); }
 
 // Triggers a single bleed tick.
 bool Mobile::tick_bleed(uint32_t power, uint16_t time)
@@ -618,45 +692,46 @@ bool Mobile::tick_bleed(uint32_t power, uint16_t time)
     return !fatal;
 }
 
-// Reduce the timer on all buffs.
-void Mobile::tick_buffs()
+// Processes an event from the World's buff schedule, if it hasn't gone stale.
+void Mobile::tick_buff(Buff::Type type, uint32_t due)
 {
-    for (size_t i = 0; i < buffs_.size(); i++)
-    {
-        if (buffs_.at(i)->time == UINT16_MAX) continue;
-        const auto type = buffs_.at(i)->type;
+    Buff &b = buffs_[static_cast<size_t>(type)];
+    if (!buff_types_.test(type) || b.scheduled != due) return;
+    b.scheduled = 0;
+    const uint32_t now = core()->world()->buff_ticks();
+    const uint16_t time = b.expires - now + 1;  // The time remaining on this buff/debuff before this tick.
 
-        switch (type)
-        {
-            case Buff::Type::BLEED:
-                if (!tick_bleed(buffs_.at(i)->power, buffs_.at(i)->time)) return;
-                break;
-            case Buff::Type::POISON:
-                if (!tick_poison(buffs_.at(i)->power, buffs_.at(i)->time)) return;
-                break;
-            default: break;
-        }
+    switch (type)
+    {
+        case Buff::Type::BLEED:
+            if (!tick_bleed(b.power, time)) return;
+            break;
+        case Buff::Type::POISON:
+            if (!tick_poison(b.power, time)) return;
+            break;
+        default: break;
+    }
 
-        if (buffs_.at(i)->time == 1)
-        {
-            switch (type)
-            {
-                case Buff::Type::CD_CAREFUL_AIM: core()->message("{m}The {M}CarefulAim {m}ability is ready to use again."); break;
-                case Buff::Type::CD_EYE_FOR_AN_EYE: core()->message("{m}The {M}EyeForAnEye {m}ability is ready to use again."); break;
-                case Buff::Type::CD_GRIT: core()->message("{m}The {M}Grit {m}ability is ready to use again."); break;
-                case Buff::Type::CD_HEADLONG_STRIKE: core()->message("{m}The {M}HeadlongStrike {m}ability is ready to use again."); break;
-                case Buff::Type::CD_LADY_LUCK: core()->message("{m}The {M}LadyLuck {m}ability is ready to use again."); break;
-                case Buff::Type::CD_QUICK_ROLL: core()->message("{m}The {M}QuickRoll {m}ability is ready to use again."); break;
-                case Buff::Type::CD_RAPID_STRIKE: core()->message("{m}The {M}RapidStrike {m}ability is ready to use again."); break;
-                case Buff::Type::CD_SHIELD_WALL: core()->message("{m}The {M}ShieldWall {m}ability is ready to use again."); break;
-                case Buff::Type::CD_SNAP_SHOT: core()->message("{m}The {M}SnapShot {m}ability is ready to use again."); break;
-                default: break;
-            }
-        }
+    if (b.expires > now)
+    {
+        schedule_buff(type);
+        return;
+    }
 
-        if (!--buffs_.at(i)->time)
-            buffs_.erase(buffs_.begin() + i--);
+    switch (type)
+    {
+        case Buff::Type::CD_CAREFUL_AIM: core()->message("{m}The {M}CarefulAim {m}ability is ready to use again."); break;
+        case Buff::Type::CD_EYE_FOR_AN_EYE: core()->message("{m}The {M}EyeForAnEye {m}ability is ready to use again."); break;
+        case Buff::Type::CD_GRIT: core()->message("{m}The {M}Grit {m}ability is ready to use again."); break;
+        case Buff::Type::CD_HEADLONG_STRIKE: core()->message("{m}The {M}HeadlongStrike {m}ability is ready to use again."); break;
+        case Buff::Type::CD_LADY_LUCK: core()->message("{m}The {M}LadyLuck {m}ability is ready to use again."); break;
+        case Buff::Type::CD_QUICK_ROLL: core()->message("{m}The {M}QuickRoll {m}ability is ready to use again."); break;
+        case Buff::Type::CD_RAPID_STRIKE: core()->message("{m}The {M}RapidStrike {m}ability is ready to use again."); break;
+        case Buff::Type::CD_SHIELD_WALL: core()->message("{m}The {M}ShieldWall {m}ability is ready to use again."); break;
+        case Buff::Type::CD_SNAP_SHOT: core()->message("{m}The {M}SnapShot {m}ability is ready to use again."); break;
+        default: break;
     }
+    clear_buff(type);
 }
 
 // Regenerates HP over time.
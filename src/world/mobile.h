@@ -4,12 +4,13 @@
 #ifndef GREAVE_WORLD_MOBILE_H_
 #define GREAVE_WORLD_MOBILE_H_
 
+#include "core/tag-set.h"
 #include "world/inventory.h"
 
+#include <array>
 #include <cstdint>
 #include <map>
 #include <memory>
-#include <set>
 #include <string>
 #include <vector>
 
@@ -18,6 +19,8 @@ enum class Gender : uint8_t { FEMALE, MALE, IT, THEY };
 
 enum class CombatStance : uint8_t { BALANCED, AGGRESSIVE, DEFENSIVE };
 
+enum class WieldType : uint8_t { NONE, UNARMED, ONE_HAND_PLUS_EXTRA, TWO_HAND, DUAL_WIELD, HAND_AND_A_HALF_2H, SINGLE_WIELD, ONE_HAND_PLUS_SHIELD, SHIELD_ONLY, UNARMED_PLUS_SHIELD };
+
 enum class MobileTag : uint16_t { None = 0,
 
     // Tags that affect the Mobile's name.
@@ -63,8 +66,12 @@ enum class MobileTag : uint16_t { None = 0,
     Success_Grit,       // The mobile successfully absorbed damage with the Grit ability.
     Success_QuickRoll,  // The mobile successfully used QuickRoll to give a bonus to dodging an attack.
     Success_ShieldWall, // The mobile successfully used ShieldWall to give a bonus to blocking an attack.
+
+    _End                // Do not use this tag, it's just a marker for the number of tags above.
 };
 
+typedef TagSet<MobileTag, static_cast<size_t>(MobileTag::_End)> MobileTags; // A set of MobileTags, or a mask of them.
+
 struct BodyPart
 {
     uint8_t     hit_chance; // The hit chance for this body part.
@@ -74,18 +81,21 @@ struct BodyPart
 
 struct Buff
 {
-    enum class Type : uint8_t { NONE, BLEED, CAREFUL_AIM, CD_CAREFUL_AIM, CD_EYE_FOR_AN_EYE, CD_GRIT, CD_HEADLONG_STRIKE, CD_LADY_LUCK, CD_QUICK_ROLL, CD_RAPID_STRIKE, CD_SHIELD_WALL, CD_SNAP_SHOT, EYE_FOR_AN_EYE, GRIT, POISON, QUICK_ROLL, RECENT_DAMAGE, RECENTLY_FLED, SHIELD_WALL };
+    enum class Type : uint8_t { NONE, BLEED, CAREFUL_AIM, CD_CAREFUL_AIM, CD_EYE_FOR_AN_EYE, CD_GRIT, CD_HEADLONG_STRIKE, CD_LADY_LUCK, CD_QUICK_ROLL, CD_RAPID_STRIKE, CD_SHIELD_WALL, CD_SNAP_SHOT, EYE_FOR_AN_EYE, GRIT, POISON, QUICK_ROLL, RECENT_DAMAGE, RECENTLY_FLED, SHIELD_WALL, _END };
 
     static const char SQL_BUFFS[];  // The SQL table construction string for the buffs table.
+    static const char SQL_BUFFS_DELETE[];   // The SQL statement for deleting a row from the buffs table.
+    static const char SQL_BUFFS_INSERT[];   // The SQL statement for saving a row in the buffs table.
 
-    static std::shared_ptr<Buff>    load(SQLite::Statement &query); // Loads this Buff from a save file.
-    void    save(std::shared_ptr<SQLite::Database> save_db, uint32_t owner_id); // Saves this Buff to a save file.
+    void    save(std::shared_ptr<SaveWriter> writer, uint32_t owner_id, Type type, uint16_t time) const; // Saves this Buff to a save file.
 
+    uint32_t    expires = UINT32_MAX;   // The buff tick (see World::buff_ticks()) on which this buff/debuff runs out, or UINT32_MAX for effects that expire on special circumstances.
     uint32_t    power = 0;              // The power level of this buff/debuff.
-    uint16_t    time = UINT16_MAX;      // The time remaining on this buff/debuff, or UINT16_MAX for effects that expire on special circumstances.
-    Type        type = Type::NONE;      // The type of buff/debuff.
+    uint32_t    scheduled = 0;          // The buff tick of this buff/debuff's next event in the World's buff schedule, or 0 if it has none. Any other events for it in the schedule are stale.
 };
 
+typedef TagSet<Buff::Type, static_cast<size_t>(Buff::Type::_END)> BuffTypes;
+
 
 class Mobile
 {
@@ -99,10 +109,29 @@ public:
     static constexpr int    NAME_FLAG_POSSESSIVE =          (1 << 5);   // Change the mobile's name to a possessive noun (e.g. goblin -> goblin's).
     static constexpr int    NAME_FLAG_THE =                 (1 << 6);   // Precede the mobile's name with 'the', unless the name is a proper noun.
     static const char       SQL_MOBILES[];                              // The SQL table construction string for the mobiles table.
+    static const char       SQL_MOBILES_DELETE[];                       // The SQL statement for deleting a row from the mobiles table.
+    static const char       SQL_MOBILES_INSERT[];                       // The SQL statement for saving a row in the mobiles table.
+
+    struct GearStats
+    {
+        bool        armour_heavy = false;       // Is this Mobile wearing any heavy armour (including a heavy shield)?
+        bool        armour_light = false;       // Is this Mobile wearing any light armour (including a light shield)?
+        bool        armour_medium = false;      // Is this Mobile wearing any medium armour (including a medium shield)?
+        float       attack_speed = 0;           // The speed of the slowest equipped weapon (before Combat::BASE_ATTACK_SPEED_MULTIPLIER), or 0 if it couldn't be determined.
+        float       block_mod = 1.0f;           // The multiplier to the chance to block from all equipped gear.
+        bool        can_main_attack = false;    // Can this Mobile attack with its main hand?
+        bool        can_off_attack = false;     // Can this Mobile attack with its off hand?
+        float       dodge_mod = 1.0f;           // The multiplier to the chance to dodge from all equipped gear.
+        float       parry_mod = 1.0f;           // The multiplier to the chance to parry from all equipped gear.
+        int         warmth = 0;                 // The total warmth rating of all equipped gear.
+        WieldType   wield_type = WieldType::NONE;   // How this Mobile is wielding its weapons.
+    };
 
                         Mobile();                                   // Constructor, sets default values.
+                        Mobile(const Mobile &other);                // Copy constructor, gives the copy its own Inventories rather than sharing them with the original. The copy is a new Mobile as far as the save file and the World are concerned, and gets its own unique ID when it's added to the World.
+    float               action_timer() const;                       // Checks how much action time this Mobile has built up.
     void                add_hostility(uint32_t mob_id);             // Adds a Mobile (or the player, with ID 0) to this Mobile's hostility list.
-    void                add_second();                               // Adds a second to this Mobile's action timer.
+    void                add_second(uint32_t seconds = 1);           // Adds a second (or more) to this Mobile's action timer.
     void                add_score(int score);                       // Adds to this Mobile's score.
     float               attack_speed() const;                       // Returns the number of seconds needed for this Mobile to make an attack.
     float               block_mod() const;                          // Returns the modified chance to block for this Mobile, based on equipped gear.
@@ -116,6 +145,7 @@ public:
     void                die(bool death_message = true);             // Causes this mobile to die and leave a corpse behind.
     float               dodge_mod() const;                          // Returns the modified chance to dodge for this Mobile, based on equipped gear.
     const std::shared_ptr<Inventory>    equ() const;                // Returns a pointer to the Movile's equipment.
+    const GearStats&    gear_stats() const;                         // Returns the stats derived from this Mobile's equipment, only recalculating them if the equipment has changed.
     const std::vector<std::shared_ptr<BodyPart>>& get_anatomy() const;  // Retrieves the anatomy vector for this Mobile.
     bool                has_buff(Buff::Type type) const;            // Checks if this Actor has the specified buff/debuff active.
     std::string         he_she() const;                             // Returns a gender string (he/she/it/they/etc.)
@@ -127,7 +157,10 @@ public:
     virtual bool        is_dead() const;                            // Checks if this Mobile is dead.
     bool                is_hostile() const;                         // Is this Mobile hostile to the player?
     virtual bool        is_player() const;                          // Returns true if this Mobile is a Player, false if not.
-    virtual uint32_t    load(std::shared_ptr<SQLite::Database> save_db, uint32_t sql_id);   // Loads a Mobile.
+    uint32_t            last_active() const;                        // Checks when this Mobile's AI was last processed.
+    virtual uint32_t    load(std::shared_ptr<SaveReader> reader, uint32_t sql_id);   // Loads a Mobile.
+    void                load_buff(SQLite::Statement &query);        // Loads a buff/debuff on this Mobile, from the current row of a query on the buffs table.
+    void                load_row(SQLite::Statement &query, std::shared_ptr<SaveReader> reader);  // Loads a Mobile and its inventory, from the current row of a query on the mobiles table.
     uint32_t            location() const;                           // Retrieves the location of this Mobile, in the form of a Room ID.
     virtual uint32_t    max_carry() const;                          // The maximum weight this mobile can carry.
     std::string         meta(const std::string &key) const;         // Retrieves Mobile metadata.
@@ -136,19 +169,19 @@ public:
     uint32_t            meta_uint(const std::string &key) const;    // Retrieves metadata, in unsigned 32-bit integer format.
     std::map<std::string, std::string>* meta_raw();                 // Accesses the metadata map directly. Use with caution!
     std::string         name(int flags = 0) const;                  // Retrieves the name of this Mobile.
-    void                new_parser_id();                            // Generates a new parser ID for this Mobile.
     float               parry_mod() const;                          // Returns the modified chance to parry for this Mobile, based on equipped gear.
     uint16_t            parser_id() const;                          // Retrieves the current ID of this Mobile, for parser differentiation.
     bool                pass_time(float seconds = 0.0f, bool interruptable = true); // Causes time to pass for this Mobile.
     virtual void        reduce_hp(int amount, bool death_message = true);   // Reduces this Mobile's hit points.
     int                 restore_hp(int amount);                     // Restores a specified amount of hit points.
-    virtual uint32_t    save(std::shared_ptr<SQLite::Database> save_db);    // Saves this Mobile.
+    virtual uint32_t    save(std::shared_ptr<SaveWriter> writer);   // Saves this Mobile.
                         // Sets a specified buff/debuff on the Actor, or extends an existing buff/debuff.
     uint32_t            score() const;                              // Checks this Mobile's score.
     void                set_buff(Buff::Type type, uint16_t time = UINT16_MAX, uint32_t power = 0, bool additive_power = false, bool additive_time = true);  // Sets a specified buff/debuff on the Actor, or extends an existing buff/debuff.
     void                set_gender(Gender gender);                  // Sets the gender of this Mobile.
     void                set_hp(int hp, int hp_max = 0);             // Sets the current (and, optionally, maximum) HP of this Mobile.
-    void                set_id(uint32_t new_id);                    // Sets this Mobile's unique ID.
+    void                set_id(uint32_t new_id);                    // Sets this Mobile's unique ID, and schedules any buffs/debuffs which were waiting for it.
+    void                set_last_active(uint32_t time);             // Records when this Mobile's AI was last processed.
     void                set_location(uint32_t room_id);             // Sets the location of this Mobile with a Room ID.
     void                set_location(const std::string &room_id);   // As above, but with a string Room ID.
     void                set_meta(const std::string &key, std::string value);    // Adds Item metadata.
@@ -156,15 +189,18 @@ public:
     void                set_meta(const std::string &key, float value);          // As above again, but this time for floats.
     void                set_meta_uint(const std::string &key, uint32_t value);  // As above, but with an unsigned 32-bit integer.
     void                set_name(const std::string &name);          // Sets the name of this Mobile.
+    void                set_parser_id(uint16_t id);                 // Sets this Mobile's parser ID.
     void                set_spawn_room(uint32_t id);                // Sets this Mobile's spawn room.
     void                set_species(const std::string &species);    // Sets the species of this Mobile.
     void                set_stance(CombatStance stance);            // Sets this Mobile's combat stance.
     void                set_tag(MobileTag the_tag);                 // Sets a MobileTag on this Mobile.
+    uint32_t            spawn_room() const;                         // Checks this Mobile's spawn room.
     std::string         species() const;                            // Checks the species of this Mobile.
     CombatStance        stance() const;                             // Checks this Mobile's combat stance.
     bool                tag(MobileTag the_tag) const;               // Checks if a MobileTag is set on this Mobile.
+    bool                tag_any(const MobileTags &mask) const;      // Checks if any of the MobileTags in a mask are set on this Mobile.
     bool                tick_bleed(uint32_t power, uint16_t time);  // Triggers a single bleed tick.
-    void                tick_buffs();                               // Reduce the timer on all buffs.
+    void                tick_buff(Buff::Type type, uint32_t due);   // Processes an event from the World's buff schedule, if it hasn't gone stale.
     virtual void        tick_hp_regen();                            // Regenerates HP over time.
     bool                tick_poison(uint32_t power, uint16_t time); // Triggers a single poison tick.
     bool                using_melee() const;                        // Checks if a mobile is using at least one melee weapon.
@@ -178,16 +214,20 @@ protected:
     static constexpr int    HP_DEFAULT =                            100;    // The default HP value for mobiles.
     static constexpr int    SCAR_BLEED_INTENSITY_FROM_BLEED_TICK =  1;      // Blood type scar intensity caused by each tick of the player or an NPC bleeding.
 
-    std::shared_ptr<Buff>   buff(Buff::Type type) const;    // Returns a pointer to a specified Buff.
+    void    schedule_buff(Buff::Type type); // Adds the next event for a buff/debuff to the World's buff schedule, once this Mobile has a unique ID.
 
     float                               action_timer_;  // 'Charges up' with time, to allow NPCs to perform timed actions.
-    std::vector<std::shared_ptr<Buff>>  buffs_;         // Any and all buffs or debuffs on this Mobile.
+    BuffTypes                           buff_types_;    // The types of buff/debuff currently active on this Mobile.
+    std::array<Buff, static_cast<size_t>(Buff::Type::_END)> buffs_; // The buffs/debuffs on this Mobile, indexed by type. Only those in buff_types_ are active.
     std::shared_ptr<Inventory>          equipment_;     // The Items currently worn or wielded by this Mobile.
+    mutable GearStats                   gear_stats_;    // The stats derived from this Mobile's equipment, cached by gear_stats().
+    mutable uint32_t                    gear_version_;  // The equipment Inventory's version() when gear_stats_ was last calculated, or 0 if it never has been.
     Gender                              gender_;        // The gender of this Mobile.
     std::vector<uint32_t>               hostility_;     // The hostility vector keeps track of who this Mobile is angry with.
     int                                 hp_[2];         // The current and maxmum hit points of this Mobile.
     uint32_t                            id_;            // The Mobile's unique ID.
     std::shared_ptr<Inventory>          inventory_;     // The Items being carried by this Mobile.
+    uint32_t                            last_active_;   // The time_passed() value when this Mobile's AI was last processed. Mobiles outside of active rooms lie dormant until they're caught up.
     uint32_t                            location_;      // The Room that this Mobile is currently located in.
     std::map<std::string, std::string>  metadata_;      // The Mobile's metadata, if any.
     std::string                         name_;          // The name of this Mobile.
@@ -195,8 +235,9 @@ protected:
     uint32_t                            score_;         // Either the score value for killing this Mobile; or, for the Player, their current total score.
     uint32_t                            spawn_room_;    // The Room that spawned this Mobile.
     std::string                         species_;       // Ths species type of this Mobile.
+    uint32_t                            sql_id_;        // This Mobile's unique ID in the save file, which stays the same from one save to the next. 0 if it hasn't been saved yet.
     CombatStance                        stance_;        // The Mobile's current combat stance.
-    std::set<MobileTag>                 tags_;          // Any and all tags on this Mobile.
+    MobileTags                          tags_;          // Any and all tags on this Mobile.
 };
 
 #endif  // GREAVE_WORLD_MOBILE_H_
@@ -9,10 +9,16 @@
 
 
 // The SQL table construction string for the player data.
-constexpr char Player::SQL_PLAYER[] = "CREATE TABLE player ( blood_tox INTEGER, hunger INTEGER NOT NULL, mob_target INTEGER, money INTEGER NOT NULL, mp INTEGER NOT NULL, mp_max INTEGER NOT NULL, sp INTEGER NOT NULL, sp_max INTEGER NOT NULL, sql_id INTEGER PRIMARY KEY UNIQUE NOT NULL, thirst INTEGET NOT NULL )";
+constexpr char Player::SQL_PLAYER[] = "CREATE TABLE IF NOT EXISTS player ( blood_tox INTEGER, hunger INTEGER NOT NULL, mob_target INTEGER, money INTEGER NOT NULL, mp INTEGER NOT NULL, mp_max INTEGER NOT NULL, sp INTEGER NOT NULL, sp_max INTEGER NOT NULL, sql_id INTEGER PRIMARY KEY UNIQUE NOT NULL, thirst INTEGET NOT NULL )";
+
+// The SQL statement for saving the player data.
+constexpr char Player::SQL_PLAYER_INSERT[] = "INSERT INTO player ( blood_tox, hunger, mob_target, money, mp, mp_max, sp, sp_max, sql_id, thirst ) VALUES ( :blood_tox, :hunger, :mob_target, :money, :mp, :mp_max, :sp, :sp_max, :sql_id, :thirst )";
 
 // The SQL table construction string for the player skills data.
-constexpr char Player::SQL_SKILLS[] = "CREATE TABLE skills ( id TEXT PRIMARY KEY UNIQUE NOT NULL, level INTEGER NOT NULL, xp REAL )";
+constexpr char Player::SQL_SKILLS[] = "CREATE TABLE IF NOT EXISTS skills ( id TEXT PRIMARY KEY UNIQUE NOT NULL, level INTEGER NOT NULL, xp REAL )";
+
+// The SQL statement for saving a player skill.
+constexpr char Player::SQL_SKILLS_INSERT[] = "INSERT INTO skills ( id, level, xp ) VALUES ( :id, :level, :xp )";
 
 
 // Constructor, sets default values.
@@ -50,13 +56,7 @@ void Player::add_water(int power)
 int Player::blood_tox() const { return blood_tox_; }
 
 // Gets the clothing warmth level from the Player.
-int Player::clothes_warmth() const
-{
-    int warmth = 0;
-    for (size_t i = 0; i < equipment_->count(); i++)
-        warmth += equipment_->get(i)->warmth();
-    return warmth;
-}
+int Player::clothes_warmth() const { return gear_stats().warmth; }
 
 // Retrieves the player's death reason.
 std::string Player::death_reason() const { return death_reason_; }
@@ -158,9 +158,9 @@ bool Player::is_dead() const
 bool Player::is_player() const { return true; }
 
 // Loads the Player data.
-uint32_t Player::load(std::shared_ptr<SQLite::Database> save_db, uint32_t sql_id)
+uint32_t Player::load(std::shared_ptr<SaveReader> reader, uint32_t sql_id)
 {
-    SQLite::Statement query(*save_db, "SELECT * FROM player");
+    SQLite::Statement query(*reader->db(), "SELECT * FROM player");
     if (query.executeStep())
     {
         if (!query.isColumnNull("blood_tox")) blood_tox_ = query.getColumn("blood_tox").getInt();
@@ -176,7 +176,7 @@ uint32_t Player::load(std::shared_ptr<SQLite::Database> save_db, uint32_t sql_id
     }
     else throw std::runtime_error("Could not load player data!");
 
-    SQLite::Statement skill_query(*save_db, "SELECT * FROM skills");
+    SQLite::Statement skill_query(*reader->db(), "SELECT * FROM skills");
     while (skill_query.executeStep())
     {
         const std::string skill_id = skill_query.getColumn("id").getString();
@@ -184,7 +184,7 @@ uint32_t Player::load(std::shared_ptr<SQLite::Database> save_db, uint32_t sql_id
         if (!skill_query.isColumnNull("xp")) skill_xp_.insert(std::make_pair(skill_id, skill_query.getColumn("xp").getDouble()));
     }
 
-    return Mobile::load(save_db, sql_id);
+    return Mobile::load(reader, sql_id);
 }
 
 // The maximum weight the player can carry.
@@ -199,15 +199,8 @@ uint32_t Player::mob_target()
 {
     if (mob_target_)
     {
-        for (size_t i = 0; i < core()->world()->mob_count(); i++)
-        {
-            const auto mob = core()->world()->mob_vec(i);
-            if (mob->id() == mob_target_)
-            {
-                if (mob->location() == location_) return mob_target_;
-                else break;
-            }
-        }
+        const auto mob = core()->world()->mob_by_id(mob_target_);
+        if (mob && mob->location() == location_) return mob_target_;
         mob_target_ = 0;   // If we couldn't make a match, or the matched Mobile is no longer here, just clear the target.
     }
     return mob_target_;
@@ -288,30 +281,30 @@ void Player::restore_sp(int amount)
 }
 
 // Saves this Player.
-uint32_t Player::save(std::shared_ptr<SQLite::Database> save_db)
+uint32_t Player::save(std::shared_ptr<SaveWriter> writer)
 {
-    const uint32_t sql_id = Mobile::save(save_db);
-    SQLite::Statement query(*save_db, "INSERT INTO player ( blood_tox, hunger, mob_target, money, mp, mp_max, sp, sp_max, sql_id, thirst ) VALUES ( :blood_tox, :hunger, :mob_target, :money, :mp, :mp_max, :sp, :sp_max, :sql_id, :thirst )");
-    if (blood_tox_) query.bind(":blood_tox", blood_tox_);
-    query.bind(":hunger", hunger_);
-    if (mob_target_) query.bind(":mob_target", mob_target_);
-    query.bind(":money", money_);
-    query.bind(":mp", mp_[0]);
-    query.bind(":mp_max", mp_[1]);
-    query.bind(":sp", sp_[0]);
-    query.bind(":sp_max", sp_[1]);
-    query.bind(":sql_id", sql_id);
-    query.bind(":thirst", thirst_);
-    query.exec();
+    const uint32_t sql_id = Mobile::save(writer);
+    writer->insert(SQL_PLAYER_INSERT);
+    if (blood_tox_) writer->bind(":blood_tox", blood_tox_);
+    writer->bind(":hunger", hunger_);
+    if (mob_target_) writer->bind(":mob_target", mob_target_);
+    writer->bind(":money", money_);
+    writer->bind(":mp", mp_[0]);
+    writer->bind(":mp_max", mp_[1]);
+    writer->bind(":sp", sp_[0]);
+    writer->bind(":sp_max", sp_[1]);
+    writer->bind(":sql_id", sql_id);
+    writer->bind(":thirst", thirst_);
+    writer->write();
 
     for (const auto &kv : skill_levels_)
     {
-        SQLite::Statement skill_query(*save_db, "INSERT INTO skills ( id, level, xp ) VALUES ( :id, :level, :xp )");
-        skill_query.bind(":id", kv.first);
-        skill_query.bind(":level", kv.second);
+        writer->insert(SQL_SKILLS_INSERT);
+        writer->bind(":id", kv.first);
+        writer->bind(":level", kv.second);
         const auto it = skill_xp_.find(kv.first);
-        if (it != skill_xp_.end()) skill_query.bind(":xp", it->second);
-        skill_query.exec();
+        if (it != skill_xp_.end()) writer->bind(":xp", it->second);
+        writer->write();
     }
 
     return sql_id;
@@ -373,21 +366,21 @@ void Player::tick_hp_regen()
     Mobile::tick_hp_regen();
 }
 // Regenerates MP over time.
-void Player::tick_mp_regen() { restore_mp(MP_REGEN_PER_TICK); }
+void Player::tick_mp_regen(uint32_t ticks) { restore_mp(MP_REGEN_PER_TICK * static_cast<int>(ticks)); }
 
 // Regenerates SP over time.
-void Player::tick_sp_regen() { restore_sp(SP_REGEN_PER_TICK); }
+void Player::tick_sp_regen(uint32_t ticks) { restore_sp(SP_REGEN_PER_TICK * static_cast<int>(ticks)); }
 
 // Checks if the player is wearing a certain type of armour (light/medium/heavy).
 bool Player::wearing_armour(ItemSub type)
 {
-    if (type == ItemSub::NONE) return (!wearing_armour(ItemSub::HEAVY) && !wearing_armour(ItemSub::MEDIUM) && !wearing_armour(ItemSub::LIGHT));
-    const auto armour = equ()->get(EquipSlot::ARMOUR);
-    const auto body = equ()->get(EquipSlot::BODY);
-    const auto shield = equ()->get(EquipSlot::HAND_OFF);
-
-    if (body && body->subtype() == type) return true;
-    if (armour && armour->subtype() == type) return true;
-    if (shield && shield->type() == ItemType::SHIELD && shield->subtype() == type) return true;
-    return false;
+    const GearStats &gear = gear_stats();
+    switch (type)
+    {
+        case ItemSub::HEAVY: return gear.armour_heavy;
+        case ItemSub::LIGHT: return gear.armour_light;
+        case ItemSub::MEDIUM: return gear.armour_medium;
+        case ItemSub::NONE: return !gear.armour_heavy && !gear.armour_light && !gear.armour_medium;
+        default: return false;
+    }
 }
@@ -18,6 +18,8 @@ public:
     static constexpr int    BLOOD_TOX_WARNING = 4;  // The level at which the player is warned of increasing blood toxicity.
     static const char       SQL_PLAYER[];           // The SQL table construction string for the player data.
     static const char       SQL_SKILLS[];           // The SQL table construction string for the player skills data.
+    static const char       SQL_PLAYER_INSERT[];    // The SQL statement for saving the player data.
+    static const char       SQL_SKILLS_INSERT[];    // The SQL statement for saving a player skill.
 
                 Player();                           // Constructor, sets default values.
     void        add_food(int power);                // Eats food, increasing the hunger counter.
@@ -32,7 +34,7 @@ public:
     void        increase_tox(int power);            // Increases the player's blood toxicity.
     bool        is_dead() const override;           // Checks if this Player is dead.
     bool        is_player() const override;         // Returns true if this Mobile is a Player, false if not.
-    uint32_t    load(std::shared_ptr<SQLite::Database> save_db, uint32_t sql_id) override;  // Loads the Player data.
+    uint32_t    load(std::shared_ptr<SaveReader> reader, uint32_t sql_id) override;  // Loads the Player data.
     uint32_t    max_carry() const override;         // The maximum weight the player can carry.
     uint32_t    mob_target();                       // Retrieves the Mobile target if it's still valid, or sets it to 0 if not.
     uint32_t    money() const;                      // Check how much money we're carrying.
@@ -43,7 +45,7 @@ public:
     void        remove_money(uint32_t amount);      // Removes money from the player.
     void        restore_mp(int amount);             // Restores the player's mana points.
     void        restore_sp(int amount);             // Restores the player's stamina points.
-    uint32_t    save(std::shared_ptr<SQLite::Database> save_db) override;   // Saves this Player.
+    uint32_t    save(std::shared_ptr<SaveWriter> writer) override;   // Saves this Player.
     void        set_death_reason(const std::string &reason);    // Sets the reason for this Player dying.
     void        set_mob_target(uint32_t target);    // Sets a new Mobile target.
     int         skill_level(const std::string &skill_id) const; // Returns the skill level of a specified skill of this Player.
@@ -53,8 +55,8 @@ public:
     void        thirst_tick();                      // The player gets a little more thirsty.
     void        tick_blood_tox();                   // Reduces blood toxicity.
     void        tick_hp_regen() override;           // Regenerates HP over time.
-    void        tick_mp_regen();                    // Regenerates MP over time.
-    void        tick_sp_regen();                    // Regenerates SP over time.
+    void        tick_mp_regen(uint32_t ticks = 1);  // Regenerates MP over time.
+    void        tick_sp_regen(uint32_t ticks = 1);  // Regenerates SP over time.
     bool        wearing_armour(ItemSub type);       // Checks if the player is wearing a certain type of armour (light/medium/heavy).
 
 private:
@@ -0,0 +1,109 @@
+// world/room-graph.cc -- A compiled, index-based graph of the links between Rooms, for fast traversal and pathfinding.
+// Copyright (c) 2021 Raine "Gravecat" Simmons. Licensed under the GNU Affero General Public License v3 or any later version.
+
+#include "world/room-graph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+// The start of a Room's links, by graph index.
+const RoomGraph::Link* RoomGraph::begin(uint32_t index) const { return links_.data() + offsets_.at(index); }
+
+// Builds the graph from scratch, from all the Rooms in the game.
+void RoomGraph::compile(const std::map<uint32_t, std::shared_ptr<Room>> &room_pool)
+{
+    links_.clear();
+    offsets_.clear();
+    room_index_.clear();
+    rooms_.clear();
+
+    // Every Room gets an index first, so that links can refer to Rooms later in the list.
+    for (auto room : room_pool)
+    {
+        room_index_.insert(std::make_pair(room.first, rooms_.size()));
+        rooms_.push_back(room.second);
+    }
+
+    for (auto room : rooms_)
+    {
+        offsets_.push_back(links_.size());
+        for (int i = 0; i < Room::ROOM_LINKS_MAX; i++)
+        {
+            if (room->fake_link(i)) continue;   // Empty links, links to FALSE_ROOM, etc. aren't part of the graph at all.
+            const uint32_t target = index(room->link(i));
+            if (target == NO_ROOM) throw std::runtime_error("Invalid room link from " + std::to_string(room->id()) + " to " + std::to_string(room->link(i)));
+            links_.push_back({target, static_cast<Direction>(i), room->link_flags(i)});
+        }
+    }
+    offsets_.push_back(links_.size());
+}
+
+// The end of a Room's links, by graph index.
+const RoomGraph::Link* RoomGraph::end(uint32_t index) const { return links_.data() + offsets_.at(index + 1); }
+
+// Finds the shortest path between two Room IDs, avoiding any links with the specified flags. Returns an empty vector if there's no path.
+std::vector<Direction> RoomGraph::find_path(uint32_t from, uint32_t to, uint8_t avoid, size_t max_length) const
+{
+    // Rooms have no coordinates to guide an A* search, and every link counts as a single step, so a breadth-first search is the quickest way to the shortest path.
+    std::vector<Direction> path;
+    const uint32_t start = index(from), goal = index(to);
+    if (start == NO_ROOM || goal == NO_ROOM || start == goal) return path;
+
+    std::unordered_map<uint32_t, uint32_t> came_from;   // The link position used to reach each Room that's been visited, so the path can be traced back.
+    std::vector<uint32_t> frontier(1, start), next_frontier;
+    came_from.insert(std::make_pair(start, UINT32_MAX));
+    for (size_t length = 1; length <= max_length && frontier.size() && !came_from.count(goal); length++)
+    {
+        next_frontier.clear();
+        for (auto room : frontier)
+        {
+            for (auto link = begin(room); link != end(room); link++)
+            {
+                if (link->flags & avoid) continue;
+                if (!came_from.insert(std::make_pair(link->target, link - links_.data())).second) continue;
+                if (link->target == goal) break;
+                next_frontier.push_back(link->target);
+            }
+            if (came_from.count(goal)) break;
+        }
+        frontier.swap(next_frontier);
+    }
+    if (!came_from.count(goal)) return path;
+
+    for (uint32_t room = goal; room != start; )
+    {
+        const Link &link = links_.at(came_from.at(room));
+        path.push_back(link.dir);
+        room = static_cast<uint32_t>(std::upper_bound(offsets_.begin(), offsets_.end(), came_from.at(room)) - offsets_.begin() - 1);  // The Room that this link leads from.
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+// Converts a Room ID into a graph index, or NO_ROOM if it's not in the graph.
+uint32_t RoomGraph::index(uint32_t room_id) const
+{
+    const auto it = room_index_.find(room_id);
+    if (it == room_index_.end()) return NO_ROOM;
+    return it->second;
+}
+
+// Converts a graph index back into a Room ID.
+uint32_t RoomGraph::room_id(uint32_t index) const { return rooms_.at(index)->id(); }
+
+// The number of Rooms in the graph.
+size_t RoomGraph::size() const { return rooms_.size(); }
+
+// Updates the flags on a Room's link, after its tags have changed.
+void RoomGraph::update_link(uint32_t room_id, uint8_t dir)
+{
+    const uint32_t room = index(room_id);
+    if (room == NO_ROOM) return;
+    for (auto it = links_.begin() + offsets_.at(room); it != links_.begin() + offsets_.at(room + 1); ++it)
+    {
+        if (it->dir != static_cast<Direction>(dir)) continue;
+        it->flags = rooms_.at(room)->link_flags(dir);
+        return;
+    }
+}
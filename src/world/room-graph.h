@@ -0,0 +1,45 @@
+// world/room-graph.h -- A compiled, index-based graph of the links between Rooms, for fast traversal and pathfinding.
+// Copyright (c) 2021 Raine "Gravecat" Simmons. Licensed under the GNU Affero General Public License v3 or any later version.
+
+#ifndef GREAVE_WORLD_ROOM_GRAPH_H_
+#define GREAVE_WORLD_ROOM_GRAPH_H_
+
+#include "world/room.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+
+class RoomGraph
+{
+public:
+    struct Link
+    {
+        uint32_t    target; // The graph index of the Room this link leads to.
+        Direction   dir;    // The direction of this link.
+        uint8_t     flags;  // The Room::LinkFlags for this link.
+    };
+
+    static constexpr uint32_t   NO_ROOM =   UINT32_MAX; // Returned by index() for Room IDs that aren't in the graph.
+
+    const Link* begin(uint32_t index) const;    // The start of a Room's links, by graph index.
+    void        compile(const std::map<uint32_t, std::shared_ptr<Room>> &room_pool);   // Builds the graph from scratch, from all the Rooms in the game.
+    const Link* end(uint32_t index) const;      // The end of a Room's links, by graph index.
+    std::vector<Direction>  find_path(uint32_t from, uint32_t to, uint8_t avoid = Room::LINK_LOCKED, size_t max_length = SIZE_MAX) const;    // Finds the shortest path between two Room IDs, avoiding any links with the specified flags. Returns an empty vector if there's no path.
+    uint32_t    index(uint32_t room_id) const;  // Converts a Room ID into a graph index, or NO_ROOM if it's not in the graph.
+    uint32_t    room_id(uint32_t index) const;  // Converts a graph index back into a Room ID.
+    size_t      size() const;                   // The number of Rooms in the graph.
+    void        update_link(uint32_t room_id, uint8_t dir); // Updates the flags on a Room's link, after its tags have changed.
+
+private:
+    std::vector<Link>                       links_;         // Every link in the graph, grouped by the Room they lead from.
+    std::vector<uint32_t>                   offsets_;       // The position in links_ of each Room's first link. Has one extra entry on the end, marking the end of the last Room's links.
+    std::unordered_map<uint32_t, uint32_t>  room_index_;    // Lookup table for converting Room IDs into graph indexes.
+    std::vector<std::shared_ptr<Room>>      rooms_;         // The Rooms in the graph, by graph index.
+};
+
+#endif  // GREAVE_WORLD_ROOM_GRAPH_H_
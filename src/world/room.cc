@@ -1,7 +1,9 @@
 // world/room.cc -- The Room class, which defines a single area in the game world that the player can visit.
 // Copyright (c) 2020-2021 Raine "Gravecat" Simmons. Licensed under the GNU Affero General Public License v3 or any later version.
 
+#include "actions/ai.h"
 #include "core/core.h"
+#include "core/pool.h"
 #include "core/strx.h"
 #include "world/room.h"
 
@@ -54,20 +56,36 @@ const char* Room::ROOM_SCAR_DESCS[][4] = {
 };
 
 // The SQL table construction string for the saved rooms.
-const char Room::SQL_ROOMS[] = "CREATE TABLE rooms ( sql_id INTEGER PRIMARY KEY UNIQUE NOT NULL, id INTEGER UNIQUE NOT NULL, last_spawned_mobs INTEGER, metadata TEXT, scars TEXT, spawn_mobs TEXT, tags TEXT, link_tags TEXT, inventory INTEGER UNIQUE )";
+const char Room::SQL_ROOMS[] = "CREATE TABLE IF NOT EXISTS rooms ( sql_id INTEGER PRIMARY KEY UNIQUE NOT NULL, id INTEGER UNIQUE NOT NULL, last_spawned_mobs INTEGER, metadata TEXT, scars TEXT, spawn_mobs TEXT, tags TEXT, link_tags TEXT, inventory INTEGER UNIQUE )";
 
+// The SQL statement for deleting a room which no longer needs saving.
+const char Room::SQL_ROOMS_DELETE[] = "DELETE FROM rooms WHERE sql_id = ?";
 
-Room::Room(std::string new_id) : inventory_(std::make_shared<Inventory>(Inventory::PID_PREFIX_ROOM)), last_spawned_mobs_(0), light_(0), security_(Security::ANARCHY)
+// The SQL statement for saving a room.
+const char Room::SQL_ROOMS_INSERT[] = "INSERT OR REPLACE INTO rooms (id, inventory, last_spawned_mobs, link_tags, metadata, scars, spawn_mobs, sql_id, tags) VALUES ( :id, :inventory, :last_spawned_mobs, :link_tags, :metadata, :scars, :spawn_mobs, :sql_id, :tags )";
+
+
+Room::Room(std::string new_id) : inventory_(Pool::make_shared<Inventory>(Inventory::PID_PREFIX_ROOM)), last_spawned_mobs_(0), light_(0), security_(Security::ANARCHY)
 {
     if (new_id.size()) id_ = StrX::hash(new_id);
     else id_ = 0;
 
     for (int e = 0; e < ROOM_LINKS_MAX; e++)
+    {
+        link_flags_[e] = 0;
         links_[e] = 0;
+    }
 }
 
 // This Room was previously inactive, and has now become active.
-void Room::activate() { respawn_mobs(true); }
+void Room::activate()
+{
+    // Any Mobiles left dormant here need to catch up on the time that passed while the Room was inactive. A copy of the list is used, as catching up may move them elsewhere.
+    const auto mobs = core()->world()->mobs_in_room(id_);
+    for (auto mob : mobs)
+        AI::catch_up(mob);
+    respawn_mobs(true);
+}
 
 // Adds a scar to this room.
 void Room::add_scar(ScarType type, int intensity)
@@ -102,8 +120,9 @@ void Room::add_mob_spawn(const std::string &id) { spawn_mobs_.push_back(id); }
 void Room::clear_link_tag(uint8_t id, LinkTag the_tag)
 {
     if (id >= ROOM_LINKS_MAX) throw std::runtime_error("Invalid direction specified when clearing room link tag.");
-    if (!(tags_link_[id].count(the_tag) > 0)) return;
-    tags_link_[id].erase(the_tag);
+    if (!tags_link_[id].test(the_tag)) return;
+    tags_link_[id].clear(the_tag);
+    update_link_flags(id);
 }
 
 // As above, but with a Direction enum.
@@ -117,20 +136,10 @@ void Room::clear_meta(const std::string &key)
 }
 
 // Clears a tag on this Room.
-void Room::clear_tag(RoomTag the_tag)
-{
-    if (!(tags_.count(the_tag) > 0)) return;
-    tags_.erase(the_tag);
-}
+void Room::clear_tag(RoomTag the_tag) { tags_.clear(the_tag); }
 
 // Checks if a room link is dangerous (e.g. a sky link).
-bool Room::dangerous_link(Direction dir)
-{
-    if (link_tag(dir, LinkTag::Sky)) return true;
-    if (link_tag(dir, LinkTag::Sky2)) return true;
-    if (link_tag(dir, LinkTag::Sky3)) return true;
-    return false;
-}
+bool Room::dangerous_link(Direction dir) { return link_flags(static_cast<uint8_t>(dir)) & LINK_SKY; }
 
 // As above, but using an integer instead of an enum.
 bool Room::dangerous_link(uint8_t dir) { return dangerous_link(static_cast<Direction>(dir)); }
@@ -287,78 +296,72 @@ uint32_t Room::link(uint8_t dir) const
     return links_[dir];
 }
 
+// Retrieves the LinkFlags for a Room link, in a specified direction.
+uint8_t Room::link_flags(uint8_t dir) const
+{
+    if (dir >= ROOM_LINKS_MAX) throw std::runtime_error("Invalid direction specified when checking room link flags.");
+    return link_flags_[dir];
+}
+
 // Checks if a tag is set on this Room's link.
 bool Room::link_tag(uint8_t id, LinkTag the_tag) const
 {
     if (id >= ROOM_LINKS_MAX) throw std::runtime_error("Invalid direction specified when checking room link tag.");
-    if (the_tag == LinkTag::Lockable || the_tag == LinkTag::Openable || the_tag == LinkTag::Locked)
-    {
-        if (tags_link_[id].count(LinkTag::Permalock) > 0 || tags_link_[id].count(LinkTag::TempPermalock) > 0) return true;    // If checking for Lockable, Openable or Locked, also check for Permalock.
-        if (links_[id] == FALSE_ROOM) return true; // Links to FALSE_ROOM are always considered to be permalocked.
 
-        // Special rules check here. Because exits are usually unlocked by default, but may have the LockedByDefault tag, they then require Unlocked to mark them as currently unlocked. To simplify things, we'll just check for the Locked tag externally, and handle this special case here.
-        if (the_tag == LinkTag::Locked)
-        {
-            if (tags_link_[id].count(LinkTag::Locked) > 0) return true;    // If it's marked as Locked then it's locked, no question.
-            if (tags_link_[id].count(LinkTag::LockedByDefault) > 0)        // And here's the tricky bit.
-            {
-                if (tags_link_[id].count(LinkTag::Unlocked) > 0) return false; // If it's marked Unlocked, then we're good.
-                else return true;   // If not, then yes, it's locked.
-            }
-        }
+    // Lockable, Openable and Locked have special rules, which are worked out in advance by update_link_flags().
+    switch (the_tag)
+    {
+        case LinkTag::Lockable: return link_flags_[id] & LINK_LOCKABLE;
+        case LinkTag::Locked: return link_flags_[id] & LINK_LOCKED;
+        case LinkTag::Openable: return link_flags_[id] & LINK_DOOR;
+        default: return tags_link_[id].test(the_tag);
     }
-    return (tags_link_[id].count(the_tag) > 0);
 }
 
 // As above, but with a Direction enum.
 bool Room::link_tag(Direction dir, LinkTag the_tag) const { return link_tag(static_cast<uint8_t>(dir), the_tag); }
 
-// Loads the Room and anything it contains.
-void Room::load(std::shared_ptr<SQLite::Database> save_db)
+// Loads the Room and anything it contains, from the current row of a query on the rooms table.
+void Room::load_row(SQLite::Statement &query, std::shared_ptr<SaveReader> reader)
 {
-    uint32_t inventory_id = 0;
-    SQLite::Statement query(*save_db, "SELECT * FROM rooms WHERE id = :id");
-    query.bind(":id", id_);
-    if (query.executeStep())
+    const uint32_t inventory_id = query.getColumn("inventory").getUInt();
+    if (!query.isColumnNull("last_spawned_mobs")) last_spawned_mobs_ = query.getColumn("last_spawned_mobs").getUInt();
+    if (!query.isColumnNull("link_tags"))
     {
-        inventory_id = query.getColumn("inventory").getUInt();
-        if (!query.isColumnNull("last_spawned_mobs")) last_spawned_mobs_ = query.getColumn("last_spawned_mobs").getUInt();
-        if (!query.isColumnNull("link_tags"))
+        const std::string link_tags_str = query.getColumn("link_tags").getString();
+        std::vector<std::string> split_links = StrX::string_explode(link_tags_str, ",");
+        if (split_links.size() != ROOM_LINKS_MAX) throw std::runtime_error("Malformed room link tags data.");
+        for (int e = 0; e < ROOM_LINKS_MAX; e++)
         {
-            const std::string link_tags_str = query.getColumn("link_tags").getString();
-            std::vector<std::string> split_links = StrX::string_explode(link_tags_str, ",");
-            if (split_links.size() != ROOM_LINKS_MAX) throw std::runtime_error("Malformed room link tags data.");
-            for (int e = 0; e < ROOM_LINKS_MAX; e++)
-            {
-                if (!split_links.at(e).size()) continue;
-                std::vector<std::string> split_tags = StrX::string_explode(split_links.at(e), " ");
-                for (auto tag : split_tags)
-                    tags_link_[e].insert(static_cast<LinkTag>(StrX::htoi(tag)));
-            }
+            if (!split_links.at(e).size()) continue;
+            std::vector<std::string> split_tags = StrX::string_explode(split_links.at(e), " ");
+            for (auto tag : split_tags)
+                tags_link_[e].set(static_cast<LinkTag>(StrX::htoi(tag)));
+            update_link_flags(e);
         }
-        if (!query.getColumn("metadata").isNull()) StrX::string_to_metadata(query.getColumn("metadata").getString(), metadata_);
-        if (!query.isColumnNull("scars"))
+    }
+    if (!query.getColumn("metadata").isNull()) StrX::string_to_metadata(query.getColumn("metadata").getString(), metadata_);
+    if (!query.isColumnNull("scars"))
+    {
+        std::string scar_str = query.getColumn("scars").getString();
+        std::vector<std::string> scar_pairs = StrX::string_explode(scar_str, ",");
+        for (size_t i = 0; i < scar_pairs.size(); i++)
         {
-            std::string scar_str = query.getColumn("scars").getString();
-            std::vector<std::string> scar_pairs = StrX::string_explode(scar_str, ",");
-            for (size_t i = 0; i < scar_pairs.size(); i++)
-            {
-                std::vector<std::string> pair_explode = StrX::string_explode(scar_pairs.at(i), ";");
-                if (pair_explode.size() != 2) throw std::runtime_error("Malformed room scars data.");
-                scar_type_.push_back(static_cast<ScarType>(StrX::htoi(pair_explode.at(0))));
-                scar_intensity_.push_back(StrX::htoi(pair_explode.at(1)));
-            }
+            std::vector<std::string> pair_explode = StrX::string_explode(scar_pairs.at(i), ";");
+            if (pair_explode.size() != 2) throw std::runtime_error("Malformed room scars data.");
+            scar_type_.push_back(static_cast<ScarType>(StrX::htoi(pair_explode.at(0))));
+            scar_intensity_.push_back(StrX::htoi(pair_explode.at(1)));
         }
-        if (!query.isColumnNull("tags")) StrX::string_to_tags(query.getColumn("tags").getString(), tags_);
+    }
+    if (!query.isColumnNull("tags")) StrX::string_to_tags(query.getColumn("tags").getString(), tags_);
 
-        // Make sure this goes *after* loading tags.
-        if (tag(RoomTag::MobSpawnListChanged))
-        {
-            spawn_mobs_.clear();
-            if (!query.isColumnNull("spawn_mobs")) spawn_mobs_ = StrX::string_explode(query.getColumn("spawn_mobs").getString(), " ");
-        }
+    // Make sure this goes *after* loading tags.
+    if (tag(RoomTag::MobSpawnListChanged))
+    {
+        spawn_mobs_.clear();
+        if (!query.isColumnNull("spawn_mobs")) spawn_mobs_ = StrX::string_explode(query.getColumn("spawn_mobs").getString(), " ");
     }
-    if (inventory_id) inventory_->load(save_db, inventory_id);
+    if (inventory_id) inventory_->load(reader, inventory_id);
 }
 
 // Retrieves Room metadata.
@@ -401,9 +404,9 @@ void Room::respawn_mobs(bool ignore_timer)
 }
 
 // Saves the Room and anything it contains.
-void Room::save(std::shared_ptr<SQLite::Database> save_db)
+void Room::save(std::shared_ptr<SaveWriter> writer)
 {
-    const uint32_t inventory_id = inventory_->save(save_db);
+    const uint32_t inventory_id = inventory_->save(writer);
 
     const std::string tags = StrX::tags_to_string(tags_);
     std::string link_tags;
@@ -413,14 +416,15 @@ void Room::save(std::shared_ptr<SQLite::Database> save_db)
         if (e < ROOM_LINKS_MAX - 1) link_tags += ",";
     }
 
-    if (!tags.size() && link_tags == ",,,,,,,,," && !scar_type_.size()) return;
+    // A Room with nothing lying on the floor, and nothing else changed from its defaults, doesn't need a row of its own.
+    if (!inventory_id && !tags.size() && link_tags == ",,,,,,,,," && !scar_type_.size()) return;
 
-    SQLite::Statement room_query(*save_db, "INSERT INTO rooms (id, inventory, last_spawned_mobs, link_tags, metadata, scars, spawn_mobs, sql_id, tags) VALUES ( :id, :inventory, :last_spawned_mobs, :link_tags, :metadata, :scars, :spawn_mobs, :sql_id, :tags )");
-    room_query.bind(":id", id_);
-    if (inventory_id) room_query.bind(":inventory", inventory_id);
-    if (last_spawned_mobs_) room_query.bind(":last_spawned_mobs", last_spawned_mobs_);
-    if (link_tags != ",,,,,,,,,") room_query.bind(":link_tags", link_tags);
-    if (tag(RoomTag::MetaChanged)) room_query.bind(":metadata", StrX::metadata_to_string(metadata_));
+    writer->upsert(SQL_ROOMS_INSERT, SQL_ROOMS_DELETE, id_);
+    writer->bind(":id", id_);
+    if (inventory_id) writer->bind(":inventory", inventory_id);
+    if (last_spawned_mobs_) writer->bind(":last_spawned_mobs", last_spawned_mobs_);
+    if (link_tags != ",,,,,,,,,") writer->bind(":link_tags", link_tags);
+    if (tag(RoomTag::MetaChanged)) writer->bind(":metadata", StrX::metadata_to_string(metadata_));
     if (scar_type_.size())
     {
         std::string scar_str;
@@ -429,12 +433,12 @@ void Room::save(std::shared_ptr<SQLite::Database> save_db)
             scar_str += StrX::itoh(static_cast<int>(scar_type_.at(i)), 1) + ";" + StrX::itoh(scar_intensity_.at(i), 1);
             if (i < scar_type_.size() - 1) scar_str += ",";
         }
-        room_query.bind(":scars", scar_str);
+        writer->bind(":scars", scar_str);
     }
-    if (tag(RoomTag::MobSpawnListChanged) && spawn_mobs_.size()) room_query.bind(":spawn_mobs", StrX::collapse_vector(spawn_mobs_));
-    room_query.bind(":sql_id", core()->sql_unique_id());
-    if (tags.size()) room_query.bind(":tags", tags);
-    room_query.exec();
+    if (tag(RoomTag::MobSpawnListChanged) && spawn_mobs_.size()) writer->bind(":spawn_mobs", StrX::collapse_vector(spawn_mobs_));
+    writer->bind(":sql_id", id_);   // Room IDs are already unique, and stay the same from one save to the next.
+    if (tags.size()) writer->bind(":tags", tags);
+    writer->write();
 }
 
 // Returns the description of any room scars present.
@@ -470,14 +474,16 @@ void Room::set_link(Direction dir, uint32_t rooid_)
     const int dir_int = static_cast<int>(dir);
     if (dir_int < 0 || static_cast<int>(dir) >= ROOM_LINKS_MAX) throw std::runtime_error("Invalid direction specified when setting room link.");
     links_[dir_int] = rooid_;
+    update_link_flags(dir_int);
 }
 
 // Sets a tag on this Room's link.
 void Room::set_link_tag(uint8_t id, LinkTag the_tag)
 {
     if (id >= ROOM_LINKS_MAX) throw std::runtime_error("Invalid direction specified when setting room link tag.");
-    if (tags_link_[id].count(the_tag) > 0) return;
-    tags_link_[id].insert(the_tag);
+    if (tags_link_[id].test(the_tag)) return;
+    tags_link_[id].set(the_tag);
+    update_link_flags(id);
 }
 
 // As above, but with a Direction enum.
@@ -503,14 +509,10 @@ void Room::set_name(const std::string &new_name, const std::string &new_short_na
 void Room::set_security(Security sec) { security_ = sec; }
 
 // Sets a tag on this Room.
-void Room::set_tag(RoomTag the_tag)
-{
-    if (tags_.count(the_tag) > 0) return;
-    tags_.insert(the_tag);
-}
+void Room::set_tag(RoomTag the_tag) { tags_.set(the_tag); }
 
 // Checks if a tag is set on this Room.
-bool Room::tag(RoomTag the_tag) const { return (tags_.count(the_tag) > 0); }
+bool Room::tag(RoomTag the_tag) const { return tags_.test(the_tag); }
 
 // Returns the room's current temperature level.
 int Room::temperature(uint32_t flags) const
@@ -596,3 +598,25 @@ int Room::temperature(uint32_t flags) const
     else if (temp > 9) temp = 9;
     return temp;
 }
+
+// Works out the LinkFlags for one of this Room's links, and lets the World's room graph know they've changed.
+void Room::update_link_flags(uint8_t id)
+{
+    // Exits are usually unlocked by default, but may have the LockedByDefault tag, in which case they need the Unlocked tag to mark them as currently unlocked. Permalocked exits, and links to
+    // FALSE_ROOM, count as openable, lockable and locked all at once.
+    const LinkTags &tags = tags_link_[id];
+    const bool permalock = tags.any({LinkTag::Permalock, LinkTag::TempPermalock});
+    const bool always_locked = permalock || links_[id] == FALSE_ROOM;
+    uint8_t flags = 0;
+    if (always_locked || tags.test(LinkTag::Openable)) flags |= LINK_DOOR;
+    if (tags.test(LinkTag::Open)) flags |= LINK_OPEN;
+    if (always_locked || tags.test(LinkTag::Locked) || (tags.test(LinkTag::LockedByDefault) && !tags.test(LinkTag::Unlocked))) flags |= LINK_LOCKED;
+    if (permalock) flags |= LINK_BLOCKED;
+    if (tags.any({LinkTag::Sky, LinkTag::Sky2, LinkTag::Sky3})) flags |= LINK_SKY;
+    if (always_locked || tags.test(LinkTag::Lockable)) flags |= LINK_LOCKABLE;
+    if (link_flags_[id] == flags) return;
+    link_flags_[id] = flags;
+
+    const auto world = core()->world();
+    if (world) world->room_graph()->update_link(id_, id);   // The World won't exist yet if this Room is still being loaded from YAML data, but the graph is compiled from scratch after that anyway.
+}
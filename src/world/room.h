@@ -5,13 +5,13 @@
 #define GREAVE_WORLD_ROOM_H_
 
 #include "core/core-constants.h"
+#include "core/tag-set.h"
 #include "world/inventory.h"
 
 #include <cstddef>
 #include <cstdint>
 #include <map>
 #include <memory>
-#include <set>
 #include <string>
 #include <vector>
 
@@ -31,6 +31,8 @@ enum class LinkTag : uint16_t {
     KnownLocked,        // The player is aware that this exit is locked.
     TempPermalock,      // Like Permalock, but a temporary version.
 
+    _DynamicEnd,        // Do not use this tag, it's just a marker for the number of dynamic tags above.
+
     // ****************************************************************************************************
     // Tags at 10,000 or above are considered *permanent tags*. These tags WILL NOT be saved to save files.
     // ****************************************************************************************************
@@ -66,6 +68,8 @@ enum class LinkTag : uint16_t {
     // Link tags regarding NPC behaviour.
     NoMobRoam,          // NPCs should not roam through this exit. [CURRENTLY UNUSED]
     NoBlockExit,        // NPCs should not block the player passing this way, even if they're going to a private room. [CURRENTLY UNUSED]
+
+    _End                // Do not use this tag, it's just a marker for the number of tags above.
 };
 
 enum class RoomTag : uint16_t {
@@ -79,8 +83,8 @@ enum class RoomTag : uint16_t {
     MetaChanged,            // The metadata on this room has changed.
     MobSpawned,             // This room has spawned a mob already.
     MobSpawnListChanged,    // The mob spawn list on this room has changed.
-    SaveActive,             // An extra-temporary tag used by the save system, to keep track of active rooms when saving/loading the game.
 
+    _DynamicEnd,            // Do not use this tag, it's just a marker for the number of dynamic tags above.
 
     // ****************************************************************************************************
     // Tags at 10,000 or above are considered *permanent tags*. These tags WILL NOT be saved to save files.
@@ -130,8 +134,14 @@ enum class RoomTag : uint16_t {
     RadiationLight,         // This area is lightly irradiated. [CURRENTLY UNUSED]
     SludgePit,              // We got a sinky sludge pit here, guys. [CURRENTLY UNUSED]
     Tavern,                 // This room is a tavern, or part of a tavern.
+
+    _End                    // Do not use this tag, it's just a marker for the number of tags above.
 };
 
+// The dynamic and permanent tags are packed together into a single bitset, with the permanent tags straight after the dynamic ones.
+typedef TagSet<LinkTag, static_cast<size_t>(LinkTag::_DynamicEnd) + static_cast<size_t>(LinkTag::_End) - CoreConstants::TAGS_PERMANENT, static_cast<size_t>(LinkTag::_DynamicEnd)> LinkTags;
+typedef TagSet<RoomTag, static_cast<size_t>(RoomTag::_DynamicEnd) + static_cast<size_t>(RoomTag::_End) - CoreConstants::TAGS_PERMANENT, static_cast<size_t>(RoomTag::_DynamicEnd)> RoomTags;
+
 class Room
 {
 public:
@@ -139,6 +149,9 @@ public:
 
     enum class Security : uint8_t { ANARCHY, LOW, HIGH, SANCTUARY, INACCESSIBLE };
 
+    // The effective state of a Room's link, worked out from its LinkTags whenever they change.
+    enum LinkFlag : uint8_t { LINK_DOOR = 1, LINK_OPEN = 2, LINK_LOCKED = 4, LINK_BLOCKED = 8, LINK_SKY = 16, LINK_LOCKABLE = 32 };
+
     static constexpr uint32_t   BLOCKED =           538012167;  // Hashed value for BLOCKED, which is used to mark exits as impassible.
     static constexpr uint32_t   FALSE_ROOM =        3399618268; // Hashed value for FALSE_ROOM, which is used to make 'fake' impassible room exits.
     static constexpr uint8_t    LIGHT_VISIBLE =     3;          // Any light level below this is considered too dark to see.
@@ -146,6 +159,8 @@ public:
     static constexpr int        ROOM_LINKS_MAX =    10;         // The maximum amount of exit links from one Room to another.
     static constexpr uint32_t   UNFINISHED =        1909878064; // Hashed value for UNFINISHED, which is used to mark room exits as unfinished and to be completed later.
     static const char           SQL_ROOMS[];                    // The SQL table construction string for the saved rooms.
+    static const char           SQL_ROOMS_DELETE[];             // The SQL statement for deleting a room which no longer needs saving.
+    static const char           SQL_ROOMS_INSERT[];             // The SQL statement for saving a room.
 
     // Flags for the temperature() function.
     static constexpr int        TEMPERATURE_FLAG_WITH_PLAYER_BUFFS =        (1 << 0);   // Apply the Player's buffs to the result of the room's temperature() calculations.
@@ -176,14 +191,15 @@ public:
     int         light() const;                                          // Gets the light level of this Room, adjusted by dynamic lights, and optionally including darkvision etc.
     uint32_t    link(Direction dir) const;                              // Retrieves a Room link in the specified direction.
     uint32_t    link(uint8_t dir) const;                                // As above, but using an integer.
+    uint8_t     link_flags(uint8_t dir) const;                          // Retrieves the LinkFlags for a Room link, in a specified direction.
     bool        link_tag(uint8_t id, LinkTag the_tag) const;            // Checks if a tag is set on this Room's link.
     bool        link_tag(Direction dir, LinkTag the_tag) const;         // As above, but with a Direction enum.
-    void        load(std::shared_ptr<SQLite::Database> save_db);        // Loads the Room and anything it contains.
+    void        load_row(SQLite::Statement &query, std::shared_ptr<SaveReader> reader);  // Loads the Room and anything it contains, from the current row of a query on the rooms table.
     std::string meta(const std::string &key, bool spaces = true) const; // Retrieves Room metadata.
     std::map<std::string, std::string>* meta_raw();                     // Accesses the metadata map directly. Use with caution!
     std::string name(bool short_name = false) const;                    // Returns the Room's full or short name.
     void        respawn_mobs(bool ignore_timer = false);                // Respawn Mobiles in this Room, if possible.
-    void        save(std::shared_ptr<SQLite::Database> save_db);        // Saves the Room and anything it contains.
+    void        save(std::shared_ptr<SaveWriter> writer);               // Saves the Room and anything it contains.
     std::string scar_desc() const;                                      // Returns the description of any room scars present.
     void        set_base_light(int new_light);                          // Sets this Room's base light level.
     void        set_desc(const std::string &new_desc);                  // Sets this Room's description.
@@ -223,11 +239,14 @@ private:
     static constexpr int    WEATHER_TIME_MOD_SUNSET =           0;      // The temperature modification for sunset.
     static const char*      ROOM_SCAR_DESCS[][4];                       // The descriptions for different types of room scars.
 
+    void        update_link_flags(uint8_t id);                          // Works out the LinkFlags for one of this Room's links, and lets the World's room graph know they've changed.
+
     std::string                         desc_;                          // The Room's description.
     uint32_t                            id_;                            // The Room's unique ID, hashed from its YAML name.
     std::shared_ptr<Inventory>          inventory_;                     // The Room's inventory, for storing dropped items.
     uint32_t                            last_spawned_mobs_;             // The timer for when this Room last spawned Mobiles.
     uint8_t                             light_;                         // The default light level of this Room.
+    uint8_t                             link_flags_[ROOM_LINKS_MAX];    // The LinkFlags for each of this Room's links.
     uint32_t                            links_[ROOM_LINKS_MAX];         // Links to other Rooms.
     std::map<std::string, std::string>  metadata_;                      // The Room's metadata, if any.
     std::string                         name_;                          // The Room's title.
@@ -236,8 +255,8 @@ private:
     std::vector<ScarType>               scar_type_;                     // The type of room scars, if any.
     Security                            security_;                      // The security rating for this Room.
     std::vector<std::string>            spawn_mobs_;                    // The list of Mobiles to spawn here.
-    std::set<RoomTag>                   tags_;                          // Any and all RoomTags on this Room.
-    std::set<LinkTag>                   tags_link_[ROOM_LINKS_MAX];     // Any and all LinkTags on this Room's links.
+    RoomTags                            tags_;                          // Any and all RoomTags on this Room.
+    LinkTags                            tags_link_[ROOM_LINKS_MAX];     // Any and all LinkTags on this Room's links.
 };
 
 #endif  // GREAVE_WORLD_ROOM_H_
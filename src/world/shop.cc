@@ -3,21 +3,28 @@
 
 #include "core/core.h"
 #include "core/mathx.h"
+#include "core/pool.h"
 #include "core/strx.h"
 #include "world/shop.h"
 
 
 // SQL table construction string.
-constexpr char Shop::SQL_SHOPS[] = "CREATE TABLE shops ( id INTEGER PRIMARY KEY UNIQUE NOT NULL, inventory_id INTEGER UNIQUE NOT NULL )";
+constexpr char Shop::SQL_SHOPS[] = "CREATE TABLE IF NOT EXISTS shops ( id INTEGER PRIMARY KEY UNIQUE NOT NULL, inventory_id INTEGER UNIQUE NOT NULL )";
+
+// SQL statement for deleting a shop.
+constexpr char Shop::SQL_SHOPS_DELETE[] = "DELETE FROM shops WHERE id = ?";
+
+// SQL statement for saving a shop.
+constexpr char Shop::SQL_SHOPS_INSERT[] = "INSERT OR REPLACE INTO shops ( id, inventory_id ) VALUES ( :id, :inventory_id )";
 
 
 // Constructor, sets up a blank shop by default.
-Shop::Shop(uint32_t room_id) : inventory_(std::make_shared<Inventory>(Inventory::PID_PREFIX_SHOP)), room_id_(room_id) { }
+Shop::Shop(uint32_t room_id) : inventory_(Pool::make_shared<Inventory>(Inventory::PID_PREFIX_SHOP)), room_id_(room_id) { }
 
 // Adds an item to this shop's inventory.
 void Shop::add_item(std::shared_ptr<Item> item, bool sort)
 {
-    item->set_meta("appraised_value", item->value(true));
+    item->set_appraised_value(item->value(true));
     inventory_->add_item(item, true);
     if (sort) inventory_->sort();
 }
@@ -82,7 +89,7 @@ void Shop::buy(uint32_t id, int quantity)
     // We'll handle stackable and normally-unstackable items separately here. First, stackable items.
     else if (stackable)
     {
-        auto split_item = std::make_shared<Item>(*item);
+        auto split_item = Pool::make_shared<Item>(*item);
         split_item->set_stack(quantity);
         item->set_stack(item->stack() - quantity);
         player->inv()->add_item(split_item);
@@ -94,7 +101,7 @@ void Shop::buy(uint32_t id, int quantity)
         item->set_stack(item->stack() - quantity);
         for (int i = 0; i < quantity; i++)
         {
-            auto split_item = std::make_shared<Item>(*item);
+            auto split_item = Pool::make_shared<Item>(*item);
             split_item->set_stack(1);
             player->inv()->add_item(split_item);
         }
@@ -108,17 +115,8 @@ void Shop::buy(uint32_t id, int quantity)
 // Returns a pointer to the shop's inventory.
 const std::shared_ptr<Inventory> Shop::inv() const { return inventory_; }
 
-// Loads a shop from the save file.
-void Shop::load(std::shared_ptr<SQLite::Database> save_db)
-{
-    SQLite::Statement query(*save_db, "SELECT * FROM shops WHERE id = :id");
-    query.bind(":id", room_id_);
-    if (query.executeStep())
-    {
-        inventory_->load(save_db, query.getColumn("inventory_id").getUInt());
-    }
-    else throw std::runtime_error("Could not load shop data (ID: " + std::to_string(room_id_) + ")");
-}
+// Loads a shop from the save file, given the ID of its saved inventory.
+void Shop::load(std::shared_ptr<SaveReader> reader, uint32_t inventory_id) { inventory_->load(reader, inventory_id); }
 
 // Restocks the contents of this shop.
 void Shop::restock()
@@ -146,13 +144,13 @@ void Shop::restock()
 }
 
 // Saves this Shop to the save file.
-void Shop::save(std::shared_ptr<SQLite::Database> save_db) const
+void Shop::save(std::shared_ptr<SaveWriter> writer) const
 {
-    const uint32_t inv_id = inventory_->save(save_db);
-    SQLite::Statement query(*save_db, "INSERT INTO shops ( id, inventory_id ) VALUES ( :id, :inventory_id )");
-    query.bind(":id", room_id_);
-    query.bind(":inventory_id", inv_id);
-    query.exec();
+    const uint32_t inv_id = inventory_->save(writer);
+    writer->upsert(SQL_SHOPS_INSERT, SQL_SHOPS_DELETE, room_id_);
+    writer->bind(":id", room_id_);
+    writer->bind(":inventory_id", inv_id);
+    writer->write();
 }
 
 // Offers an item to the shop to sell.
@@ -200,7 +198,7 @@ void Shop::sell(uint32_t id, int quantity, bool confirm)
     }
     else
     {
-        auto item_split = std::make_shared<Item>(*item);
+        auto item_split = Pool::make_shared<Item>(*item);
         item->set_stack(stack_size - quantity);
         item_split->set_stack(quantity);
         add_item(item_split);
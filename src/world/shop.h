@@ -15,15 +15,17 @@ class Shop
 {
 public:
     static const char   SQL_SHOPS[];    // SQL table construction string.
+    static const char   SQL_SHOPS_DELETE[]; // SQL statement for deleting a shop.
+    static const char   SQL_SHOPS_INSERT[]; // SQL statement for saving a shop.
 
             Shop(uint32_t room_id);                                 // Constructor, sets up a blank shop by default.
     void    add_item(std::shared_ptr<Item> item, bool sort = true); // Adds an item to this shop's inventory.
     void    browse() const;                                         // Browses the wares on sale.
     void    buy(uint32_t id, int quantity);                         // Attempts to purchase something.
     const std::shared_ptr<Inventory>    inv() const;                // Returns a pointer to the shop's inventory.
-    void    load(std::shared_ptr<SQLite::Database> save_db);        // Loads a shop from the save file.
+    void    load(std::shared_ptr<SaveReader> reader, uint32_t inventory_id);   // Loads a shop from the save file, given the ID of its saved inventory.
     void    restock();                                              // Restocks the contents of this shop.
-    void    save(std::shared_ptr<SQLite::Database> save_db) const;  // Saves this shop to the save file.
+    void    save(std::shared_ptr<SaveWriter> writer) const;         // Saves this shop to the save file.
     void    sell(uint32_t id, int quantity, bool confirm);          // Offers an item to the shop to sell.
 
 private:
@@ -8,12 +8,14 @@
 #include "core/strx.h"
 #include "world/time-weather.h"
 
+#include <algorithm>
 
-// SQL table construction string for the heartbeat timers.
-constexpr char TimeWeather::SQL_HEARTBEATS[] = "CREATE TABLE heartbeats ( id INTEGER PRIMARY KEY UNIQUE NOT NULL, count INTEGER NOT NULL )";
 
 // SQL table construction string for time and weather data.
-const char TimeWeather::SQL_TIME_WEATHER[] = "CREATE TABLE time_weather ( day INTEGER NOT NULL, moon INTEGER NOT NULL, subsecond REAL NOT NULL, time INTEGER PRIMARY KEY UNIQUE NOT NULL, time_total INTEGER NOT NULL, weather INTEGER NOT NULL )";
+const char TimeWeather::SQL_TIME_WEATHER[] = "CREATE TABLE IF NOT EXISTS time_weather ( day INTEGER NOT NULL, heartbeats TEXT NOT NULL, moon INTEGER NOT NULL, subsecond REAL NOT NULL, time INTEGER PRIMARY KEY UNIQUE NOT NULL, time_total INTEGER NOT NULL, weather INTEGER NOT NULL )";
+
+// SQL statement for saving the time and weather data.
+const char TimeWeather::SQL_TIME_WEATHER_INSERT[] = "INSERT INTO time_weather ( day, heartbeats, moon, subsecond, time, time_total, weather ) VALUES ( :day, :heartbeats, :moon, :subsecond, :time, :time_total, :weather )";
 
 // The heartbeat timers, for triggering various events at periodic intervals.
 const uint32_t TimeWeather::HEARTBEAT_TIMERS[TimeWeather::Heartbeat::_TOTAL] = {
@@ -29,6 +31,9 @@ const uint32_t TimeWeather::HEARTBEAT_TIMERS[TimeWeather::Heartbeat::_TOTAL] = {
     311 * Time::MINUTE, // THIRST. More rapid than hunger.
 };
 
+// The times (in minutes) at which the time of day changes, plus the end of the day.
+const int TimeWeather::TIME_OF_DAY_CHANGES[] = { 300, 420, 540, 660, 1020, 1140, 1260, 1380, 1440 };
+
 
 // Constructor, sets default values.
 TimeWeather::TimeWeather() : day_(80), moon_(1), time_(39660), time_passed_(0), subsecond_(0), weather_(Weather::FAIR)
@@ -55,11 +60,14 @@ TimeWeather::TimeWeather() : day_(80), moon_(1), time_(39660), time_passed_(0),
         throw std::runtime_error("Error while loading data/misc/weather.yml: " + std::string(e.what()));
     }
 
-    // Reset all the heartbeats.
+    // Schedule all the heartbeats. They all trigger on the very first second of a new game.
     for (unsigned int h = 0; h < TimeWeather::Heartbeat::_TOTAL; h++)
-        heartbeats_[h] = HEARTBEAT_TIMERS[h];
+        schedule_heartbeat(static_cast<Heartbeat>(h), time_passed_ + 1);
 }
 
+// Orders events by due time, allowing for time_passed_ looping around.
+bool TimeWeather::ScheduledEvent::operator>(const ScheduledEvent &other) const { return static_cast<int32_t>(due - other.due) > 0; }
+
 // Gets the current season.
 TimeWeather::Season TimeWeather::current_season() const
 {
@@ -124,25 +132,50 @@ TimeWeather::Weather TimeWeather::fix_weather(TimeWeather::Weather weather, Time
 // Gets the current weather, runs fix_weather() internally.
 TimeWeather::Weather TimeWeather::get_weather() const { return fix_weather(weather_, current_season()); }
 
-// Increases a specified heartbeat timer.
+// Checks how often a specified heartbeat triggers, in seconds.
+uint32_t TimeWeather::heartbeat_interval(Heartbeat beat) const { return HEARTBEAT_TIMERS[beat]; }
+
+// Brings a specified heartbeat's next trigger forward by a number of seconds.
 void TimeWeather::increase_heartbeat(Heartbeat beat, int count)
 {
     if (beat >= Heartbeat::_TOTAL) throw std::runtime_error("Invalid heartbeat ID!");
-    heartbeats_[static_cast<int>(beat)] += count;
+    uint32_t due = heartbeat_due_[beat] - count;
+    if (is_due(due)) due = time_passed_ + 1;    // A heartbeat can't trigger in the past, so anything overdue will trigger on the next second instead.
+    schedule_heartbeat(beat, due);
+}
+
+// Checks if a heartbeat can be skipped past when fast-forwarding, and caught up on all at once with heartbeats_ready().
+bool TimeWeather::heartbeat_batched(Heartbeat beat)
+{
+    // These heartbeats come around every few seconds, and would otherwise stop any fast-forward from getting very far. Regenerating stamina and mana over several ticks is the same as
+    // regenerating it all at once, and buffs are only ticked one at a time when one of them is due to change (see seconds_until_event()).
+    return beat == Heartbeat::BUFFS || beat == Heartbeat::MP_REGEN || beat == Heartbeat::SP_REGEN;
 }
 
-// Checks if a given heartbeat is ready to trigger, and resets its counter.
+// Checks if a given heartbeat is ready to trigger, and if so, schedules its next trigger.
 bool TimeWeather::heartbeat_ready(Heartbeat beat)
 {
     if (beat >= Heartbeat::_TOTAL) throw std::runtime_error("Invalid heartbeat ID!");
-    if (heartbeats_[beat] >= HEARTBEAT_TIMERS[beat])
-    {
-        heartbeats_[beat] = 0;
-        return true;
-    }
-    return false;
+    if (!is_due(heartbeat_due_[beat])) return false;
+    schedule_heartbeat(beat, time_passed_ + HEARTBEAT_TIMERS[beat]);
+    return true;
 }
 
+// As heartbeat_ready(), but returns how many times the heartbeat has come due, in case a fast-forward skipped past some.
+uint32_t TimeWeather::heartbeats_ready(Heartbeat beat)
+{
+    if (beat >= Heartbeat::_TOTAL) throw std::runtime_error("Invalid heartbeat ID!");
+    if (!is_due(heartbeat_due_[beat])) return 0;
+
+    // The next trigger is scheduled from when the heartbeat was due, not from now, so skipping past it doesn't throw off its timing.
+    const uint32_t count = (time_passed_ - heartbeat_due_[beat]) / HEARTBEAT_TIMERS[beat] + 1;
+    schedule_heartbeat(beat, heartbeat_due_[beat] + count * HEARTBEAT_TIMERS[beat]);
+    return count;
+}
+
+// Checks if a given time_passed_ value has been reached.
+bool TimeWeather::is_due(uint32_t due) const { return static_cast<int32_t>(time_passed_ - due) >= 0; }
+
 // Checks whether it's light or dark right now.
 TimeWeather::LightDark TimeWeather::light_dark() const
 {
@@ -165,16 +198,15 @@ void TimeWeather::load(std::shared_ptr<SQLite::Database> save_db)
         time_ = query.getColumn("time").getInt();
         time_passed_ = query.getColumn("time_total").getUInt();
         weather_ = static_cast<Weather>(query.getColumn("weather").getInt());
-    }
-    else throw std::runtime_error("Could not load time and weather data!");
 
-    SQLite::Statement heartbeat_query(*save_db, "SELECT * FROM heartbeats");
-    while (heartbeat_query.executeStep())
-    {
-        uint32_t id = heartbeat_query.getColumn("id").getUInt();
-        if (id >= Heartbeat::_TOTAL) throw std::runtime_error("Invalid heartbeat data!");
-        heartbeats_[id] = heartbeat_query.getColumn("count").getUInt();
+        // The heartbeats are saved as the number of seconds remaining until each one next triggers.
+        const std::vector<std::string> heartbeats = StrX::string_explode(query.getColumn("heartbeats").getString(), ",");
+        if (heartbeats.size() != Heartbeat::_TOTAL) throw std::runtime_error("Invalid heartbeat data!");
+        schedule_ = decltype(schedule_)();
+        for (unsigned int h = 0; h < Heartbeat::_TOTAL; h++)
+            schedule_heartbeat(static_cast<Heartbeat>(h), time_passed_ + StrX::htoi(heartbeats.at(h)));
     }
+    else throw std::runtime_error("Could not load time and weather data!");
 }
 
 // Returns the name of the current month.
@@ -235,7 +267,7 @@ bool TimeWeather::pass_time(float seconds, bool interruptable)
     int old_hp = player->hp();
     int old_hunger = player->hunger();
     int old_thirst = player->thirst();
-    while (seconds_to_add--)
+    while (seconds_to_add > 0)
     {
         if (player->is_dead()) return false;    // Don't pass time if the player is dead.
 
@@ -251,11 +283,19 @@ bool TimeWeather::pass_time(float seconds, bool interruptable)
             old_thirst = thirst;
         }
 
-        time_passed_++;    // The total time passed in the game. This will loop every 136 years, but that's not a problem; see time_passed().
+        // If nothing is close enough to the player to interact with them, we can skip ahead to the next scheduled event (heartbeat or time-of-day change) in one go, rather than one second at a time.
+        // The skipped seconds are exactly those in which nothing but far-off Mobiles wandering around could have happened, and the final second of the skip is then processed as normal. The skip
+        // also ends before any of those Mobiles could wander all the way to the player.
+        uint32_t skip = 1;
+        if (seconds_to_add > 1 && AI::can_fast_forward())
+        {
+            skip = std::min(seconds_until_event(), AI::fast_forward_limit());
+            if (skip > static_cast<uint32_t>(seconds_to_add)) skip = seconds_to_add;
+        }
+        seconds_to_add -= skip;
+
+        time_passed_ += skip;   // The total time passed in the game. This will loop every 136 years, but that's not a problem; see time_passed().
 
-        // Increase all heartbeat timers.
-        for (unsigned int h = 0; h < Heartbeat::_TOTAL; h++)
-            heartbeats_[h]++;
 
         // Update the time of day and weather.
         const bool show_weather_messages = (!indoors || can_see_outside);
@@ -263,7 +303,8 @@ bool TimeWeather::pass_time(float seconds, bool interruptable)
         int old_time = time_;
         bool change_happened = false;
         std::string weather_msg;
-        if (++time_ >= Time::DAY) time_ -= Time::DAY;
+        time_ += skip;
+        if (time_ >= Time::DAY) time_ -= Time::DAY;
         if (time_ >= 420 * Time::MINUTE && old_time < 420 * Time::MINUTE)   // Trigger moon-phase changing and day-of-year changing at dawn, not midnight.
         {
             if (++day_ > 364) day_ = 1;
@@ -281,15 +322,15 @@ bool TimeWeather::pass_time(float seconds, bool interruptable)
         if (change_happened && !player_is_resting) core()->message(weather_message_colour() + weather_msg.substr(1));
 
         // Runs the AI on all active mobiles.
-        AI::tick_mobs();
+        if (skip > 1) AI::fast_forward(skip);
+        else AI::tick_mobs();
         if (player->is_dead()) return true;
 
-        std::set<uint32_t> active_rooms;    // This starts empty, but can be re-used if multiple heartbeats need to check active rooms.
+        const auto &active_rooms = world->active_rooms();
 
         // Scan through all active rooms, respawning NPCs if needed.
         if (heartbeat_ready(Heartbeat::MOBILE_SPAWN))
         {
-            if (!active_rooms.size()) active_rooms = world->active_rooms();
             for (auto room_id : active_rooms)
             {
                 const auto room = world->get_room(room_id);
@@ -300,7 +341,6 @@ bool TimeWeather::pass_time(float seconds, bool interruptable)
         // Reduce room scars on active rooms.
         if (heartbeat_ready(Heartbeat::ROOM_SCARS))
         {
-            if (!active_rooms.size()) active_rooms = world->active_rooms();
             for (auto room_id : active_rooms)
             {
                 const auto room = world->get_room(room_id);
@@ -309,13 +349,8 @@ bool TimeWeather::pass_time(float seconds, bool interruptable)
         }
 
         // Reduce timers on buffs for all Mobiles and the Player.
-        if (heartbeat_ready(Heartbeat::BUFFS))
-        {
-            player->tick_buffs();
-            if (player->is_dead()) return true;
-            for (size_t m = 0; m < world->mob_count(); m++)
-                world->mob_vec(m)->tick_buffs();
-        }
+        const uint32_t buff_ticks = heartbeats_ready(Heartbeat::BUFFS);
+        if (buff_ticks && world->tick_buffs(buff_ticks)) return true;
 
         // Increases the player's hunger.
         if (heartbeat_ready(Heartbeat::HUNGER))
@@ -335,15 +370,17 @@ bool TimeWeather::pass_time(float seconds, bool interruptable)
         if (heartbeat_ready(Heartbeat::HP_REGEN))
         {
             player->tick_hp_regen();
-            for (unsigned int i = 0; i < world->mob_count(); i++)
-                world->mob_vec(i)->tick_hp_regen();
+            for (auto mob : world->active_mobs())
+                mob->tick_hp_regen();   // Dormant Mobiles catch up on their regeneration when their room next becomes active.
         }
 
         // Regenerates stamina points over time.
-        if (heartbeat_ready(Heartbeat::SP_REGEN)) player->tick_sp_regen();
+        const uint32_t sp_ticks = heartbeats_ready(Heartbeat::SP_REGEN);
+        if (sp_ticks) player->tick_sp_regen(sp_ticks);
 
         // Regenerates mana points over time.
-        if (heartbeat_ready(Heartbeat::MP_REGEN)) player->tick_mp_regen();
+        const uint32_t mp_ticks = heartbeats_ready(Heartbeat::MP_REGEN);
+        if (mp_ticks) player->tick_mp_regen(mp_ticks);
 
         // Ticks diseases and reduces blood toxicity.
         if (heartbeat_ready(Heartbeat::DISEASE))
@@ -354,30 +391,69 @@ bool TimeWeather::pass_time(float seconds, bool interruptable)
         // Increases the player's hauling skill if they are over-encumbered.
         if (heartbeat_ready(Heartbeat::CARRY))
             if (player->carry_weight() > std::round(static_cast<float>(player->max_carry()) * 0.75f)) player->gain_skill_xp("HAULING", XP_WHILE_ENCUMBERED);
+
+        tidy_schedule();
     }
 
     return true;
 }
 
 // Saves the time/weather data to disk.
-void TimeWeather::save(std::shared_ptr<SQLite::Database> save_db) const
+void TimeWeather::save(std::shared_ptr<SaveWriter> writer) const
 {
-    SQLite::Statement query(*save_db, "INSERT INTO time_weather ( day, moon, subsecond, time, time_total, weather ) VALUES ( :day, :moon, :subsecond, :time, :time_total, :weather )");
-    query.bind(":day", day_);
-    query.bind(":moon", moon_);
-    query.bind(":subsecond", subsecond_);
-    query.bind(":time", time_);
-    query.bind(":time_total", time_passed_);
-    query.bind(":weather", static_cast<int>(weather_));
-    query.exec();
-
+    std::string heartbeats;
     for (unsigned int h = 0; h < Heartbeat::_TOTAL; h++)
     {
-        SQLite::Statement heartbeat_query(*save_db, "INSERT INTO heartbeats ( id, count ) VALUES ( :id, :count )");
-        heartbeat_query.bind(":id", h);
-        heartbeat_query.bind(":count", heartbeats_[h]);
-        heartbeat_query.exec();
+        if (h) heartbeats += ",";
+        heartbeats += StrX::itoh(heartbeat_due_[h] - time_passed_, 1);
+    }
+
+    writer->insert(SQL_TIME_WEATHER_INSERT);
+    writer->bind(":day", day_);
+    writer->bind(":heartbeats", heartbeats);
+    writer->bind(":moon", moon_);
+    writer->bind(":subsecond", subsecond_);
+    writer->bind(":time", time_);
+    writer->bind(":time_total", time_passed_);
+    writer->bind(":weather", static_cast<int>(weather_));
+    writer->write();
+}
+
+// Schedules a heartbeat to trigger at the specified time.
+void TimeWeather::schedule_heartbeat(Heartbeat beat, uint32_t due)
+{
+    heartbeat_due_[beat] = due;
+    if (!heartbeat_batched(beat)) schedule_.push({due, beat});
+}
+
+// Returns the number of seconds until the next heartbeat, buff change or time-of-day change. Batched heartbeats that have nothing to do are skipped past.
+uint32_t TimeWeather::seconds_until_event()
+{
+    tidy_schedule();
+    uint32_t seconds = Time::DAY;
+    if (schedule_.size())
+    {
+        const uint32_t next_due = schedule_.top().due;
+        if (is_due(next_due)) return 1;
+        seconds = next_due - time_passed_;
+    }
+
+    // Batched heartbeats can be skipped past, but the buffs heartbeat still has to trigger on time when a buff is due to change.
+    const uint32_t buff_ticks = core()->world()->buff_ticks_until_event();
+    if (buff_ticks != UINT32_MAX)
+    {
+        const uint32_t buff_due = heartbeat_due_[Heartbeat::BUFFS];
+        if (is_due(buff_due)) return 1;
+        const uint64_t buff_seconds = (buff_due - time_passed_) + static_cast<uint64_t>(buff_ticks - 1) * HEARTBEAT_TIMERS[Heartbeat::BUFFS];
+        if (buff_seconds < seconds) seconds = buff_seconds;
+    }
+    for (auto change : TIME_OF_DAY_CHANGES)
+    {
+        if (change * Time::MINUTE <= time_) continue;
+        seconds = std::min<uint32_t>(seconds, change * Time::MINUTE - time_);
+        break;
     }
+    return seconds;
 }
 
 // Converts a season enum to a string.
@@ -472,6 +548,17 @@ void TimeWeather::trigger_event(TimeWeather::Season season, std::string *message
     else core()->message(weather_message_colour() + time_message);
 }
 
+// Discards any stale events from the front of the schedule.
+void TimeWeather::tidy_schedule()
+{
+    while (schedule_.size())
+    {
+        const ScheduledEvent &next = schedule_.top();
+        if (next.due != heartbeat_due_[next.beat]) schedule_.pop();     // Any event that doesn't match its heartbeat's due time has since been rescheduled or triggered.
+        else break;
+    }
+}
+
 // Returns the total amount of seconds that passed in the game.
 uint32_t TimeWeather::time_passed() const { return time_passed_; }
 
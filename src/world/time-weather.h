@@ -6,10 +6,13 @@
 #define GREAVE_WORLD_TIME_WEATHER_H_
 
 #include "3rdparty/SQLiteCpp/Database.h"
+#include "core/save-writer.h"
 
 #include <cstdint>
+#include <functional>
 #include <map>
 #include <memory>
+#include <queue>
 #include <string>
 #include <vector>
 
@@ -25,8 +28,8 @@ public:
     enum class Weather : uint8_t { BLIZZARD, STORMY, RAIN, CLEAR, FAIR, OVERCAST, FOG, LIGHTSNOW, SLEET };
     enum Time { SECOND = 1, MINUTE = 60, HOUR = 3600, DAY = 86400 };
 
-    static const char   SQL_HEARTBEATS[];   // SQL table construction string for the heartbeat timers.
     static const char   SQL_TIME_WEATHER[]; // SQL table construction string for time and weather data.
+    static const char   SQL_TIME_WEATHER_INSERT[];  // SQL statement for saving the time and weather data.
 
                 TimeWeather();                      // Constructor, sets default values.
     Season      current_season() const;             // Gets the current season.
@@ -34,14 +37,16 @@ public:
     int         day_of_month() const;               // Returns the current day of the month.
     std::string day_of_month_string() const;        // Returns the day of the month in the form of a string like "1st" or "19th".
     Weather     get_weather() const;                // Gets the current weather, runs fix_weather() internally.
-    void        increase_heartbeat(Heartbeat beat, int count);  // Increases a specified heartbeat timer.
+    uint32_t    heartbeat_interval(Heartbeat beat) const;   // Checks how often a specified heartbeat triggers, in seconds.
+    void        increase_heartbeat(Heartbeat beat, int count);  // Brings a specified heartbeat's next trigger forward by a number of seconds.
     LightDark   light_dark() const;                 // Checks whether it's light or dark right now.
     void        load(std::shared_ptr<SQLite::Database> save_db);    // Loads the time/weather data from disk.
     std::string month_name() const;                 // Returns the name of the current month.
     LunarPhase  moon_phase() const;                 // Gets the current lunar phase.
     bool        pass_time(float seconds, bool interruptable);       // Causes time to pass.
-    void        save(std::shared_ptr<SQLite::Database> save_db) const;  // Saves the time/weather data to disk.
+    void        save(std::shared_ptr<SaveWriter> writer) const;     // Saves the time/weather data to disk.
     std::string season_str(Season season) const;    // Converts a season enum to a string.
+    uint32_t    seconds_until_event();              // Returns the number of seconds until the next heartbeat, buff change or time-of-day change. Batched heartbeats that have nothing to do are skipped past.
     TimeOfDay   time_of_day(bool fine) const;       // Returns the current time of day (morning, day, dusk, night).
     int         time_of_day_exact() const;          // Returns the exact time of day.
     std::string time_of_day_str(bool fine) const;   // Returns the current time of day as a string.
@@ -52,24 +57,39 @@ public:
     std::string weather_str(Weather weather) const; // Converts a weather integer to a string.
 
 private:
+    struct ScheduledEvent
+    {
+        uint32_t    due;    // The time_passed_ value at which this event is due to trigger.
+        Heartbeat   beat;   // The heartbeat to trigger.
+
+        bool operator>(const ScheduledEvent &other) const;  // Orders events by due time, allowing for time_passed_ looping around.
+    };
+
     static constexpr int    LUNAR_CYCLE_DAYS =      29;             // How many days are in a lunar cycle?
     static constexpr float  UNINTERRUPTABLE_TIME =  5;              // The maximum amount of time for an action that cannot be interrupted.
     static constexpr int    XP_WHILE_ENCUMBERED =   1;              // How much XP to grant per carry tick for encumbered players.
     static const uint32_t   HEARTBEAT_TIMERS[Heartbeat::_TOTAL];    // The heartbeat timers, for triggering various events at periodic intervals.
+    static const int        TIME_OF_DAY_CHANGES[];                  // The times (in minutes) at which the time of day changes, plus the end of the day.
 
     Weather     fix_weather(Weather weather, Season season) const;  // Fixes weather for a specified season, to account for unavailable weather types.
-    bool        heartbeat_ready(Heartbeat beat);                    // Checks if a given heartbeat is ready to trigger, and resets its counter.
+    static bool heartbeat_batched(Heartbeat beat);                  // Checks if a heartbeat can be skipped past when fast-forwarding, and caught up on all at once with heartbeats_ready().
+    bool        heartbeat_ready(Heartbeat beat);                    // Checks if a given heartbeat is ready to trigger, and if so, schedules its next trigger.
+    uint32_t    heartbeats_ready(Heartbeat beat);                   // As heartbeat_ready(), but returns how many times the heartbeat has come due, in case a fast-forward skipped past some.
+    bool        is_due(uint32_t due) const;                         // Checks if a given time_passed_ value has been reached.
+    void        schedule_heartbeat(Heartbeat beat, uint32_t due);   // Schedules a heartbeat to trigger at the specified time.
+    void        tidy_schedule();                                    // Discards any stale events from the front of the schedule.
     void        trigger_event(Season season, std::string *message_to_append, bool silent);  // Triggers a time-change event.
     std::string weather_desc(Season season) const;                  // Returns a weather description for the current time/weather, based on the specified season.
 
     int         day_;                           // The current day of the year.
-    uint32_t    heartbeats_[Heartbeat::_TOTAL]; // The heartbeat timers, for triggering various events at periodic intervals.
+    uint32_t    heartbeat_due_[Heartbeat::_TOTAL];  // The time_passed_ values at which each heartbeat will next trigger.
     int         moon_;                          // The current moon phase.
     int         time_;                          // The time of day.
     uint32_t    time_passed_;                   // The total # of seconds that have passed since the game started. This will loop every ~136 years, see time_passed().
     float       subsecond_;                     // For counting time passed in amounts of time less than a second.
     Weather     weather_;                       // The current weather.
 
+    std::priority_queue<ScheduledEvent, std::vector<ScheduledEvent>, std::greater<ScheduledEvent>>  schedule_;  // Upcoming heartbeat events, soonest first. Entries made stale by rescheduling are discarded as they reach the front. Batched heartbeats aren't included.
     std::map<std::string, std::string>  tw_string_map_;         // The time and weather strings from data/misc/weather.yml
     std::vector<std::string>            weather_change_map_;    // Weather change maps, to determine odds of changing to different weather types.
 };
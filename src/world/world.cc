@@ -7,12 +7,18 @@
 #include "core/core.h"
 #include "core/filex.h"
 #include "core/mathx.h"
+#include "core/pool.h"
 #include "core/strx.h"
 #include "world/world.h"
 
+#include <algorithm>
+
 
 // The SQL construction table for the world data.
-constexpr char World::SQL_WORLD[] = "CREATE TABLE world ( mob_unique_id INTEGER PRIMARY KEY UNIQUE NOT NULL )";
+constexpr char World::SQL_WORLD[] = "CREATE TABLE IF NOT EXISTS world ( mob_unique_id INTEGER PRIMARY KEY UNIQUE NOT NULL )";
+
+// The SQL statement for saving the world data.
+constexpr char World::SQL_WORLD_INSERT[] = "INSERT INTO world ( mob_unique_id ) VALUES ( :mob_unique_id )";
 
 // Lookup table for converting DamageType text names into enums.
 const std::map<std::string, DamageType> World::DAMAGE_TYPE_MAP = { { "acid", DamageType::ACID }, { "ballistic", DamageType::BALLISTIC }, { "crushing", DamageType::CRUSHING }, { "edged", DamageType::EDGED }, { "explosive", DamageType::EXPLOSIVE }, { "energy", DamageType::ENERGY }, { "kinetic", DamageType::KINETIC }, { "piercing", DamageType::PIERCING }, { "plasma", DamageType::PLASMA }, { "poison", DamageType::POISON }, { "rending", DamageType::RENDING } };
@@ -38,6 +44,9 @@ const std::map<std::string, LinkTag> World::LINK_TAG_MAP = { { "autoclose", Link
 // Lookup table for converting MobileTag text names into enums.
 const std::map<std::string, MobileTag> World::MOBILE_TAG_MAP = { { "aggroonsight", MobileTag::AggroOnSight }, { "agile", MobileTag::Agile }, { "anemic", MobileTag::Anemic }, { "beast", MobileTag::Beast}, { "brawny", MobileTag::Brawny }, { "cannotblock", MobileTag::CannotBlock }, { "cannotdodge", MobileTag::CannotDodge }, { "cannotopendoors", MobileTag::CannotOpenDoors }, { "cannotparry", MobileTag::CannotParry }, { "clumsy", MobileTag::Clumsy }, { "coward", MobileTag::Coward }, { "feeble", MobileTag::Feeble }, { "immunitybleed", MobileTag::ImmunityBleed }, { "immunitypoison", MobileTag::ImmunityPoison }, { "mighty", MobileTag::Mighty }, { "pluralname", MobileTag::PluralName }, { "propernoun", MobileTag::ProperNoun }, { "puny", MobileTag::Puny }, { "randomgender", MobileTag::RandomGender }, { "strong", MobileTag::Strong }, { "unliving", MobileTag::Unliving }, { "vigorous", MobileTag::Vigorous } };
 
+// An empty Mobile list, returned by mobs_in_room() for unoccupied Rooms.
+const std::vector<std::shared_ptr<Mobile>> World::NO_MOBILES;
+
 // Lookup table for converting RoomTag text names into enums.
 const std::map<std::string, RoomTag> World::ROOM_TAG_MAP = { { "arena", RoomTag::Arena }, { "canseeoutside", RoomTag::CanSeeOutside }, { "churchaltar", RoomTag::ChurchAltar }, { "digok", RoomTag::DigOK }, { "gamepoker", RoomTag::GamePoker }, { "gameslots", RoomTag::GameSlots }, { "gross", RoomTag::Gross }, { "heatedinterior", RoomTag::HeatedInterior }, { "hidecampfirescar", RoomTag::HideCampfireScar }, { "indoors", RoomTag::Indoors }, { "maze", RoomTag::Maze }, { "nexus", RoomTag::Nexus }, { "noexplorecredit", RoomTag::NoExploreCredit }, { "permacampfire", RoomTag::PermaCampfire }, { "private", RoomTag::Private }, { "radiationlight", RoomTag::RadiationLight }, { "shop", RoomTag::Shop }, { "shopbuyscontraband", RoomTag::ShopBuysContraband }, { "shoprespawningowner", RoomTag::ShopRespawningOwner }, { "sleepok", RoomTag::SleepOK }, { "sludgepit", RoomTag::SludgePit }, { "smelly", RoomTag::Smelly }, { "tavern", RoomTag::Tavern }, { "trees", RoomTag::Trees }, { "underground", RoomTag::Underground }, { "verywide", RoomTag::VeryWide }, { "waterclean", RoomTag::WaterClean }, { "waterdeep", RoomTag::WaterDeep }, { "watersalt", RoomTag::WaterSalt }, { "watershallow", RoomTag::WaterShallow }, { "watertainted", RoomTag::WaterTainted }, { "wide", RoomTag::Wide } };
 
@@ -55,9 +64,11 @@ const std::set<std::string> World::VALID_YAML_KEYS_MOBS = { "gear", "hp", "name"
 
 
 // Constructor, loads the room YAML data.
-World::World() : mob_unique_id_(0), old_light_level_(0), old_location_(0), player_(std::make_shared<Player>()), time_weather_(std::make_shared<TimeWeather>())
+World::World() : active_origin_(0), buff_ticks_(0), mob_unique_id_(0), old_light_level_(0), old_location_(0), player_(std::make_shared<Player>()), room_graph_(std::make_shared<RoomGraph>()), time_weather_(std::make_shared<TimeWeather>())
 {
     load_room_pool();
+    room_graph_->compile(room_pool_);
+    room_distance_.resize(room_graph_->size(), static_cast<uint8_t>(ROOM_INACTIVE));
     load_item_pool();
     load_mob_pool();
     load_anatomy_pool();
@@ -66,43 +77,108 @@ World::World() : mob_unique_id_(0), old_light_level_(0), old_location_(0), playe
     load_skills();
 }
 
-// Attempts to scan a room for the active rooms list. Only for internal use with recalc_active_rooms().
-void World::active_room_scan(uint32_t target, uint32_t depth)
+// Rebuilds the active rooms list outwards from the player's location, optionally noting which rooms became active or inactive.
+void World::active_room_scan(std::vector<uint32_t> *activated, std::vector<uint32_t> *deactivated)
 {
-    if (active_rooms_.count(target)) return;       // Ignore any room already on the active list.
+    // Rooms that were active before the scan are marked, so we can tell which ones are still in range without having to copy the old list to compare against.
+    static constexpr uint8_t WAS_ACTIVE = ROOM_INACTIVE - 1;
+    std::vector<uint32_t> old_active_rooms;
+    old_active_rooms.swap(active_rooms_);
+    for (auto room : old_active_rooms)
+        room_distance_.at(room_graph_->index(room)) = WAS_ACTIVE;
+
+    // A breadth-first scan across the room graph. Every room is reached by the shortest available path, so its distance is exact.
+    active_origin_ = player_->location();
+    std::vector<uint32_t> queue;
+    auto visit = [this, activated, &queue](uint32_t index, uint8_t distance) {
+        uint8_t &entry = room_distance_.at(index);
+        if (entry < WAS_ACTIVE) return;     // This room has already been reached.
+        const uint32_t room_id = room_graph_->room_id(index);
+        if (entry == ROOM_INACTIVE && activated) activated->push_back(room_id);
+        entry = distance;
+        active_rooms_.push_back(room_id);
+        queue.push_back(index);
+    };
+    visit(room_graph_->index(active_origin_), 0);
+    for (size_t i = 0; i < queue.size(); i++)
+    {
+        const uint32_t index = queue.at(i);
+        const uint8_t distance = room_distance_.at(index);
+        if (distance + 1 >= ROOM_SCAN_DISTANCE) continue;   // Don't scan any further past the scan limit.
+        for (auto link = room_graph_->begin(index); link != room_graph_->end(index); link++)
+            visit(link->target, distance + 1);
+    }
+
+    // Anything still marked from before is no longer in range.
+    for (auto room : old_active_rooms)
+    {
+        uint8_t &entry = room_distance_.at(room_graph_->index(room));
+        if (entry != WAS_ACTIVE) continue;
+        entry = ROOM_INACTIVE;
+        if (deactivated) deactivated->push_back(room);
+    }
+}
 
-    const auto room = get_room(target);
-    active_rooms_.insert(target);                  // Add this room to the active list.
-    if (depth + 1 >= ROOM_SCAN_DISTANCE) return;    // Just stop here if we're past the scan limit.
-    for (unsigned int i = 0; i < Room::ROOM_LINKS_MAX; i++)
+// Retrieves all the Mobiles in active rooms, sorted by unique ID.
+std::vector<std::shared_ptr<Mobile>> World::active_mobs() const
+{
+    // Walk whichever is smaller: the active rooms, or the rooms that have Mobiles in them.
+    std::vector<std::shared_ptr<Mobile>> result;
+    if (active_rooms_.size() < mobile_rooms_.size())
+    {
+        for (auto room : active_rooms_)
+        {
+            const auto &room_mobs = mobs_in_room(room);
+            result.insert(result.end(), room_mobs.begin(), room_mobs.end());
+        }
+    }
+    else
     {
-        if (room->fake_link(i)) continue;           // Ignore empty links, links to FALSE_ROOM, etc.
-        const uint32_t link = room->link(i);
-        active_room_scan(link, depth + 1);
+        for (const auto &room : mobile_rooms_)
+            if (room_active(room.first)) result.insert(result.end(), room.second.begin(), room.second.end());
     }
+    std::sort(result.begin(), result.end(), [](const std::shared_ptr<Mobile> &a, const std::shared_ptr<Mobile> &b) { return a->id() < b->id(); });
+    return result;
 }
 
-// Retrieve a list of all active rooms.
-std::set<uint32_t> World::active_rooms() const { return active_rooms_; }
+// Retrieves a list of all active rooms, nearest to the player first.
+const std::vector<uint32_t>& World::active_rooms() const { return active_rooms_; }
 
 // Adds a Mobile to the world.
 void World::add_mobile(std::shared_ptr<Mobile> mob)
 {
-    bool parser_id_valid;
-    int tries = 0;
-    do
+    mob->set_parser_id(mob_parser_ids_.assign(mob->parser_id(), Inventory::PID_PREFIX_MOBILE));
+    if (!mob->id())
     {
-        parser_id_valid = true;
-        if (!mob->parser_id()) parser_id_valid = false;
-        else
-        {
-            for (size_t i = 0; i < mobiles_.size(); i++)
-                if (mobiles_.at(i)->parser_id() == mob->parser_id()) parser_id_valid = false;
-        }
-        if (!parser_id_valid) mob->new_parser_id();
-    } while (!parser_id_valid && ++tries < 100000);
-    if (!mob->id()) mob->set_id(++mob_unique_id_);
-    mobiles_.push_back(mob);
+        mob->set_id(++mob_unique_id_);
+        mob->set_last_active(time_weather_->time_passed());
+    }
+
+    // Both the main Mobile vector and the room index are kept sorted by unique ID. New IDs always go on the end, but Mobiles loaded from a saved game may not arrive in order.
+    auto by_id = [](const std::shared_ptr<Mobile> &a, const std::shared_ptr<Mobile> &b) { return a->id() < b->id(); };
+    mobiles_.insert(std::upper_bound(mobiles_.begin(), mobiles_.end(), mob, by_id), mob);
+    auto &room_mobs = mobile_rooms_[mob->location()];
+    room_mobs.insert(std::upper_bound(room_mobs.begin(), room_mobs.end(), mob, by_id), mob);
+    mobile_ids_[mob->id()] = mob;
+}
+
+// Orders events by due time, then by Mobile ID (so the player comes first) and type.
+bool World::BuffEvent::operator>(const BuffEvent &other) const
+{
+    if (due != other.due) return due > other.due;
+    if (mob_id != other.mob_id) return mob_id > other.mob_id;
+    return type > other.type;
+}
+
+// The number of times buffs/debuffs have ticked down so far, which buff expiry times are measured against.
+uint32_t World::buff_ticks() const { return buff_ticks_; }
+
+// Checks how many more buff ticks it'll be until one of them has something to do, or UINT32_MAX if no buffs are due to change.
+uint32_t World::buff_ticks_until_event() const
+{
+    if (!buff_schedule_.size()) return UINT32_MAX;
+    const uint32_t due = buff_schedule_.top().due;
+    return (due > buff_ticks_ ? due - buff_ticks_ : 1);
 }
 
 // Retrieves a generic description string.
@@ -130,7 +206,7 @@ const std::shared_ptr<Item> World::get_item(const std::string &item_id, int stac
     if (!item_id.size()) throw std::runtime_error("Blank item ID requested.");
     const auto it = item_pool_.find(StrX::hash(item_id));
     if (it == item_pool_.end()) throw std::runtime_error("Invalid item ID requested: " + item_id);
-    auto copy = std::make_shared<Item>(*it->second);
+    auto copy = Pool::make_shared<Item>(*it->second);
     if (stack_size > 0) copy->set_stack(stack_size);
     return copy;
 }
@@ -149,7 +225,7 @@ const std::shared_ptr<Mobile> World::get_mob(const std::string &mob_id) const
     const uint32_t id_hash = StrX::hash(mob_id);
     const auto it = mob_pool_.find(id_hash);
     if (it == mob_pool_.end()) throw std::runtime_error("Invalid mobile ID requested: " + mob_id);
-    auto new_mob = std::make_shared<Mobile>(*it->second);
+    auto new_mob = Pool::make_shared<Mobile>(*it->second);
 
     if (new_mob->tag(MobileTag::RandomGender))
     {
@@ -249,40 +325,53 @@ bool World::item_exists(const std::string &str) const { return item_pool_.count(
 // Loads the World and all things within it.
 void World::load(std::shared_ptr<SQLite::Database> save_db)
 {
-    core()->messagelog()->load(save_db);
+    if (core()->messagelog()) core()->messagelog()->load(save_db);
 
     SQLite::Statement world_query(*save_db, "SELECT * FROM world");
     if (!world_query.executeStep()) throw std::runtime_error("Unable to retrieve world data!");
     mob_unique_id_ = world_query.getColumn("mob_unique_id").getUInt();
 
-    for (auto room : room_pool_)
+    // Every saved Item is read in a single pass here, then claimed by the Inventories below as they're loaded.
+    const auto reader = std::make_shared<SaveReader>(save_db);
+
+    // Only rooms that have changed since the game started are saved; the rest stay as they were loaded from the YAML data.
+    SQLite::Statement room_query(*save_db, "SELECT * FROM rooms");
+    while (room_query.executeStep())
     {
-        room.second->load(save_db);
-        // Check if the Room has the SaveActive tag; if so, add it to the active rooms list, then remove the tag.
-        if (room.second->tag(RoomTag::SaveActive))
-        {
-            active_rooms_.insert(room.first);
-            room.second->clear_tag(RoomTag::SaveActive);
-        }
+        const auto it = room_pool_.find(room_query.getColumn("id").getUInt());
+        if (it != room_pool_.end()) it->second->load_row(room_query, reader);
     }
-    const uint32_t player_sql_id = player_->load(save_db, 0);
+    room_graph_->compile(room_pool_);   // Saved link tags (doors left open, etc.) are loaded directly, so the graph needs rebuilding.
+    const uint32_t player_sql_id = player_->load(reader, 0);
+    active_room_scan(nullptr, nullptr);     // The active rooms can be rebuilt from the player's location, without pinging any of them.
     time_weather_->load(save_db);
 
-    SQLite::Statement mob_query(*save_db, "SELECT sql_id FROM mobiles WHERE sql_id != :sql_id ORDER BY sql_id ASC");
-    mob_query.bind(":sql_id", std::to_string(player_sql_id));
+    std::unordered_map<uint32_t, std::shared_ptr<Mobile>> mobs_by_sql_id;
+    SQLite::Statement mob_query(*save_db, "SELECT * FROM mobiles WHERE sql_id != :sql_id ORDER BY sql_id ASC");
+    mob_query.bind(":sql_id", player_sql_id);
     while (mob_query.executeStep())
     {
-        auto new_mob = std::make_shared<Mobile>();
-        new_mob->load(save_db, mob_query.getColumn("sql_id").getUInt());
+        auto new_mob = Pool::make_shared<Mobile>();
+        new_mob->load_row(mob_query, reader);
+        mobs_by_sql_id.insert(std::make_pair(mob_query.getColumn("sql_id").getUInt(), new_mob));
         add_mobile(new_mob);
     }
 
-    SQLite::Statement shop_query(*save_db, "SELECT id FROM shops ORDER BY id ASC");
+    // The buffs table is read in one pass, rather than once for each Mobile. The player's buffs have already been loaded above.
+    SQLite::Statement buff_query(*save_db, "SELECT * FROM buffs WHERE owner != :sql_id ORDER BY sql_id ASC");
+    buff_query.bind(":sql_id", player_sql_id);
+    while (buff_query.executeStep())
+    {
+        const auto it = mobs_by_sql_id.find(buff_query.getColumn("owner").getUInt());
+        if (it != mobs_by_sql_id.end()) it->second->load_buff(buff_query);
+    }
+
+    SQLite::Statement shop_query(*save_db, "SELECT * FROM shops ORDER BY id ASC");
     while (shop_query.executeStep())
     {
         const uint32_t shop_id = shop_query.getColumn("id").getUInt();
         auto new_shop = std::make_shared<Shop>(shop_id);
-        new_shop->load(save_db);
+        new_shop->load(reader, shop_query.getColumn("inventory_id").getUInt());
         shops_.insert(std::make_pair(shop_id, new_shop));
     }
 }
@@ -412,7 +501,7 @@ void World::load_item_pool()
                 // Create a new Item object.
                 const std::string item_id_str = item.first.as<std::string>();
                 const uint32_t item_id = StrX::hash(item_id_str);
-                const auto new_item(std::make_shared<Item>());
+                const auto new_item(Pool::make_shared<Item>());
 
                 // Verify all keys in this file.
                 for (auto key_value : item_data)
@@ -485,29 +574,29 @@ void World::load_item_pool()
                     const std::string damage_type = item_data["damage_type"].as<std::string>();
                     const auto type_it = DAMAGE_TYPE_MAP.find(damage_type);
                     if (type_it == DAMAGE_TYPE_MAP.end()) core()->guru()->nonfatal("Unrecognized damage type (" + damage_type + "): " + item_id_str, Guru::GURU_ERROR);
-                    else new_item->set_meta("damage_type", static_cast<int>(type_it->second));
+                    else new_item->stats_raw()->damage_type = type_it->second;
                 }
 
                 // The item's block% modifier, if a ny.
-                if (item_data["block_mod"]) new_item->set_meta("block_mod", item_data["block_mod"].as<int>());
+                if (item_data["block_mod"]) new_item->stats_raw()->block_mod = item_data["block_mod"].as<int>();
 
                 // The item's dodge% modifier, if any.
-                if (item_data["dodge_mod"]) new_item->set_meta("dodge_mod", item_data["dodge_mod"].as<int>());
+                if (item_data["dodge_mod"]) new_item->stats_raw()->dodge_mod = item_data["dodge_mod"].as<int>();
 
                 // The item's parry% modifier, if any.
-                if (item_data["parry_mod"]) new_item->set_meta("parry_mod", item_data["parry_mod"].as<int>());
+                if (item_data["parry_mod"]) new_item->stats_raw()->parry_mod = item_data["parry_mod"].as<int>();
 
                 // The Item's critical power, if any.
-                if (item_data["crit"]) new_item->set_meta("crit", item_data["crit"].as<int>());
+                if (item_data["crit"]) new_item->stats_raw()->crit = item_data["crit"].as<int>();
 
                 // The Item's speed, if any.
-                if (item_data["speed"]) new_item->set_meta("speed", item_data["speed"].as<float>());
+                if (item_data["speed"]) new_item->stats_raw()->speed = item_data["speed"].as<float>();
 
                 // The Item's capacity, if any.
-                if (item_data["capacity"]) new_item->set_meta("capacity", item_data["capacity"].as<int>());
+                if (item_data["capacity"]) new_item->stats_raw()->capacity = item_data["capacity"].as<int>();
 
                 // The Item's charge, if any.
-                if (item_data["charge"]) new_item->set_meta("charge", item_data["charge"].as<int>());
+                if (item_data["charge"]) new_item->set_charge(item_data["charge"].as<int>());
 
                 // The Item's EquipSlot, if any.
                 if (item_data["slot"])
@@ -519,27 +608,27 @@ void World::load_item_pool()
                     {
                         EquipSlot chosen_slot = slot_it->second;
                         if (new_item->type() == ItemType::SHIELD && new_item->equip_slot() == EquipSlot::HAND_MAIN) chosen_slot = EquipSlot::HAND_OFF;
-                        new_item->set_meta("slot", static_cast<int>(chosen_slot));
+                        new_item->set_equip_slot(chosen_slot);
                     }
                 }
 
                 // The Item's power, if any.
-                if (item_data["power"]) new_item->set_meta("power", item_data["power"].as<int>());
+                if (item_data["power"]) new_item->stats_raw()->power = item_data["power"].as<int>();
 
                 // The Item's ammunition power, if any.
-                if (item_data["ammo_power"]) new_item->set_meta("ammo_power", item_data["ammo_power"].as<float>());
+                if (item_data["ammo_power"]) new_item->stats_raw()->ammo_power = item_data["ammo_power"].as<float>();
 
                 // The Item's warmth rating, if any.
-                if (item_data["warmth"]) new_item->set_meta("warmth", item_data["warmth"].as<int>());
+                if (item_data["warmth"]) new_item->stats_raw()->warmth = item_data["warmth"].as<int>();
 
                 // The Item's bleed chance, if any.
-                if (item_data["bleed"]) new_item->set_meta("bleed", item_data["bleed"].as<int>());
+                if (item_data["bleed"]) new_item->stats_raw()->bleed = item_data["bleed"].as<int>();
 
                 // The Item's poison chance, if any.
-                if (item_data["poison"]) new_item->set_meta("poison", item_data["poison"].as<int>());
+                if (item_data["poison"]) new_item->stats_raw()->poison = item_data["poison"].as<int>();
 
                 // The Item's liquid type, if any.
-                if (item_data["liquid"]) new_item->set_meta("liquid", item_data["liquid"].as<std::string>());
+                if (item_data["liquid"]) new_item->set_liquid(item_data["liquid"].as<std::string>());
 
                 // The Item's description, if any.
                 if (!item_data["desc"]) core()->guru()->nonfatal("Missing description for item " + item_id_str, Guru::GURU_WARN);
@@ -675,7 +764,7 @@ void World::load_mob_pool()
                 // Create a new Mobile object, and remember its unique ID.
                 const std::string mobile_id_str = mobile.first.as<std::string>();
                 const uint32_t mobile_id = StrX::hash(mobile_id_str);
-                const auto new_mob(std::make_shared<Mobile>());
+                const auto new_mob(Pool::make_shared<Mobile>());
 
                 // Verify all keys in this file.
                 for (auto key_value : mobile_data)
@@ -984,6 +1073,33 @@ size_t World::mob_count() const { return mobiles_.size(); }
 // Checks if a specified mobile ID exists.
 bool World::mob_exists(const std::string &str) const { return mob_pool_.count(StrX::hash(str)); }
 
+// Retrieves a Mobile by its unique ID, or nullptr if no such Mobile exists.
+const std::shared_ptr<Mobile> World::mob_by_id(uint32_t id) const
+{
+    const auto it = mobile_ids_.find(id);
+    if (it == mobile_ids_.end()) return nullptr;
+    return it->second;
+}
+
+// Updates the room index when a Mobile changes location.
+void World::mob_moved(uint32_t id, uint32_t old_room, uint32_t new_room)
+{
+    if (old_room == new_room) return;
+    const auto old_it = mobile_rooms_.find(old_room);
+    if (old_it == mobile_rooms_.end()) return; // This can happen when a Mobile's location is set before it's been added to the world.
+
+    auto &old_mobs = old_it->second;
+    auto by_id = [](const std::shared_ptr<Mobile> &mob, uint32_t target) { return mob->id() < target; };
+    const auto mob_it = std::lower_bound(old_mobs.begin(), old_mobs.end(), id, by_id);
+    if (mob_it == old_mobs.end() || (*mob_it)->id() != id) return;  // As above, if the Mobile isn't indexed yet, there's nothing to move.
+    const auto mob = *mob_it;
+    old_mobs.erase(mob_it);
+    if (!old_mobs.size()) mobile_rooms_.erase(old_it);
+
+    auto &new_mobs = mobile_rooms_[new_room];
+    new_mobs.insert(std::lower_bound(new_mobs.begin(), new_mobs.end(), id, by_id), mob);
+}
+
 // Retrieves a Mobile by vector position.
 const std::shared_ptr<Mobile> World::mob_vec(size_t vec_pos) const
 {
@@ -991,6 +1107,22 @@ const std::shared_ptr<Mobile> World::mob_vec(size_t vec_pos) const
     return mobiles_.at(vec_pos);
 }
 
+// Retrieves the vector position of a Mobile with a specified unique ID, or MOB_NOT_FOUND.
+size_t World::mob_vec_pos(uint32_t id) const
+{
+    const auto it = std::lower_bound(mobiles_.begin(), mobiles_.end(), id, [](const std::shared_ptr<Mobile> &mob, uint32_t target) { return mob->id() < target; });
+    if (it == mobiles_.end() || (*it)->id() != id) return MOB_NOT_FOUND;
+    return it - mobiles_.begin();
+}
+
+// Retrieves all the Mobiles in a specified Room, sorted by unique ID.
+const std::vector<std::shared_ptr<Mobile>>& World::mobs_in_room(uint32_t room_id) const
+{
+    const auto it = mobile_rooms_.find(room_id);
+    if (it == mobile_rooms_.end()) return NO_MOBILES;
+    return it->second;
+}
+
 // Sets up for a new game.
 void World::new_game()
 {
@@ -1006,78 +1138,98 @@ const std::shared_ptr<Player> World::player() const { return player_; }
 // Recalculates the list of active rooms.
 void World::recalc_active_rooms()
 {
-    std::set<uint32_t> old_active_rooms = active_rooms_;   // Make a copy of the currently active rooms, so we can see what changed.
-    active_rooms_.clear();
-    active_room_scan(player()->location(), 0);
+    if (player_->location() == active_origin_ && active_rooms_.size()) return;  // Nothing can change if the player hasn't moved.
+    std::vector<uint32_t> activated, deactivated;
+    active_room_scan(&activated, &deactivated);
 
     // Ping any rooms that have become active.
-    for (auto room : active_rooms_)
-        if (!old_active_rooms.count(room)) get_room(room)->activate();
+    for (auto room : activated)
+        get_room(room)->activate();
 
     // Ping any rooms that have become inactive.
-    for (auto room : old_active_rooms)
-        if (!active_rooms_.count(room)) get_room(room)->deactivate();
+    for (auto room : deactivated)
+        get_room(room)->deactivate();
 }
 
 // Removes a Mobile from the world.
 void World::remove_mobile(size_t id)
 {
-    for (size_t i = 0; i < mobiles_.size(); i++)
+    const size_t vec_pos = mob_vec_pos(id);
+    if (vec_pos == MOB_NOT_FOUND)
     {
-        if (mobiles_.at(i)->id() == id)
-        {
-            mobiles_.erase(mobiles_.begin() + i);
-            return;
-        }
+        core()->guru()->nonfatal("Attempt to remove mobile that does not exist in the world.", Guru::GURU_ERROR);
+        return;
+    }
+
+    // Remove the Mobile from the ID and room indexes first.
+    mobile_ids_.erase(id);
+    const auto mob = mobiles_.at(vec_pos);
+    mob_parser_ids_.release(mob->parser_id());
+    const auto room_it = mobile_rooms_.find(mob->location());
+    if (room_it != mobile_rooms_.end())
+    {
+        auto &room_mobs = room_it->second;
+        room_mobs.erase(std::remove(room_mobs.begin(), room_mobs.end(), mob), room_mobs.end());
+        if (!room_mobs.size()) mobile_rooms_.erase(room_it);
     }
-    core()->guru()->nonfatal("Attempt to remove mobile that does not exist in the world.", Guru::GURU_ERROR);
+    mobiles_.erase(mobiles_.begin() + vec_pos);
 }
 
 // Checks if a room is currently active.
-bool World::room_active(uint32_t id) const { return active_rooms_.count(id); }
+bool World::room_active(uint32_t id) const { return room_distance(id) != ROOM_INACTIVE; }
+
+// Checks how many links away from the player a room is, or ROOM_INACTIVE if it's outside the active area.
+uint8_t World::room_distance(uint32_t id) const
+{
+    const uint32_t index = room_graph_->index(id);
+    if (index == RoomGraph::NO_ROOM) return ROOM_INACTIVE;
+    return room_distance_.at(index);
+}
 
 // Checks if a specified room ID exists.
 bool World::room_exists(const std::string &str) const { return room_pool_.count(StrX::hash(str)); }
 
+// Gets a pointer to the compiled graph of links between Rooms.
+const std::shared_ptr<RoomGraph> World::room_graph() const { return room_graph_; }
+
 // Saves the World and all things within it.
-void World::save(std::shared_ptr<SQLite::Database> save_db)
+void World::save(std::shared_ptr<SaveWriter> writer)
 {
-    save_db->exec(Buff::SQL_BUFFS);
-    save_db->exec(Item::SQL_ITEMS);
-    save_db->exec(MessageLog::SQL_MSGLOG);
-    save_db->exec(Mobile::SQL_MOBILES);
-    save_db->exec(Player::SQL_PLAYER);
-    save_db->exec(Player::SQL_SKILLS);
-    save_db->exec(Room::SQL_ROOMS);
-    save_db->exec(Shop::SQL_SHOPS);
-    save_db->exec(TimeWeather::SQL_HEARTBEATS);
-    save_db->exec(TimeWeather::SQL_TIME_WEATHER);
-    save_db->exec(SQL_WORLD);
-
-    SQLite::Statement query(*save_db, "INSERT INTO world ( mob_unique_id ) VALUES ( :mob_unique_id )");
-    query.bind(":mob_unique_id", mob_unique_id_);
-    query.exec();
-
-    player_->save(save_db);
-    core()->messagelog()->save(save_db);
-    time_weather_->save(save_db);
+    writer->run(Buff::SQL_BUFFS);
+    writer->run(Item::SQL_ITEMS);
+    writer->run(MessageLog::SQL_MSGLOG);
+    writer->run(Mobile::SQL_MOBILES);
+    writer->run(Player::SQL_PLAYER);
+    writer->run(Player::SQL_SKILLS);
+    writer->run(Room::SQL_ROOMS);
+    writer->run(Shop::SQL_SHOPS);
+    writer->run(TimeWeather::SQL_TIME_WEATHER);
+    writer->run(SQL_WORLD);
+
+    // Most rows are only written if they've changed since the last save, but these tables are small, change on almost every save, and have no keys that stay the same between saves.
+    writer->run("DELETE FROM player; DELETE FROM skills; DELETE FROM time_weather; DELETE FROM world");
+
+    writer->insert(SQL_WORLD_INSERT);
+    writer->bind(":mob_unique_id", mob_unique_id_);
+    writer->write();
+
+    player_->save(writer);
+    if (core()->messagelog()) core()->messagelog()->save(writer);
+    time_weather_->save(writer);
 
     for (auto room : room_pool_)
-    {
-        // Temporarily tag the room with SaveActive, if it's in the active rooms list.
-        const bool is_active = room_active(room.first);
-        if (is_active) room.second->set_tag(RoomTag::SaveActive);
-        room.second->save(save_db);
-        if (is_active) room.second->clear_tag(RoomTag::SaveActive);
-    }
+        room.second->save(writer);
 
     for (auto mob : mobiles_)
-        mob->save(save_db);
+        mob->save(writer);
 
     for (auto shop : shops_)
-        shop.second->save(save_db);
+        shop.second->save(writer);
 }
 
+// Schedules a buff/debuff on a Mobile (or the player, with ID 0) to be processed on a given buff tick.
+void World::schedule_buff(uint32_t mob_id, Buff::Type type, uint32_t due) { buff_schedule_.push({ due, mob_id, type }); }
+
 // Assigns the player starter equipment from a list.
 void World::starter_equipment(const std::string &list_name)
 {
@@ -1094,5 +1246,67 @@ void World::starter_equipment(const std::string &list_name)
     }
 }
 
+// Hashes the current state of the World, for checking that replays are deterministic.
+uint32_t World::state_hash() const
+{
+    // This is an FNV-1a hash (see StrX::fnv_mix()), fed with the things most likely to drift if the simulation changes: the time, the player, every Mobile, and any Items lying around.
+    uint32_t hash = StrX::FNV_OFFSET_32;
+    auto mix = [&hash](uint32_t value) { StrX::fnv_mix(&hash, value); };
+    auto mix_inventory = [&mix](std::shared_ptr<Inventory> inv) {
+        mix(inv->count());
+        for (size_t i = 0; i < inv->count(); i++)
+        {
+            mix(StrX::hash(inv->get(i)->name()));
+            mix(inv->get(i)->stack());
+        }
+    };
+
+    mix(time_weather_->time_passed());
+    mix(player_->location());
+    mix(player_->hp());
+    mix(player_->sp());
+    mix(player_->mp());
+    mix(player_->hunger());
+    mix(player_->thirst());
+    mix_inventory(player_->inv());
+    mix_inventory(player_->equ());
+    mix(mob_unique_id_);
+    for (auto mob : mobiles_)
+    {
+        mix(mob->id());
+        mix(StrX::hash(mob->species()));
+        mix(mob->location());
+        mix(mob->hp());
+        mix(static_cast<uint32_t>(mob->stance()));
+    }
+    for (auto room : room_pool_)
+    {
+        if (!room.second->inv()->count()) continue;
+        mix(room.first);
+        mix_inventory(room.second->inv());
+    }
+    return hash;
+}
+
+// Ticks down buffs/debuffs a number of times, processing only those which are due to change. Returns true if the player died.
+bool World::tick_buffs(uint32_t ticks)
+{
+    // When time is fast-forwarded, the ticks in between are skipped; TimeWeather::seconds_until_event() makes sure none of them had anything due.
+    buff_ticks_ += ticks;
+    while (buff_schedule_.size() && buff_schedule_.top().due <= buff_ticks_)
+    {
+        const BuffEvent event = buff_schedule_.top();
+        buff_schedule_.pop();
+
+        // Events for Mobiles that have since died or been removed from the world are just discarded.
+        std::shared_ptr<Mobile> mob = player_;
+        if (event.mob_id) mob = mob_by_id(event.mob_id);
+        if (!mob) continue;
+        mob->tick_buff(event.type, event.due);
+        if (!event.mob_id && player_->is_dead()) return true;
+    }
+    return false;
+}
+
 // Gets a pointer to the TimeWeather object.
 const std::shared_ptr<TimeWeather> World::time_weather() const { return time_weather_; }
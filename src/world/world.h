@@ -6,7 +6,9 @@
 
 #include "3rdparty/SQLiteCpp/Database.h"
 #include "core/list.h"
+#include "core/parser-ids.h"
 #include "world/player.h"
+#include "world/room-graph.h"
 #include "world/room.h"
 #include "world/shop.h"
 #include "world/time-weather.h"
@@ -15,17 +17,25 @@
 #include <cstdint>
 #include <map>
 #include <memory>
+#include <queue>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 
 class World
 {
 public:
+    static constexpr size_t     MOB_NOT_FOUND = -1;         // Returned by mob_vec_pos() when no Mobile with the requested ID exists.
+    static constexpr uint8_t    ROOM_INACTIVE = UINT8_MAX;  // Returned by room_distance() for rooms outside of the active area.
+
                     World();                                                    // Constructor, loads the room YAML data.
-    std::set<uint32_t>  active_rooms() const;                                   // Retrieve a list of all active rooms.
+    std::vector<std::shared_ptr<Mobile>>    active_mobs() const;                // Retrieves all the Mobiles in active rooms, sorted by unique ID.
+    const std::vector<uint32_t>&    active_rooms() const;                       // Retrieves a list of all active rooms, nearest to the player first.
     void            add_mobile(std::shared_ptr<Mobile> mob);                    // Adds a Mobile to the world.
+    uint32_t        buff_ticks() const;                                         // The number of times buffs/debuffs have ticked down so far, which buff expiry times are measured against.
+    uint32_t        buff_ticks_until_event() const;                             // Checks how many more buff ticks it'll be until one of them has something to do, or UINT32_MAX if no buffs are due to change.
     std::string     generic_desc(const std::string &id) const;                  // Retrieves a generic description string.
     const std::vector<std::shared_ptr<BodyPart>>& get_anatomy(const std::string &id) const; // Retrieves a copy of the anatomy data for a given species.
     const std::shared_ptr<Item>     get_item(const std::string &item_id, int stack_size = 0) const; // Retrieves a specified Item by ID.
@@ -42,18 +52,36 @@ public:
     void            main_loop_events_pre_input();                               // Triggers events that happen during the main loop, just before player input.
     size_t          mob_count() const;                                          // Returns the number of Mobiles currently active.
     bool            mob_exists(const std::string &str) const;                   // Checks if a specified mobile ID exists.
+    const std::shared_ptr<Mobile>   mob_by_id(uint32_t id) const;               // Retrieves a Mobile by its unique ID, or nullptr if no such Mobile exists.
+    void            mob_moved(uint32_t id, uint32_t old_room, uint32_t new_room);   // Updates the room index when a Mobile changes location.
     const std::shared_ptr<Mobile>   mob_vec(size_t vec_pos) const;              // Retrieves a Mobile by vector position.
+    size_t          mob_vec_pos(uint32_t id) const;                             // Retrieves the vector position of a Mobile with a specified unique ID, or MOB_NOT_FOUND.
+    const std::vector<std::shared_ptr<Mobile>>& mobs_in_room(uint32_t room_id) const;   // Retrieves all the Mobiles in a specified Room, sorted by unique ID.
     void            new_game();                                                 // Sets up for a new game.
     const std::shared_ptr<Player>   player() const;                             // Retrieves a pointer to the Player object.
     void            recalc_active_rooms();                                      // Recalculates the list of active rooms.
     void            remove_mobile(size_t id);                                   // Removes a Mobile from the world.
     bool            room_active(uint32_t id) const;                             // Checks if a room is currently active.
+    uint8_t         room_distance(uint32_t id) const;                           // Checks how many links away from the player a room is, or ROOM_INACTIVE if it's outside the active area.
     bool            room_exists(const std::string &str) const;                  // Checks if a specified room ID exists.
-    void            save(std::shared_ptr<SQLite::Database> save_db);            // Saves the World and all things within it.
+    const std::shared_ptr<RoomGraph>    room_graph() const;                     // Gets a pointer to the compiled graph of links between Rooms.
+    void            save(std::shared_ptr<SaveWriter> writer);                   // Saves the World and all things within it.
+    void            schedule_buff(uint32_t mob_id, Buff::Type type, uint32_t due);  // Schedules a buff/debuff on a Mobile (or the player, with ID 0) to be processed on a given buff tick.
     void            starter_equipment(const std::string &list_name);            // Assigns the player starter equipment from a list.
+    uint32_t        state_hash() const;                                         // Hashes the current state of the World, for checking that replays are deterministic.
+    bool            tick_buffs(uint32_t ticks = 1);                             // Ticks down buffs/debuffs a number of times, processing only those which are due to change. Returns true if the player died.
     const std::shared_ptr<TimeWeather> time_weather() const;                    // Gets a pointer to the TimeWeather object.
 
 private:
+    struct BuffEvent
+    {
+        uint32_t    due;    // The buff tick on which this event is due.
+        uint32_t    mob_id; // The unique ID of the Mobile with the buff/debuff, or 0 for the player.
+        Buff::Type  type;   // The type of buff/debuff.
+
+        bool operator>(const BuffEvent &other) const;   // Orders events by due time, then by Mobile ID (so the player comes first) and type.
+    };
+
     struct SkillData
     {
         std::string name;       // The name of this skill.
@@ -69,31 +97,41 @@ private:
     static const std::map<std::string, uint8_t>         LIGHT_LEVEL_MAP;        // Lookup table for converting textual light levels (e.g. "bright") to integer values.
     static const std::map<std::string, LinkTag>         LINK_TAG_MAP;           // Lookup table for converting LinkTag text names into enums.
     static const std::map<std::string, MobileTag>       MOBILE_TAG_MAP;         // Lookup table for converting MobileTag text names into enums.
+    static const std::vector<std::shared_ptr<Mobile>>   NO_MOBILES;             // An empty Mobile list, returned by mobs_in_room() for unoccupied Rooms.
     static const std::map<std::string, RoomTag>         ROOM_TAG_MAP;           // Lookup table for converting RoomTag text names into enums.
     static const std::map<std::string, Room::Security>  SECURITY_MAP;           // Lookup table for converting textual room security (e.g. "anarchy") to enum values.
     static const char                                   SQL_WORLD[];            // The SQL construction table for the world data.
+    static const char                                   SQL_WORLD_INSERT[];     // The SQL statement for saving the world data.
     static const std::set<std::string>                  VALID_YAML_KEYS_AREAS;  // A list of all valid keys in area YAML files.
     static const std::set<std::string>                  VALID_YAML_KEYS_ITEMS;  // A list of all valid keys in item YAML files.
     static const std::set<std::string>                  VALID_YAML_KEYS_MOBS;   // A list of all valid keys in mobile YAML files.
 
-    std::set<uint32_t>                              active_rooms_;      // Rooms relatively close to the player, where AI/respawning/etc. will be active.
+    uint32_t                                        active_origin_;     // The room that the active rooms were last scanned from.
+    std::vector<uint32_t>                           active_rooms_;      // Rooms relatively close to the player, where AI/respawning/etc. will be active, nearest to the player first.
     std::map<std::string, std::vector<std::shared_ptr<BodyPart>>>   anatomy_pool_;  // The anatomy pool, containing body part data for Mobiles.
+    std::priority_queue<BuffEvent, std::vector<BuffEvent>, std::greater<BuffEvent>>  buff_schedule_;    // Upcoming buff/debuff events, soonest first. Events made stale by buffs being changed or cleared are skipped.
+    uint32_t                                        buff_ticks_;        // The number of times buffs/debuffs have ticked down so far.
     std::map<std::string, std::string>              generic_descs_;     // Generic descriptions for items and rooms, where multiple share a description.
     std::map<uint32_t, std::shared_ptr<Item>>       item_pool_;         // All the Item templates in the game.
     std::map<std::string, std::shared_ptr<List>>    list_pool_;         // List data from lists.yml
     std::map<uint32_t, std::string>                 mob_gear_;          // Equipment lists for gearing up Mobiles.
+    ParserIDs                                       mob_parser_ids_;    // The parser IDs used by active Mobiles.
     std::map<uint32_t, std::shared_ptr<Mobile>>     mob_pool_;          // All the Mobile templates in the game.
     uint32_t                                        mob_unique_id_;     // The unique ID counter for Mobiles.
-    std::vector<std::shared_ptr<Mobile>>            mobiles_;           // All the Mobiles currently active in the game.
+    std::unordered_map<uint32_t, std::shared_ptr<Mobile>>       mobile_ids_;    // Lookup table for finding active Mobiles by their unique ID.
+    std::map<uint32_t, std::vector<std::shared_ptr<Mobile>>>    mobile_rooms_;  // Index of the Mobiles in each occupied Room, keyed by Room ID and sorted by unique ID.
+    std::vector<std::shared_ptr<Mobile>>            mobiles_;           // All the Mobiles currently active in the game, sorted by unique ID.
     int                                             old_light_level_;   // Used to check when the light level changes in the player's room.
     uint32_t                                        old_location_;      // Also used for light level change checks.
     std::shared_ptr<Player>                         player_;            // The player character.
+    std::vector<uint8_t>                            room_distance_;     // The distance of every room from the player, by room graph index; ROOM_INACTIVE for rooms outside the active area.
+    std::shared_ptr<RoomGraph>                      room_graph_;        // The compiled graph of links between Rooms, for fast traversal.
     std::map<uint32_t, std::shared_ptr<Room>>       room_pool_;         // All the Room templates in the game.
     std::map<uint32_t, std::shared_ptr<Shop>>       shops_;             // Any and all shops in the game.
     std::map<std::string, SkillData>                skills_;            // The skills the player can use.
     std::shared_ptr<TimeWeather>                    time_weather_;      // The World's TimeWeather object, for tracking... well, the time and weather.
 
-    void    active_room_scan(uint32_t target, uint32_t depth);  // Attempts to scan a room for the active rooms list. Only for internal use with recalc_active_rooms().
+    void    active_room_scan(std::vector<uint32_t> *activated, std::vector<uint32_t> *deactivated); // Rebuilds the active rooms list outwards from the player's location, optionally noting which rooms became active or inactive.
     void    load_anatomy_pool();    // Loads the anatomy YAML data into memory.
     void    load_generic_descs();   // Loads the generic descriptions YAML data into memory.
     void    load_item_pool();       // Loads the Item YAML data into memory.